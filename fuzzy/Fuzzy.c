@@ -2,6 +2,11 @@
 //Compile: gcc Spinner.c libcAI.so -o Spinner
 //Run: ./Spinner
 #include "cAI.h"
+#include "wallSweep.h"
+#include "distField.h"
+#include "rayAtlas.h"
+#include "sensorFrame.h"
+#include "rng.h"
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -268,64 +273,69 @@ float turnRules(float closest, float closestAngle, float furthestAngle, float sp
   return centroidTurn(turnLeft, noTurn, turnRight);
 }
 
+DistField mapField; // loaded from -distfield, empty otherwise
+RayAtlas mapAtlas; // loaded from -rayatlas, empty otherwise
+SensorFrame frame; //this tick's snapshot, see sensorFrame.h
+FILE *frameLog; //-framelog file, NULL when not logging
+Rng fuzzyRng; //seeded once from -rngseed or the clock
+
 int AI_loop() {
-  srand((unsigned int)time(NULL));
   setTurnSpeedDeg(20);
-  int aimDir = aimdir(0);
+  sensorFrameCaptureState(&frame);
+  if(mapAtlas.size)
+    rayAtlasSweep(&mapAtlas,frame.x,frame.y,1000,(int)frame.headingDeg,1,360,frame.walls,NULL,NULL);
+  else
+    sweepWalls(1000,(int)frame.headingDeg,1,360,frame.walls,NULL,NULL);
+  sensorFrameWalls(&frame,1000);
+  if(frameLog) sensorFrameWrite(frameLog,&frame);
+  int aimDir = frame.aimDir;
+  int speed = frame.speed;
   //Release keys
   //Set variables
-  double heading = selfHeadingDeg();
-  double tracking = selfTrackingDeg();
-  double trackWall = wallFeeler(500,tracking);
-
-  //clockwise rotation around the ship
-  double frontWall = wallFeeler(500,heading);
-  double wall1 = wallFeeler(500,heading+5);
-  double wall2 = wallFeeler(500,heading+60);
-  double wall3 = wallFeeler(500,heading+90);
-  double wall4 = wallFeeler(500,heading+120);
-  double wall5 = wallFeeler(500,heading+150);
-  double backWall = wallFeeler(500,heading+180);
-  double wall7 = wallFeeler(500,heading+210);
-  double wall8 = wallFeeler(500,heading+240);
-  double wall9 = wallFeeler(500,heading+270);
-  double wall10 = wallFeeler(500,heading+300);
-  double wall11 = wallFeeler(500,heading+355);
+  //the 500 pixel feelers, taken from the 1000 pixel sweep
+  double trackWall = frame.trackWall < 500 ? frame.trackWall : 500;
+  double frontWall = sensorFrameFeeler(&frame, 500, 0);
+  double wall1 = sensorFrameFeeler(&frame, 500, 5);
+  double wall2 = sensorFrameFeeler(&frame, 500, 60);
+  double wall3 = sensorFrameFeeler(&frame, 500, 90);
+  double wall4 = sensorFrameFeeler(&frame, 500, 120);
+  double wall5 = sensorFrameFeeler(&frame, 500, 150);
+  double backWall = sensorFrameFeeler(&frame, 500, 180);
+  double wall7 = sensorFrameFeeler(&frame, 500, 210);
+  double wall8 = sensorFrameFeeler(&frame, 500, 240);
+  double wall9 = sensorFrameFeeler(&frame, 500, 270);
+  double wall10 = sensorFrameFeeler(&frame, 500, 300);
+  double wall11 = sensorFrameFeeler(&frame, 500, 355);
   
   int shouldThrust = 0;
   //turn right = 1, turn left = -1
   int turnDir = 0;
 
-  
-
-  double furthest = 0.0;
-  int furthest_angle = 0;
-  double closest = 600.0;
-  int closest_angle = 0;
-  for(int i=0;i<360;i++)
+  int closest_angle = frame.closestAngle;
+  int furthest_angle = frame.furthestAngle;
+  double closest = frame.closest;
+  if(mapField.size)
   {
-    double dist = wallFeeler(1000,heading+i);
-    if(dist > furthest)
-    {
-      furthest = dist;
-      furthest_angle = i;
-    }
-    if(dist < closest)
-    {
-      closest = dist;
-      closest_angle = i;
-    }
+    // true distance to the nearest wall from the precomputed field
+    int wallDeg;
+    closest = distFieldClosest(&mapField, frame.x, frame.y, 1000, &wallDeg);
+    closest_angle = ((wallDeg - (int)frame.headingDeg) % 360 + 360) % 360;
+  }
+  if(closest >= 600.0)
+  {
+    closest = 600.0;
+    closest_angle = 0;
   }
 
-  int headingTrackingDiff = (int)(heading + 360 - tracking) % 360;
-  int headingAimingDiff = (int)(heading + 360 - aimDir) % 360;
-  int shotDanger = shotAlert(0);
+  int headingTrackingDiff = frame.headingTrackingDiff;
+  int headingAimingDiff = frame.headingAimingDiff;
+  int shotDanger = frame.shotDanger;
   if(shotDanger > 0 && shotDanger < 200 && frontWall > 200 && trackWall > 80 && wall1 > 100 && wall11 > 100)
   {
     THRUSTDEBUG(AR(printf("avoiding shot: %d\n", shotDanger)));
     shouldThrust = 1;
   }
-  else if((furthest_angle == 0) && selfSpeed() < 5 && frontWall > 200)
+  else if((furthest_angle == 0) && speed < 5 && frontWall > 200)
   {
     THRUSTDEBUG(AR(printf("propulsion\n")));
     shouldThrust = 1;
@@ -350,12 +360,12 @@ int AI_loop() {
     THRUSTDEBUG(AR(printf("thrusters type 5\n")));
     shouldThrust = 1;
   }
-  else if(selfSpeed() < 3 && frontWall > 250 && wall1 > 100 && wall11 > 100)
+  else if(speed < 3 && frontWall > 250 && wall1 > 100 && wall11 > 100)
   {
     shouldThrust = 1;
   }
   
-  float turn = turnRules(closest, closest_angle, furthest_angle, selfSpeed());
+  float turn = turnRules(closest, closest_angle, furthest_angle, speed);
   
   AR(printf("centroid: %f\n", turn));
   if((headingAimingDiff < 20 || headingAimingDiff > 340) && backWall > 20 && aimDir > 0)
@@ -365,7 +375,7 @@ int AI_loop() {
   if(turn < 1.0f)
   {
     // probabilistically turn left
-    if(2 * fabs(turn - 0.5f) < (float)rand() / (float)RAND_MAX)
+    if(2 * fabs(turn - 0.5f) < rngDouble(&fuzzyRng))
     {
       turnDir = -1;
     }
@@ -373,7 +383,7 @@ int AI_loop() {
   else if(turn > 1.0f)
   {
     // probabilistically turn right
-    if(2 * fabs(turn - 1.5f) < (float)rand() / (float)RAND_MAX)
+    if(2 * fabs(turn - 1.5f) < rngDouble(&fuzzyRng))
     {
       turnDir = 1;
     }
@@ -382,13 +392,13 @@ int AI_loop() {
   {
     turnDir = 0;
   }
-  if(selfSpeed() > 9 && headingTrackingDiff < 175)
+  if(speed > 9 && headingTrackingDiff < 175)
   {
     TURNDEBUG(AR(printf("Turning reverse\n")));
     turnDir = -1;
   }
   //Speed too fast, turn to face against tracking direction
-  else if(selfSpeed() > 9 && headingTrackingDiff > 185)
+  else if(speed > 9 && headingTrackingDiff > 185)
   {
     TURNDEBUG(AR(printf("Turning reverse\n")));
     turnDir = 1;
@@ -434,5 +444,12 @@ int AI_loop() {
   return 0;
 }
 int main(int argc, char *argv[]) {
+  // optional: -distfield map.df, written by sim/mkdistfield
+  distFieldArgs(&mapField, &argc, argv);
+  // optional: -rayatlas map.ra, written by sim/mkrayatlas
+  rayAtlasArgs(&mapAtlas, &argc, argv);
+  frameLog = sensorFrameLogArgs(&argc, argv);
+  // optional: -rngseed S to repeat a run's turn decisions
+  rngSeedArgs(&fuzzyRng, &argc, argv);
   return start(argc, argv);
 }
@@ -232,6 +232,16 @@ def turnRules(closest, closestAngle, furthestAngle, speed, chromosome):
 import libpyAI as ai
 
 from pathlib import Path
+
+def wallSweep(dist, start, step, count):
+    """Feelers at start + i*step as (distances, argmin, argmax), first index on ties.
+    Uses the batched call when the loaded libpyAI exports one."""
+    if hasattr(ai, "wallSweep"):
+        return ai.wallSweep(dist, start, step, count)
+    feel = ai.wallFeeler
+    walls = [feel(dist, start + i * step) for i in range(count)]
+    return walls, walls.index(min(walls)), walls.index(max(walls))
+
 CKPT = Path("es.ckpt")
 
 def load_or_create_es(x0, sigma0, opts):
@@ -328,18 +338,9 @@ def AI_loop():
     turnDir = 0       # right = 1, left = -1, none = 0
 
     # scan 360 degrees relative to heading
-    furthest = 0.0
-    furthest_angle = 0
-    closest = 600.0
-    closest_angle = 0
-    for i in range(360):
-        dist = ai.wallFeeler(500, heading + i)
-        if dist > furthest:
-            furthest = dist
-            furthest_angle = i
-        if dist < closest:
-            closest = dist
-            closest_angle = i
+    walls, closest_angle, furthest_angle = wallSweep(500, heading, 1, 360)
+    furthest = walls[furthest_angle]
+    closest = walls[closest_angle]
     headingTrackingDiff = int(heading + 360 - tracking) % 360
     headingAimingDiff = int(heading + 360 - aimDir) % 360  # kept for parity, unused below
 
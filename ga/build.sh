@@ -0,0 +1,3 @@
+#!/bin/bash
+
+gcc -I../include ga.c -lm -lpthread -o GA
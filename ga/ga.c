@@ -5,13 +5,16 @@
 #include <time.h>
 #include <ctype.h>
 #include <getopt.h>
+#include "chromosome.h"
+#include "geneMutate.h"
+#include "population.h"
+#include "selection.h"
+#include "evalPool.h"
+#include "checkpoint.h"
 
-typedef unsigned char bit_t; /* 0 or 1 */
-
-typedef struct {
-    bit_t *genes;
-    int fitness;
-} Chromosome;
+// rngStream() keys, the experiment seed picks the run
+#define RNG_STREAM_INIT 1      /* (0, individual) */
+#define RNG_STREAM_REPRODUCE 2 /* (generation, child) */
 
 typedef struct {
     int generation;
@@ -27,10 +30,10 @@ void printChromosomeSingle(const Chromosome *c, int L)
 {
     printf("fitness=%d genes=", c->fitness);
 
-    /* print gene bits as characters; safe if genes is an array of bit_t bytes */
+    /* print gene bits as characters */
     if (c->genes) {
         for (int j = 0; j < L; ++j) {
-            printf(c->genes[j] ? "1" : "0");
+            printf(geneGet(c, j) ? "1" : "0");
         }
     } else {
         printf("<no-genes>");
@@ -48,10 +51,10 @@ void printChromosome(const Chromosome *c, int idx, int L)
     if (idx >= 0) printf("[%d] ", idx);
     printf("fitness=%d genes=", c->fitness);
 
-    /* print gene bits as characters; safe if genes is an array of bit_t bytes */
+    /* print gene bits as characters */
     if (c->genes) {
         for (int j = 0; j < L; ++j) {
-            printf(c->genes[j] ? "1" : "0");
+            printf(geneGet(c, j) ? "1" : "0");
         }
     } else {
         printf("<no-genes>");
@@ -96,7 +99,7 @@ void printPopulation(Chromosome **pop, int pop_size, int L)
 Chromosome *createChromosome(int L)
 {
     Chromosome *c = malloc(sizeof(Chromosome));
-    c->genes = calloc((size_t)L, sizeof(bit_t));
+    c->genes = calloc((size_t)GENE_WORDS(L), sizeof(gene_word_t));
     c->fitness = 0;
     return c;
 }
@@ -109,126 +112,126 @@ void freeChromosome(Chromosome* c)
 }
 
 void copyChromosome(Chromosome *out, const Chromosome *src, int length) {
-    memcpy(out->genes, src->genes, (size_t)length * sizeof(bit_t));
+    memcpy(out->genes, src->genes, (size_t)GENE_WORDS(length) * sizeof(gene_word_t));
     out->fitness = src->fitness;
 }
 
-void randomChromosome(Chromosome *ind, int geneLength) {
-    for (int i = 0; i < geneLength; ++i) {
-        ind->genes[i] = (rand() < RAND_MAX / 2) ? 1 : 0;
-    }
+void randomChromosome(Chromosome *ind, int geneLength, Rng *rng) {
+    int n = GENE_WORDS(geneLength);
+    for (int w = 0; w < n; ++w) ind->genes[w] = rngNext(rng);
+    if (n > 0) ind->genes[n - 1] &= geneTailMask(geneLength);
 }
 
 int fitness(const Chromosome *ind, int geneLength) {
-    int sum = 0;
-    for (int i = 0; i < geneLength; ++i) sum += (ind->genes[i] ? 1 : 0);
-    return sum;
+    return genePopcount(ind, geneLength);
 }
 
-int compareChromosomeFit(const void* a, const void* b)
-{
-    Chromosome *A = *(Chromosome **)a;
-    Chromosome *B = *(Chromosome **)b;
-    if (A->fitness > B->fitness) return -1;
-    if (A->fitness < B->fitness) return 1;
-    return 0;
-}
-void sortPop(Chromosome** in, int population)
-{
-    qsort(in, (size_t)population, sizeof(Chromosome*), compareChromosomeFit);
-}
-//evaluate and sort 
+static EvalPool evalPool; // fitness threads, see evalPool.h
+
+//evaluate on every thread of evalPool, selection happens in reproduce()
 int evaluate(Chromosome** pop, int (*fitfunc)(const Chromosome *, int), int popSize, int geneLength)
 {
-    for(int i=0;i<popSize;i++){
-        pop[i]->fitness = fitfunc(pop[i], geneLength);
+    if(evalPoolRun(&evalPool, pop, popSize, geneLength, fitfunc) != 0)
+    {
+        printf("Out of memory evaluating the population\n");
+        exit(1);
     }
-    sortPop(pop,popSize);
+    return 0;
 }
 
-void crossover(const Chromosome *a, const Chromosome *b, Chromosome *c1, int geneLength) {
-    int point = rand() % geneLength;
+// genes [0, p) from a, [p, point) from b, the rest of c1 is left as it was
+void crossover(const Chromosome *a, const Chromosome *b, Chromosome *c1, int geneLength, Rng *rng) {
+    int point = (int)rngBelow(rng, (uint32_t)geneLength);
     point = point < 2 ? 2 : point;
-    int p = 1 + rand() % (point - 1);
-    for (int i = 0; i < p; ++i) {
-        c1->genes[i] = a->genes[i];
-    }
-    for (int i = p; i < point; ++i) {
-        c1->genes[i] = b->genes[i];
-    }
+    int p = 1 + (int)rngBelow(rng, (uint32_t)(point - 1));
+    geneCopyRange(c1, a, 0, p);
+    geneCopyRange(c1, b, p, point);
 }
 
-void mutate(Chromosome *c, int length, double mr) {
-    for (int i = 0; i < length; ++i) {
-        double r = (double)rand() / (double)RAND_MAX;
-        if (r < mr) c->genes[i] = c->genes[i] ? 0 : 1;
-    }
+// geometric gaps between flips, see geneMutate.h
+void mutate(Chromosome *c, int length, double mr, Rng *rng) {
+    geneMutate(c, length, mr, rng);
 }
 
 
-//a and b will be less than elites
-int selectParents(int elites, int *a, int *b) {
-    if (elites < 2) return -1;
-    int x = rand() % elites;
-    int y = rand() % (elites - 1);
-    if (y >= x) y += 1;
-    *a = x;
-    *b = y;
+//two different parents: uniform among the elites, or by sel's tournament/rank over the population
+int selectParents(const Selection *sel, int elites, int *a, int *b, Rng *rng) {
+    if (sel->mode == SELECT_ELITE) {
+        if (elites < 2) return -1;
+        int x = (int)rngBelow(rng, (uint32_t)elites);
+        int y = (int)rngBelow(rng, (uint32_t)(elites - 1));
+        if (y >= x) y += 1;
+        *a = x;
+        *b = y;
+        return 0;
+    }
+    if (sel->size < 2) return -1;
+    *a = selectionDraw(sel, elites, rng);
+    do *b = selectionDraw(sel, elites, rng); while (*b == *a);
     return 0;
 }
 
-//in-place operation of reproduction
-//leave elitism Chromosomes as is
-void reproduce(Chromosome** pop, int elitism, double mr, int popSize, int geneLength)
+//breeds the next generation into the other buffer and swaps it in
+//the elitism best Chromosomes carry over as they are
+//child i of generation gen draws from its own stream, so children do not depend on each other
+void reproduce(Population *P, Selection *sel, int elitism, double mr, uint64_t seed, int gen)
 {
-    for(int i=elitism;i<popSize;i++)
+    Chromosome **pop = P->pop, **next = P->next;
+    //elites to the front, best first, without sorting the rest
+    if(selectionElites(sel, pop, P->size, elitism) != 0)
+    {
+        printf("Out of memory selecting generation %d\n", gen);
+        exit(1);
+    }
+    //slot i starts as pop[i]: elites stay, children keep the genes crossover does not cover
+    for(int i=0;i<P->size;i++)
+        copyChromosome(next[i],pop[i],P->geneLength);
+    for(int i=elitism;i<P->size;i++)
     {
+        Rng rng;
+        rngStream(&rng, seed, RNG_STREAM_REPRODUCE, (uint64_t)gen, (uint64_t)i);
         int a, b;
-        selectParents(elitism, &a, &b);
-        crossover(pop[a],pop[b],pop[i],geneLength);
-        mutate(pop[i],geneLength,mr);
-        pop[i]->fitness = 0;
+        selectParents(sel, elitism, &a, &b, &rng);
+        crossover(pop[a],pop[b],next[i],P->geneLength,&rng);
+        mutate(next[i],P->geneLength,mr,&rng);
+        next[i]->fitness = 0;
     }
+    populationSwap(P);
 }
 
-void createPopulation(Chromosome** pop, int population, int geneLength)
+void createPopulation(Population *P, uint64_t seed)
 {
-    for (int i = 0; i < population; ++i) {
-        pop[i] = createChromosome(geneLength);
-        randomChromosome(pop[i],geneLength); //for testing
+    for (int i = 0; i < P->size; ++i) {
+        Rng rng;
+        rngStream(&rng, seed, RNG_STREAM_INIT, 0, (uint64_t)i);
+        randomChromosome(P->pop[i],P->geneLength,&rng); //for testing
+        P->pop[i]->fitness = 0;
     }
 }
 
-int savePopulation(const char *path, Chromosome **pop, Hyper* hyperparm)
+static void checkpointHeader(CheckpointHeader *h, const Hyper *hyperparm, uint64_t seed)
+{
+    memset(h, 0, sizeof *h);
+    h->generation = hyperparm->generation;
+    h->population = hyperparm->population;
+    h->geneLength = hyperparm->geneLength;
+    h->elitism = hyperparm->elitism;
+    h->generations = hyperparm->generations;
+    h->saveEvery = hyperparm->saveEvery;
+    h->mutation = hyperparm->mutation;
+    h->seed = seed;
+}
+
+//binary checkpoint of pop, written on the writer's thread (see checkpoint.h)
+int savePopulation(CheckpointWriter *w, const char *path, Chromosome **pop, const Hyper *hyperparm, uint64_t seed)
 {
+    CheckpointHeader h;
     if (!path || !pop || hyperparm->population <= 0 || hyperparm->geneLength <= 1) return -1;
-    FILE *f = fopen(path, "w");
-    if (!f) return -1;
-    fprintf(f, "# generation=%d population=%d geneLength=%d elitism=%d generations=%d saveEvery=%d mutation=%f\n", 
-            hyperparm->generation, //current generation
-            hyperparm->population,
-            hyperparm->geneLength, 
-            hyperparm->elitism,
-            hyperparm->generations,
-            hyperparm->saveEvery,
-            hyperparm->mutation);
-
-    for (int i = 0; i < hyperparm->population; ++i) {
-        Chromosome *c = pop[i];
-        if (!c || !c->genes) {
-            if (fprintf(f, "0 ") < 0) { fclose(f); return -1; }
-            for (int g = 0; g < hyperparm->geneLength; ++g) if (fputc('0', f) == EOF) { fclose(f); return -1; }
-            if (fputc('\n', f) == EOF) { fclose(f); return -1; }
-            continue;
-        }
-        if (fprintf(f, "%d ", c->fitness) < 0) { fclose(f); return -1; }
-        for (int g = 0; g < hyperparm->geneLength; ++g) {
-            if (fputc(c->genes[g] ? '1' : '0', f) == EOF) { fclose(f); return -1; }
-        }
-        if (fputc('\n', f) == EOF) { fclose(f); return -1; }
+    checkpointHeader(&h, hyperparm, seed);
+    if (checkpointWriterSave(w, path, &h, pop) != 0) {
+        printf("Could not save checkpoint %s\n", path);
+        return -1;
     }
-
-    fclose(f);
     return 0;
 }
 
@@ -330,6 +333,26 @@ int parseDataLine(char *line, int *out_fit, char **out_bits) {
     return 0;
 }
 
+//shape and hyperparameters from the # header of an old text checkpoint
+int loadPopulationHeader(const char *path, Hyper* hyperparm)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char *line = NULL;
+    size_t len = 0;
+    int found = -1;
+    while (getline(&line, &len, f) != -1) {
+        trim_inplace(line);
+        if (line[0] == '\0') continue;
+        if (line[0] == '#') { parseHeader(line, hyperparm); found = 0; }
+        break;
+    }
+    free(line);
+    fclose(f);
+    return found;
+}
+
+//imports an old text checkpoint ('0'/'1' per gene), pop shaped by loadPopulationHeader()
 int loadPopulation(const char *path, Chromosome **pop, Hyper* hyperparm)
 {
     if (!path || !pop) return -1;
@@ -364,7 +387,7 @@ int loadPopulation(const char *path, Chromosome **pop, Hyper* hyperparm)
             if (!c) continue;
             pop[filled] = c;
         }
-        for (int i = 0; i < hyperparm->geneLength; ++i) c->genes[i] = (bits[i] == '1') ? 1 : 0;
+        for (int i = 0; i < hyperparm->geneLength; ++i) geneSet(c, i, bits[i] == '1');
         c->fitness = fit;
         filled++;
     }
@@ -389,7 +412,7 @@ void removeNumericSuffix(char *s) {
 
 int main(int argc, char **argv)
 {
-    srand(time(NULL));
+    uint64_t seed = (uint64_t)time(NULL); // every random draw derives from this, see rng.h
     char path[100] = "checkpoint";
     int resume = 0;
     int geneLength = 64;
@@ -399,6 +422,9 @@ int main(int argc, char **argv)
     int generation = 1;
     int saveEvery = 100;
     double mutation = 0.02;
+    int threads = 0; // fitness threads, 0 = every core
+    Selection sel;   // parent selection, see selection.h
+    selectionDefaults(&sel);
 
     Hyper hyperparm = {
         generation, //this technically isnt a hyperparamter
@@ -414,7 +440,7 @@ int main(int argc, char **argv)
     if(argc > 1)
     {
         //arguments are 
-        //continue checkpointPath genelength popsize elitism generation saveEvery mutation
+        //continue checkpointPath genelength popsize elitism generation saveEvery mutation seed
         if(argc >= 2)
         {
             resume = atoi(argv[1]);
@@ -448,17 +474,73 @@ int main(int argc, char **argv)
             char* endptr;
             hyperparm.mutation = strtod(argv[8], &endptr);
         }
+        if(argc >= 10)
+        {
+            seed = strtoull(argv[9], NULL, 10);
+        }
+        if(argc >= 11)
+        {
+            threads = atoi(argv[10]);
+        }
+        if(argc >= 12)
+        {
+            int mode = selectionParse(argv[11]);
+            if(mode < 0)
+            {
+                printf("Unknown selection %s (elite, tournament, rank)\n", argv[11]);
+                return 1;
+            }
+            sel.mode = (SelectMode)mode;
+        }
     }
-    Chromosome **pop = malloc((size_t)population * sizeof(Chromosome*));
+    Population P = {0};
     if(resume)
     {
-        FILE *f = fopen(path, "r");
-        if (!f)
+        //binary checkpoints map straight in, text ones are imported
+        Checkpoint ck;
+        int rc = checkpointOpen(path, &ck);
+        if(rc == CHECKPOINT_OK)
         {
-            printf("Checkpoint %s does not exist\n", path);
-            return 0;
+            const CheckpointHeader *h = ck.h;
+            hyperparm.generation = h->generation;
+            hyperparm.population = h->population;
+            hyperparm.geneLength = h->geneLength;
+            hyperparm.elitism = h->elitism;
+            hyperparm.generations = h->generations;
+            hyperparm.saveEvery = h->saveEvery;
+            hyperparm.mutation = h->mutation;
+            seed = h->seed;
+            if(populationInit(&P, hyperparm.population, hyperparm.geneLength) != 0)
+            {
+                printf("Could not allocate a population of %d\n", hyperparm.population);
+                return 1;
+            }
+            for(int i = 0; i < P.size; i++) checkpointGet(&ck, i, P.pop[i]);
+            checkpointClose(&ck);
+        }
+        else if(rc == CHECKPOINT_ERR_FORMAT && loadPopulationHeader(path, &hyperparm) == 0)
+        {
+            if(populationInit(&P, hyperparm.population, hyperparm.geneLength) != 0)
+            {
+                printf("Could not allocate a population of %d\n", hyperparm.population);
+                return 1;
+            }
+            if(loadPopulation(path, P.pop, &hyperparm) != P.size)
+            {
+                printf("Checkpoint %s is incomplete\n", path);
+                return 1;
+            }
+        }
+        else
+        {
+            printf("Checkpoint %s %s\n", path, rc == CHECKPOINT_ERR_IO ? "does not exist" : "is damaged");
+            return rc == CHECKPOINT_ERR_IO ? 0 : 1;
         }
-        loadPopulation(path, pop, &hyperparm);
+    }
+    else if(populationInit(&P, hyperparm.population, hyperparm.geneLength) != 0)
+    {
+        printf("Could not allocate a population of %d\n", hyperparm.population);
+        return 1;
     }
     printf("%s training using %s\n", resume ? "Resume" : "New", path);
     removeNumericSuffix(path);
@@ -468,31 +550,49 @@ int main(int argc, char **argv)
     printf("\tGenerations: %d\n", hyperparm.generations);
     printf("\tSave Every: %d\n", hyperparm.saveEvery);
     printf("\tMutation Rate: %f\n", hyperparm.mutation);
+    printf("\tSeed: %llu\n", (unsigned long long)seed);
+    printf("\tSelection: %s\n", sel.mode == SELECT_TOURNAMENT ? "tournament" : sel.mode == SELECT_RANK ? "rank" : "elite");
     if(hyperparm.elitism < 3)
     {
         printf("Elitism of %d is too low (elitism >= 3)\n", hyperparm.elitism);
         return 0;
     }
-    createPopulation(pop, population, hyperparm.geneLength);
-    evaluate(pop, fitness, population, hyperparm.geneLength);
-    savePopulation(path, pop, &hyperparm);
+    if(evalPoolStart(&evalPool, threads) != 0)
+    {
+        printf("Could not start evaluation threads, evaluating on one core\n");
+    }
+    CheckpointWriter writer;
+    if(checkpointWriterStart(&writer) != 0)
+    {
+        printf("Could not start the checkpoint thread, saving in the loop\n");
+    }
+    if(!resume)
+    {
+        createPopulation(&P, seed);
+        evaluate(P.pop, fitness, P.size, P.geneLength);
+        savePopulation(&writer, path, P.pop, &hyperparm, seed);
+    }
     //loop
     printf("Starting from generation %d\n", hyperparm.generation);
     int start = hyperparm.generation+1;
     for(int i = start;i<=hyperparm.generations;i++)
     {
-        reproduce(pop, hyperparm.elitism, hyperparm.mutation, hyperparm.population, hyperparm.geneLength);
-        evaluate(pop, fitness, hyperparm.population ,hyperparm.geneLength);
-        if(i%saveEvery==0)
+        reproduce(&P, &sel, hyperparm.elitism, hyperparm.mutation, seed, i);
+        evaluate(P.pop, fitness, P.size, P.geneLength);
+        if(i%hyperparm.saveEvery==0)
         {
             char buf[256];
             snprintf(buf, sizeof buf, "%s-%d", path, i);
             hyperparm.generation = i;
-            savePopulation(buf, pop, &hyperparm);
+            savePopulation(&writer, buf, P.pop, &hyperparm, seed);
         }
     }
     printf("Trained for %d generations\n", hyperparm.generations);
     printf("Population:\n---------------------------------------------------------\n");
-    printPopulation(pop, population, geneLength);
+    printPopulation(P.pop, P.size, P.geneLength);
+    checkpointWriterStop(&writer);
+    evalPoolStop(&evalPool);
+    selectionFree(&sel);
+    populationFree(&P);
     return 0;
 }
\ No newline at end of file
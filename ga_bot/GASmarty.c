@@ -7,6 +7,11 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include "sqlite3.h"
+#include "gaRules.h"
+#include "wallSweep.h"
+#include "distField.h"
+#include "sensorFrame.h"
+#include "coord.h"
 
 // #define DEBUGTURN
 #define DEBUGTHRUST
@@ -28,229 +33,103 @@
 #define THRUSTDEBUG(x)
 #endif
 
-typedef struct
-{
-  int aimDir;
-  double frontWall;
-  double wall5;
-  double backWall;
-  double wall7;
-  double heading;
-  double tracking;
-  double trackWall;
-  double closest;
-  int closestAngle;
-  double furthest;
-  int furthestAngle;
-  int shotDanger;
-  int speed;
-  int headingTrackingDiff;
-  int headingAimingDiff;
-} State;
-
-typedef struct
-{
-  int priority;
-  int result;
-} Inference;
+Chromosome *globalChromosome;
+DistField mapField; // loaded from -distfield, empty otherwise
+SensorFrame frame;  // this tick's snapshot, see sensorFrame.h
+FILE *frameLog;     // -framelog file, NULL when not logging
+int coordFd = -1;   // -coord socket: each life plays a chromosome from the coordinator
+GaJob job;          // the one being played
+int hasJob;
+int coordLeaseMs = 3000; // the coordinator's lease, from its answers to EXTEND
 
-uint8_t paramFromChromosome(const Chromosome *chrom, int offset, int length)
+// -coord path: connects to the coordinator (coordinator.c) and strips the
+// option, 0 on success, -1 when it is not there or cannot be reached
+static int coordArgs(int *argc, char *argv[])
 {
-  if (!chrom || !chrom->genes || length <= 0 || length > 8)
-    return 0;
-  uint8_t value = 0;
-  for (int i = 0; i < length; i++)
+  for (int i = 1; i + 1 < *argc; i++)
   {
-    bit_t bit = chrom->genes[offset + i] & 1;
-    value = (value << 1) | bit;
+    if (strcmp(argv[i], "-coord") != 0)
+      continue;
+    coordFd = coord_connect(argv[i + 1]);
+    if (coordFd < 0)
+      fprintf(stderr, "cannot reach the coordinator at %s\n", argv[i + 1]);
+    for (int j = i; j + 2 <= *argc; j++)
+      argv[j] = argv[j + 2];
+    *argc -= 2;
+    return coordFd < 0 ? -1 : 0;
   }
-  return value;
-}
-// General helper to read N consecutive parameters
-void readNParams(const Chromosome *chrom, int start, int N, uint8_t *out)
-{
-  for (int i = 0; i < N; ++i)
-    out[i] = paramFromChromosome(chrom, start + i * 8, chrom->length);
+  return -1;
 }
 
-// chromosome structure:
-//  all parameters are between 0 and 511, so we use 8 bits per number
-
-// for rp: output 0 for nothing, 1 for thruster,
-// for tr: output 0 for nothing, 1 for turnRight, -1 for turnLeft, 2 for turn to aimdir
-Inference ruleExample(State state, Chromosome chromosome)
-{
-  return (Inference){0, 0};
-}
-
-typedef unsigned char bit_t; /* 0 or 1 */
-
-typedef struct
-{
-  bit_t *genes;
-  int fitness;
-  int length; // number of bits in the chromosome
-} Chromosome;
-
-// rp are propulsion rules
-// rt are turning rules
-
-#define R1 5 // number of parameters in this rule
-Inference rp1(State state, const Chromosome *chromosome)
-{
-  uint8_t p[R1];
-  readNParams(chromosome, 0, R1, p);
-  int priority = p[0];
-  int value = state.shotDanger > p[1] && state.shotDanger < p[2] && state.frontWall > p[3] && state.trackWall > p[4] ? 1 : 0;
-  return (Inference){priority, value};
-}
-#define R2 4
-Inference rp2(State state, Chromosome chromosome)
-{
-  uint8_t p[R2];
-  readNParams(chromosome, R1, R2, p);
-  int priority = p[0];
-  int value = (state.furthestAngle == p[1]) && state.speed < p[2] && state.frontWall > p[3] ? 1 : 0;
-  return (Inference){priority, value};
-}
-#define R3 5
-Inference rp3(State state, Chromosome chromosome)
-{
-  uint8_t p[R3];
-  readNParams(chromosome, R1 + R2, R3, p);
-  int priority = p[0];
-  int value = (state.headingTrackingDiff > p[1] && state.headingTrackingDiff < p[2] && state.trackWall < p[3] && state.frontWall > p[4]) ? 1 : 0;
-  return (Inference){priority, value};
-}
-#define R4 3
-Inference rp4(State state, Chromosome chromosome)
-{
-  uint8_t p[R4];
-  readNParams(chromosome, R1 + R2 + R3, R4, p);
-  int priority = p[0];
-  int value = (state.backWall < p[1] && state.frontWall > p[2]) ? 1 : 0;
-  return (Inference){priority, value};
-}
-#define R5 5
-Inference rp5(State state, Chromosome chromosome)
+// a new life: play the next chromosome that waits for evaluation, if any
+static void coordTakeJob(void)
 {
-  uint8_t p[R5];
-  readNParams(chromosome, R1 + R2 + R3 + R4, R5, p);
-  int priority = p[0];
-  int value = (state.headingTrackingDiff > p[1] && state.headingTrackingDiff < p[2] && state.trackWall < p[3] && state.frontWall > p[4]) ? 1 : 0;
-  return (Inference){priority, value};
-}
-#define R6 4
-Inference rp6(State state, Chromosome chromosome)
-{
-  uint8_t p[R6];
-  readNParams(chromosome, R1 + R2 + R3 + R4 + R5, R6, p);
-  int priority = p[0];
-  int value = ((state.wall5 < p[1] || state.wall7 < p[2]) && state.frontWall > p[3]) ? 1 : 0;
-  return (Inference){priority, value};
-}
-#define R7 3
-Inference tr1(State state, Chromosome chromosome)
-{
-  uint8_t p[R7];
-  readNParams(chromosome, R1 + R2 + R3 + R4 + R5 + R6, R7, p);
-  int priority = p[0];
-  int value = 0;
-  if (state.speed > p[1] && state.headingTrackingDiff < 180 - p[2])
+  if (coordFd < 0 || hasJob)
+    return;
+  int n = coord_claim(coordFd, &job, 1, 0);
+  if (n < 0)
   {
-    value = -1;
+    fprintf(stderr, "lost the coordinator\n");
+    close(coordFd);
+    coordFd = -1;
+    return;
   }
-  else if (state.speed > p[1] && state.headingTrackingDiff > 180 + p[2])
+  if (n == 0)
+    return; // keep playing the last one
+  if (job.geneLength != GA_RULES_BITS)
   {
-    value = 1;
+    // not a rule set of this bot: a score would be meaningless, so leave the
+    // run (the job goes back to the queue) rather than report one
+    fprintf(stderr, "job gen=%d idx=%d has %d genes, not %d: run the trainer with --rules\n", job.gen, job.idx,
+            job.geneLength, GA_RULES_BITS);
+    close(coordFd);
+    coordFd = -1;
+    return;
   }
-  return (Inference){priority, value};
+  memcpy(globalChromosome->genes, job.chrom.genes, GENE_WORDS(GA_RULES_BITS) * sizeof(gene_word_t));
+  hasJob = 1;
 }
-#define R8 4
-Inference tr2(State state, Chromosome chromosome)
-{
-  uint8_t p[R8];
-  readNParams(chromosome, R1 + R2 + R3 + R4 + R5 + R6 + R7, R8, p);
-  int priority = p[0];
-  int value = 0;
-  if (state.closest > p[1] && state.aimDir > p[2] && state.headingAimingDiff < 180 && state.headingAimingDiff > p[3])
-  {
-    TURNDEBUG(AR(printf("Aiming Roughly\n")));
-    value = 1;
-  }
-  else if (state.closest > p[1] && state.aimDir > p[2] && state.headingAimingDiff > 180 && state.headingAimingDiff < 360 - p[3])
-  {
-    TURNDEBUG(AR(printf("Aiming Roughly\n")));
-    value = -1;
-  }
-  return (Inference){priority, value};
-}
-#define R9 4
-Inference tr3(State state, Chromosome chromosome)
-{
-  uint8_t p[R9];
-  readNParams(chromosome, R1 + R2 + R3 + R4 + R5 + R6 + R7 + R8, R9, p);
-  int priority = p[0];
-  int value = (state.closest > p[1] && state.aimDir > p[2]) ? 2 : 0;
-  return (Inference){priority, value};
-}
-#define R10 4
-Inference tr4(State state, Chromosome chromosome)
+
+// a life can outlast the lease on its job: renew it every third of a lease,
+// frames counted at 24 a second
+static void coordKeepJob(void)
 {
-  uint8_t p[R10];
-  readNParams(chromosome, R1 + R2 + R3 + R4 + R5 + R6 + R7 + R8 + R9, R10, p);
-  int priority = p[0];
-  int value = 0;
-  if (state.speed > p[1] && state.closest < p[2] && state.closestAngle > p[3] && state.closestAngle <= 180)
-  {
-    value = 1;
-  }
-  // if the ship is already facing the furthest area, then turn away from nearby geometries
-  else if (state.speed > p[1] && state.closest < p[2] && state.closestAngle < 360 - p[3] && state.closestAngle > 180)
+  static int frames;
+  if (coordFd < 0 || !hasJob)
+    return;
+  int every = coordLeaseMs / 3 * 24 / 1000;
+  if (++frames < (every > 1 ? every : 1))
+    return;
+  frames = 0;
+  if (coord_extend(coordFd, &coordLeaseMs) != 0)
   {
-    value = -1;
+    fprintf(stderr, "lost the coordinator\n");
+    close(coordFd);
+    coordFd = -1;
   }
-  return (Inference){priority, value};
 }
-#define R11 4
-Inference tr5(State state, Chromosome chromosome)
+
+// the life is over, its length in frames is the chromosome's fitness
+static void coordReportJob(int life)
 {
-  uint8_t p[R11];
-  readNParams(chromosome, R1 + R2 + R3 + R4 + R5 + R6 + R7 + R8 + R9 + R10, R11, p);
-  int priority = p[0];
-  int value = 0;
-  if ((state.furthestAngle > p[1] && state.furthestAngle <= 180))
+  if (coordFd < 0 || !hasJob)
+    return;
+  job.chrom.fitness = life;
+  if (coord_report(coordFd, &job, 1) != 0)
   {
-    value = -1;
+    fprintf(stderr, "lost the coordinator\n");
+    close(coordFd);
+    coordFd = -1;
   }
-  // Always try to face the furthest area
-  else if ((state.furthestAngle < 360 - p[1] && state.furthestAngle > 180))
+  else
   {
-    value = 1;
+    // the same result line as the evaluators', DBFleet counts them
+    printf("[GASmarty] gen=%d idx=%d fitness=%d\n", job.gen, job.idx, life);
+    fflush(stdout);
   }
-  return (Inference){priority, value};
+  hasJob = 0;
 }
 
-Inference (*thrusterRules[])(State, const Chromosome *) = {
-    rp1,
-    rp2,
-    rp3,
-    rp4,
-    rp5,
-    rp6,
-};
-
-Inference (*turnRules[])(State, const Chromosome *) = {
-    tr1,
-    tr2,
-    tr3,
-    tr4,
-    tr5,
-    // add more here
-};
-
-Chromosome *globalChromosome;
-
 int AI_loop()
 {
   static int life = 0;
@@ -258,6 +137,7 @@ int AI_loop()
   { // if dead
     if (life > 0)
     {           // and we dont know yet,
+      coordReportJob(life);
       life = 0; // set to dead
     }
     return 0; // dont do anything
@@ -276,86 +156,57 @@ int AI_loop()
   {
     // just respawned
     // load chromosome
+    coordTakeJob();
+  }
+  else
+  {
+    coordKeepJob();
   }
 
   setTurnSpeedDeg(20);
-  int aimDir = aimdir(0);
+  sensorFrameCapture(&frame, 500);
+  if (frameLog)
+    sensorFrameWrite(frameLog, &frame);
+  int aimDir = frame.aimDir;
   // Release keys
   // Set variables
-  double heading = selfHeadingDeg();
-  double tracking = selfTrackingDeg();
-  double trackWall = wallFeeler(500, tracking);
-
-  // clockwise rotation around the ship
-  double frontWall = wallFeeler(500, heading);
-  double wall5 = wallFeeler(500, heading + 150);
-  double backWall = wallFeeler(500, heading + 180);
-  double wall7 = wallFeeler(500, heading + 210);
+  double closest = frame.closest;
+  int closestAngle = frame.closestAngle;
+  if (mapField.size)
+  {
+    // true distance to the nearest wall from the precomputed field
+    int wallDeg;
+    closest = distFieldClosest(&mapField, frame.x, frame.y, 500, &wallDeg);
+    closestAngle = ((wallDeg - (int)frame.headingDeg) % 360 + 360) % 360;
+  }
 
   int shouldThrust = 0;
   // turn right = 1, turn left = -1, turn to aimdir = 2
   int turnDir = 0;
 
-  double furthest = 0.0;
-  int furthestAngle = 0;
-  double closest = 600.0;
-  int closestAngle = 0;
-  for (int i = 0; i < 360; i++)
-  {
-    double dist = wallFeeler(500, heading + i);
-    if (dist > furthest)
-    {
-      furthest = dist;
-      furthestAngle = i;
-    }
-    if (dist < closest)
-    {
-      closest = dist;
-      closestAngle = i;
-    }
-  }
-  int headingTrackingDiff = (int)(heading + 360 - tracking) % 360;
-  int headingAimingDiff = (int)(heading + 360 - aimDir) % 360;
+  int headingAimingDiff = frame.headingAimingDiff;
 
+  // walls[i] is the feeler at heading + i
   State s = {
       aimDir,
-      frontWall,
-      wall5,
-      backWall,
-      wall7,
-      heading,
-      tracking,
-      trackWall,
+      frame.walls[0],
+      frame.walls[150],
+      frame.walls[180],
+      frame.walls[210],
+      frame.headingDeg,
+      frame.trackingDeg,
+      frame.trackWall,
       closest,
       closestAngle,
-      furthest,
-      furthestAngle,
-      shotAlert(0),
-      selfSpeed(),
-      headingTrackingDiff,
+      frame.furthest,
+      frame.furthestAngle,
+      frame.shotDanger,
+      frame.speed,
+      frame.headingTrackingDiff,
       headingAimingDiff,
   };
 
-  int prioThrust = 0.0;
-  for (int i = 0; i < sizeof(thrusterRules) / sizeof(thrusterRules[0]); i++)
-  {
-    Inference inf = thrusterRules[i](s, NULL);
-    if (prioThrust < inf.priority)
-    {
-      prioThrust = inf.priority;
-      shouldThrust = inf.result;
-    }
-  }
-  int prioTurn = 0.0;
-  for (int i = 0; i < sizeof(turnRules) / sizeof(turnRules[0]); i++)
-  {
-    Inference inf = turnRules[i](s, NULL);
-    if (prioThrust < inf.priority)
-    {
-      prioThrust = inf.priority;
-      turnDir = inf.result;
-    }
-  }
+  gaRulesDecide(&s, globalChromosome, &shouldThrust, &turnDir);
 
   if (headingAimingDiff < 90 || headingAimingDiff > 270)
   {
@@ -391,7 +242,14 @@ int AI_loop()
 }
 int main(int argc, char *argv[])
 {
-  const int chromosomeSize = (R1 + R2 + R3 + R4 + R5 + R6 + R7 + R8 + R9 + R10 + R11) * 8; // total chromosome length in bits
+  static gene_word_t genes[GENE_WORDS(GA_RULES_BITS)];
+  static Chromosome chromosome = {genes, 0};
+  globalChromosome = &chromosome;
+  // optional: -distfield map.df, written by sim/mkdistfield
+  distFieldArgs(&mapField, &argc, argv);
+  frameLog = sensorFrameLogArgs(&argc, argv);
+  // optional: -coord ga.sock, evaluate chromosomes for the DB trainer (run with --external --rules)
+  coordArgs(&argc, argv);
 
   return start(argc, argv);
 }
@@ -0,0 +1,122 @@
+// Build: ./build_archive_test.sh
+// Usage:
+//   ./DBGATrainer --db ga.db --seed 7 --archive-every 0   (leaves individuals_archive unpacked)
+//   ./DBArchiveTest --db ga.db
+//
+// Round trip of the generation archive on a real database: every generation
+// still in individuals_archive is read, rolled into generation_archive by
+// gadb_archive_roll() like the trainer does, read back unpacked and compared
+// field by field.  Exits 1 on the first difference.  It packs the database
+// it is given, as the trainer's next roll would.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sqlite3.h>
+
+#include "gadb.h"
+
+typedef struct {
+    GaPackRow *rows;         // genes copied, rows[i].genes owned
+    int n, cap;
+} RowSet;
+
+static void row_keep(void *arg, const GaPackRow *row) {
+    RowSet *set = arg;
+    if (set->n == set->cap) {
+        int cap = set->cap ? 2 * set->cap : 64;
+        GaPackRow *r = realloc(set->rows, (size_t)cap * sizeof *r);
+        if (!r) { fprintf(stderr, "out of memory\n"); exit(1); }
+        set->rows = r;
+        set->cap = cap;
+    }
+    unsigned char *genes = malloc((size_t)(row->bytes > 0 ? row->bytes : 1));
+    if (!genes) { fprintf(stderr, "out of memory\n"); exit(1); }
+    memcpy(genes, row->genes, (size_t)row->bytes);
+    set->rows[set->n] = *row;
+    set->rows[set->n++].genes = genes;
+}
+
+static void rows_free(RowSet *set) {
+    for (int i = 0; i < set->n; ++i) free((void *)set->rows[i].genes);
+    free(set->rows);
+    memset(set, 0, sizeof *set);
+}
+
+// the first field a and b differ in, NULL when they are the same row
+static const char *row_diff(const GaPackRow *a, const GaPackRow *b) {
+    if (a->idx != b->idx) return "idx";
+    if (a->gene_len != b->gene_len) return "gene_len";
+    if (a->island != b->island) return "island";
+    if (a->has_fitness != b->has_fitness || (a->has_fitness && a->fitness != b->fitness)) return "fitness";
+    if (a->has_done_ts != b->has_done_ts || (a->has_done_ts && a->done_ts != b->done_ts)) return "done_ts";
+    if (a->bytes != b->bytes || memcmp(a->genes, b->genes, (size_t)a->bytes) != 0) return "genes";
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    const char *db_path = "ga.db";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--db") == 0 && i + 1 < argc) db_path = argv[++i];
+    }
+
+    GaDb g;
+    int rc = gadb_open(&g, db_path);
+    if (rc != SQLITE_OK) gadb_die(&g, "sqlite3_open failed", rc);
+    gadb_init_schema(&g);
+
+    sqlite3_stmt *st = NULL;
+    rc = sqlite3_prepare_v2(g.db, "SELECT DISTINCT gen FROM individuals_archive ORDER BY gen;", -1, &st, NULL);
+    if (rc != SQLITE_OK) gadb_die(&g, "prepare failed", rc);
+    int *gens = NULL, ngens = 0, cap = 0;
+    while (sqlite3_step(st) == SQLITE_ROW) {
+        if (ngens == cap) {
+            cap = cap ? 2 * cap : 64;
+            gens = realloc(gens, (size_t)cap * sizeof *gens);
+            if (!gens) { fprintf(stderr, "out of memory\n"); return 1; }
+        }
+        gens[ngens++] = sqlite3_column_int(st, 0);
+    }
+    sqlite3_finalize(st);
+    if (ngens == 0) {
+        fprintf(stderr, "%s has no unpacked generations: run the trainer with --archive-every 0\n", db_path);
+        gadb_close(&g);
+        return 1;
+    }
+
+    RowSet *before = calloc((size_t)ngens, sizeof *before);
+    if (!before) { fprintf(stderr, "out of memory\n"); return 1; }
+    for (int k = 0; k < ngens; ++k) gadb_generation_rows(&g, gens[k], row_keep, &before[k]);
+
+    GaDbArchived a = { 0 };
+    gadb_archive_roll(&g, gens[ngens - 1] + 1, &a);
+
+    int failed = 0;
+    long rows = 0;
+    for (int k = 0; k < ngens && !failed; ++k) {
+        RowSet after = { 0 };
+        long n = gadb_generation_rows(&g, gens[k], row_keep, &after);
+        if (n != before[k].n) {
+            fprintf(stderr, "gen %d: %d rows before the roll, %ld after\n", gens[k], before[k].n, n);
+            failed = 1;
+        }
+        for (int i = 0; i < after.n && i < before[k].n && !failed; ++i) {
+            const char *what = row_diff(&before[k].rows[i], &after.rows[i]);
+            if (what) {
+                fprintf(stderr, "gen %d idx %d: %s differs after the roll\n", gens[k], before[k].rows[i].idx, what);
+                failed = 1;
+            }
+        }
+        rows += after.n;
+        rows_free(&after);
+    }
+
+    if (!failed)
+        printf("%d generations, %ld rows packed into %lld bytes (%lld unpacked) and read back unchanged\n",
+               ngens, rows, a.packed, a.raw);
+    for (int k = 0; k < ngens; ++k) rows_free(&before[k]);
+    free(before);
+    free(gens);
+    gadb_close(&g);
+    return failed;
+}
@@ -0,0 +1,3 @@
+#!/bin/bash
+
+gcc -I../include archive_test.c sqlite3.c -lm -lpthread -o DBArchiveTest
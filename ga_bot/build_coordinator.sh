@@ -0,0 +1,3 @@
+#!/bin/bash
+
+gcc -I../include coordinator.c sqlite3.c -lm -lpthread -o DBCoordinator
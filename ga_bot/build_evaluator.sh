@@ -1,3 +1,3 @@
 #!/bin/bash
 
-gcc evaluator_test.c sqlite3.c -lm -lpthread -o DBEvaluatorTest
+gcc -I../include evaluator_test.c sqlite3.c -lm -lpthread -o DBEvaluatorTest
@@ -0,0 +1,3 @@
+#!/bin/bash
+
+gcc -I../include fleet.c -o DBFleet
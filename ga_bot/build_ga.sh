@@ -1,3 +1,3 @@
 #!/bin/bash
 
-gcc ga.c sqlite3.c -lm -lpthread -o DBGATrainer
+gcc -I../include -I../sim ga.c ../sim/sim.c ../sim/simBatch.c sqlite3.c -lm -lpthread -o DBGATrainer
@@ -0,0 +1,159 @@
+// Wire protocol of the coordinator (coordinator.c) and its client side.
+//
+// The coordinator is the evaluators' work queue: it leases rows from the
+// database in large batches, keeps pending, claimed and done in memory and
+// writes results back in batches on its own thread, so a claim or a report
+// is one round trip over a Unix socket and never waits for SQLite.
+//
+// Every message is a CoordHeader followed by bytes of payload, in host byte
+// order (both ends are on one machine):
+//   CLAIM   count = most jobs wanted, arg = ms to wait for work (0: answer now)
+//   JOBS    count = n, payload n x (CoordJobWire + its packed genes), n = 0 when none came
+//   REPORT  count = n, payload n x CoordResultWire
+//   EXTEND  no payload: the client is still busy with the jobs it holds
+//   ACK     count = results taken (the rest were late duplicates), arg = the lease in ms
+// Every message renews the leases of the jobs its connection holds; a client
+// busy for longer than the lease without claiming or reporting sends EXTEND
+// every third of it.
+#ifndef COORD_H
+#define COORD_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "chromosome.h"
+#include "gajob.h"
+
+#define COORD_MAGIC 0x51414758u /* "XGAQ" */
+#define COORD_MAX_BATCH 4096    /* jobs per CLAIM or results per REPORT */
+
+enum { COORD_CLAIM = 1, COORD_JOBS, COORD_REPORT, COORD_ACK, COORD_EXTEND };
+
+typedef struct {
+    uint32_t magic;
+    uint16_t type;
+    uint16_t count;
+    uint32_t arg;
+    uint32_t bytes;          // payload that follows
+} CoordHeader;
+
+typedef struct {
+    uint32_t token;          // echoed in the report
+    int32_t gen, idx;
+    int32_t geneLength;      // the genes follow, GENE_BYTES(geneLength) of them, genePack()ed
+} CoordJobWire;
+
+typedef struct {
+    uint32_t token;
+    int32_t gen, idx;
+    int32_t fitness;
+} CoordResultWire;
+
+// ---------- I/O ----------
+static inline int coord_write_all(int fd, const void *buf, size_t n) {
+    const char *p = buf;
+    while (n > 0) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+static inline int coord_read_all(int fd, void *buf, size_t n) {
+    char *p = buf;
+    while (n > 0) {
+        ssize_t r = read(fd, p, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        p += r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+// ---------- Client ----------
+// socket connected to the coordinator at path, -1 on failure
+static inline int coord_connect(const char *path) {
+    struct sockaddr_un a;
+    memset(&a, 0, sizeof a);
+    a.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof a.sun_path) return -1;
+    strcpy(a.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&a, sizeof a) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Claims up to k jobs into jobs[0..k), waiting up to wait_ms for some to
+// come in.  Returns how many (0: none in time), -1 when the connection failed.
+static inline int coord_claim(int fd, GaJob *jobs, int k, int wait_ms) {
+    if (k > COORD_MAX_BATCH) k = COORD_MAX_BATCH;
+    CoordHeader h = { COORD_MAGIC, COORD_CLAIM, (uint16_t)k, (uint32_t)(wait_ms > 0 ? wait_ms : 0), 0 };
+    if (coord_write_all(fd, &h, sizeof h) != 0) return -1;
+    if (coord_read_all(fd, &h, sizeof h) != 0 || h.magic != COORD_MAGIC || h.type != COORD_JOBS || h.count > k)
+        return -1;
+    unsigned char *blob = NULL;
+    int cap = 0;
+    for (int i = 0; i < h.count; ++i) {
+        CoordJobWire w;
+        if (coord_read_all(fd, &w, sizeof w) != 0 || w.geneLength < 0) { free(blob); return -1; }
+        int bytes = GENE_BYTES(w.geneLength);
+        if (bytes > cap) {
+            unsigned char *b = realloc(blob, (size_t)bytes);
+            if (!b) { free(blob); return -1; }
+            blob = b;
+            cap = bytes;
+        }
+        if (coord_read_all(fd, blob, (size_t)bytes) != 0) { free(blob); return -1; }
+        jobs[i].token = w.token;
+        jobs[i].gen = w.gen;
+        jobs[i].idx = w.idx;
+        ga_job_unpack(&jobs[i], w.geneLength, blob, bytes, 1);
+    }
+    free(blob);
+    return h.count;
+}
+
+// Reports the fitness of jobs[0..n).  Returns 0, -1 when the connection failed.
+static inline int coord_report(int fd, const GaJob *jobs, int n) {
+    for (int i = 0; i < n; ) {
+        int m = n - i < COORD_MAX_BATCH ? n - i : COORD_MAX_BATCH;
+        CoordResultWire r[64];
+        CoordHeader h = { COORD_MAGIC, COORD_REPORT, (uint16_t)m, 0, (uint32_t)(m * sizeof *r) };
+        if (coord_write_all(fd, &h, sizeof h) != 0) return -1;
+        for (int j = 0; j < m; j += 64) {
+            int c = m - j < 64 ? m - j : 64;
+            for (int t = 0; t < c; ++t) {
+                const GaJob *job = &jobs[i + j + t];
+                r[t] = (CoordResultWire){ job->token, job->gen, job->idx, job->chrom.fitness };
+            }
+            if (coord_write_all(fd, r, (size_t)c * sizeof *r) != 0) return -1;
+        }
+        if (coord_read_all(fd, &h, sizeof h) != 0 || h.magic != COORD_MAGIC || h.type != COORD_ACK) return -1;
+        i += m;
+    }
+    return 0;
+}
+
+// Renews the leases of the jobs this connection holds; *lease_ms, when not
+// NULL, gets the lease.  Returns 0, -1 when the connection failed.
+static inline int coord_extend(int fd, int *lease_ms) {
+    CoordHeader h = { COORD_MAGIC, COORD_EXTEND, 0, 0, 0 };
+    if (coord_write_all(fd, &h, sizeof h) != 0) return -1;
+    if (coord_read_all(fd, &h, sizeof h) != 0 || h.magic != COORD_MAGIC || h.type != COORD_ACK) return -1;
+    if (lease_ms) *lease_ms = (int)h.arg;
+    return 0;
+}
+
+#endif
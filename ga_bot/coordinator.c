@@ -0,0 +1,642 @@
+// Build: ./build_coordinator.sh
+// Usage:
+//   ./DBCoordinator --db ga.db --socket ga.sock
+//   ./DBCoordinator --db ga.db --socket ga.sock --prefetch 1024 --flush-ms 20 --lease-ms 10000
+//   ./DBEvaluatorTest --coord ga.sock --loop
+//
+// Work queue between the trainer's database and the evaluators.  A database
+// thread leases pending rows in batches of up to --prefetch (as one worker,
+// see gadb.h, heartbeats included) and writes the results that come back in
+// one transaction every --flush-ms, or at once when a batch or a whole
+// generation is complete.  The main thread keeps those rows in memory and
+// serves CLAIM and REPORT over the socket (protocol in coord.h) without
+// touching SQLite.  Jobs of an evaluator that disconnects, or is not heard
+// from (any message, EXTEND while busy) for --lease-ms, go back to the
+// queue; a late result for one of them takes it out of the queue again, and
+// results for jobs already reported are dropped.  Client sockets do not
+// block: a reply the socket cannot take yet waits in the client's buffer, no
+// more of its messages are read until it is out, and a client that leaves it
+// there for a lease (or lets it grow past MAX_CLIENT_OUT) is dropped.  On
+// SIGINT/SIGTERM pending results are written and the rows still held are
+// returned to pending.
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sqlite3.h>
+
+#include "chromosome.h"
+#include "gadb.h"
+#include "coord.h"
+
+#define MAX_CLIENTS 1024
+#define MAX_CLIENT_OUT (64 << 20) // reply bytes a client may leave unread
+
+// ---------- Jobs (main thread) ----------
+typedef enum { JOB_FREE, JOB_PENDING, JOB_CLAIMED, JOB_CANCELLED } JobState;
+
+typedef struct {
+    int gen, idx, geneLength;
+    unsigned char *genes;    // packed, GENE_BYTES(geneLength)
+    JobState state;
+    int client;              // holder while claimed
+    long claimed_ms;
+    int next;                // pending FIFO or free list, -1 ends them
+} Job;                       // JOB_CANCELLED: reported while pending, freed when it leaves the FIFO
+
+static Job *g_jobs;
+static int g_njobs, g_free = -1;
+static int g_head = -1, g_tail = -1, g_pending, g_claimed;
+
+static int job_alloc(void) {
+    if (g_free < 0) {
+        int n = g_njobs ? 2 * g_njobs : 256;
+        Job *j = realloc(g_jobs, (size_t)n * sizeof *j);
+        if (!j) { fprintf(stderr, "out of memory\n"); exit(1); }
+        memset(j + g_njobs, 0, (size_t)(n - g_njobs) * sizeof *j);
+        for (int i = n - 1; i >= g_njobs; --i) {
+            j[i].next = g_free;
+            g_free = i;
+        }
+        g_jobs = j;
+        g_njobs = n;
+    }
+    int s = g_free;
+    g_free = g_jobs[s].next;
+    return s;
+}
+
+static void job_release(int s) {
+    g_jobs[s].state = JOB_FREE;
+    g_jobs[s].next = g_free;
+    g_free = s;
+}
+
+static void job_enqueue(int s) {
+    g_jobs[s].state = JOB_PENDING;
+    g_jobs[s].next = -1;
+    if (g_tail >= 0) g_jobs[g_tail].next = s;
+    else g_head = s;
+    g_tail = s;
+    g_pending++;
+}
+
+static int job_dequeue(void) {
+    for (;;) {
+        int s = g_head;
+        if (s < 0) return -1;
+        g_head = g_jobs[s].next;
+        if (g_head < 0) g_tail = -1;
+        if (g_jobs[s].state == JOB_CANCELLED) { // not counted in g_pending any more
+            job_release(s);
+            continue;
+        }
+        g_pending--;
+        return s;
+    }
+}
+
+// ---------- Shared with the database thread ----------
+typedef struct {
+    int gen, idx, geneLength;
+    unsigned char *genes;    // packed, ownership moves to a Job
+} Incoming;
+
+static struct {
+    pthread_mutex_t lock;
+    Incoming *in;            // rows leased, not yet queued
+    int nin, incap;
+    CoordResultWire *res;    // results not yet written
+    int nres, rescap;
+    int want;                // jobs the queue would take
+    int kicked;              // db_wake written since the thread last woke
+    int quit;
+} g_q = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static int g_main_wake[2], g_db_wake[2]; // pipes: rows came in / work for the database thread
+static GaDb g_db;
+static GaDbWatch g_watch = { .fd = -1 };
+static sqlite3_int64 g_worker;
+static int g_prefetch = 256, g_flush_ms = 10, g_lease_ms = 30000;
+static volatile sig_atomic_t g_stop;
+
+static void die_sqlite(const char *msg, int rc) {
+    fprintf(stderr, "SQLite error: %s (rc=%d)\n", msg, rc);
+    exit(1);
+}
+
+static void pipe_kick(int fd) {
+    char c = 0;
+    ssize_t w = write(fd, &c, 1); // full pipe: a wake is pending anyway
+    (void)w;
+}
+
+static void pipe_drain(int fd) {
+    char buf[64];
+    while (read(fd, buf, sizeof buf) > 0) {}
+}
+
+// wakes the database thread, once until it runs; call with g_q.lock held
+static void db_kick_locked(void) {
+    if (!g_q.kicked) {
+        g_q.kicked = 1;
+        pipe_kick(g_db_wake[1]);
+    }
+}
+
+static void *db_thread(void *arg) {
+    (void)arg;
+    GaJob *tmp = calloc((size_t)g_prefetch, sizeof *tmp);
+    CoordResultWire *res = NULL;
+    int rescap = 0;
+    long next_beat = gadb_now_ms() + g_lease_ms / 3;
+    if (!tmp) { fprintf(stderr, "out of memory\n"); exit(1); }
+
+    for (;;) {
+        struct pollfd p[2] = { { g_db_wake[0], POLLIN, 0 }, { g_watch.fd, POLLIN, 0 } };
+        poll(p, g_watch.fd >= 0 ? 2 : 1, g_flush_ms);
+        pipe_drain(g_db_wake[0]);
+        gadb_watch_drain(&g_watch);
+
+        // take the results, swapping buffers
+        pthread_mutex_lock(&g_q.lock);
+        g_q.kicked = 0;
+        CoordResultWire *r = g_q.res;
+        int nres = g_q.nres, cap = g_q.rescap;
+        g_q.res = res;
+        g_q.rescap = rescap;
+        g_q.nres = 0;
+        res = r;
+        rescap = cap;
+        int need = g_q.want - g_q.nin;
+        int quit = g_q.quit;
+        pthread_mutex_unlock(&g_q.lock);
+
+        if (nres > 0) {
+            gadb_begin(&g_db);
+            for (int i = 0; i < nres; ++i) gadb_store_result(&g_db, res[i].gen, res[i].idx, (double)res[i].fitness);
+            gadb_commit(&g_db);
+        }
+        if (quit) break;
+
+        // refill, a read first so an idle queue takes no write lock
+        if (need > 0 && gadb_any_pending(&g_db)) {
+            int n = gadb_claim(&g_db, tmp, need < g_prefetch ? need : g_prefetch, g_worker, g_lease_ms);
+            if (n > 0) {
+                pthread_mutex_lock(&g_q.lock);
+                if (g_q.nin + n > g_q.incap) {
+                    int c = g_q.nin + n;
+                    Incoming *in = realloc(g_q.in, (size_t)c * sizeof *in);
+                    if (!in) { fprintf(stderr, "out of memory\n"); exit(1); }
+                    g_q.in = in;
+                    g_q.incap = c;
+                }
+                for (int i = 0; i < n; ++i) {
+                    int bytes = GENE_BYTES(tmp[i].geneLength);
+                    Incoming *in = &g_q.in[g_q.nin++];
+                    in->gen = tmp[i].gen;
+                    in->idx = tmp[i].idx;
+                    in->geneLength = tmp[i].geneLength;
+                    in->genes = malloc((size_t)(bytes > 0 ? bytes : 1));
+                    if (!in->genes) { fprintf(stderr, "out of memory\n"); exit(1); }
+                    genePack(&tmp[i].chrom, tmp[i].geneLength, in->genes);
+                }
+                pthread_mutex_unlock(&g_q.lock);
+                pipe_kick(g_main_wake[1]);
+            }
+        }
+
+        if (gadb_now_ms() >= next_beat) {
+            int rc = gadb_heartbeat(&g_db, g_worker, g_lease_ms);
+            if (rc != 0) fprintf(stderr, "[coordinator] heartbeat failed (rc=%d), retrying\n", rc);
+            next_beat = gadb_now_ms() + g_lease_ms / 3;
+        }
+    }
+
+    // everything still leased goes back to the other evaluators
+    gadb_release(&g_db, g_worker);
+    ga_jobs_free(tmp, g_prefetch);
+    free(tmp);
+    free(res);
+    return NULL;
+}
+
+// ---------- Clients (main thread) ----------
+typedef struct {
+    int fd;                  // -1: free slot
+    CoordHeader h;           // message being read
+    size_t got;              // of header and payload
+    unsigned char *buf;      // payload
+    size_t cap;
+    int parked;              // CLAIM waiting for work: most jobs wanted, 0 none
+    long deadline;
+    long seen_ms;            // last message, renews the leases of its jobs
+    unsigned char *out;      // reply bytes the socket did not take yet
+    size_t olen, ocap;
+    long out_ms;             // since when out has been waiting
+} Client;
+
+static Client g_clients[MAX_CLIENTS];
+static int g_nclients;       // slots in use or used, [0..g_nclients)
+static unsigned char *g_out; // JOBS reply being built
+static size_t g_outcap;
+static long g_served, g_results, g_duplicates;
+
+static void out_reserve(size_t n) {
+    if (n <= g_outcap) return;
+    unsigned char *o = realloc(g_out, n);
+    if (!o) { fprintf(stderr, "out of memory\n"); exit(1); }
+    g_out = o;
+    g_outcap = n;
+}
+
+// sends what c's buffer holds as far as the socket takes it, -1 when the connection failed
+static int client_flush(int c) {
+    Client *cl = &g_clients[c];
+    size_t sent = 0;
+    while (sent < cl->olen) {
+        ssize_t w = send(cl->fd, cl->out + sent, cl->olen - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (w <= 0) return -1;
+        sent += (size_t)w;
+    }
+    memmove(cl->out, cl->out + sent, cl->olen - sent);
+    cl->olen -= sent;
+    return 0;
+}
+
+// queues a reply to c and sends what the socket takes now; the rest goes out
+// on POLLOUT.  -1 when the connection failed or c let too much pile up
+static int client_send(int c, const void *buf, size_t n) {
+    Client *cl = &g_clients[c];
+    if (cl->olen + n > MAX_CLIENT_OUT) return -1;
+    if (cl->olen + n > cl->ocap) {
+        size_t cap = cl->olen + n > 2 * cl->ocap ? cl->olen + n : 2 * cl->ocap;
+        unsigned char *o = realloc(cl->out, cap);
+        if (!o) return -1;
+        cl->out = o;
+        cl->ocap = cap;
+    }
+    if (cl->olen == 0) cl->out_ms = gadb_now_ms();
+    memcpy(cl->out + cl->olen, buf, n);
+    cl->olen += n;
+    return client_flush(c);
+}
+
+// moves rows the database thread leased into the queue
+static void take_incoming(void) {
+    pthread_mutex_lock(&g_q.lock);
+    for (int i = 0; i < g_q.nin; ++i) {
+        Incoming *in = &g_q.in[i];
+        int s = job_alloc();
+        Job *j = &g_jobs[s];
+        free(j->genes);
+        j->genes = in->genes;
+        j->gen = in->gen;
+        j->idx = in->idx;
+        j->geneLength = in->geneLength;
+        job_enqueue(s);
+    }
+    g_q.nin = 0;
+    g_q.want = g_prefetch - g_pending;
+    pthread_mutex_unlock(&g_q.lock);
+}
+
+// sends up to max pending jobs to client c, returns how many; -1 when the write failed
+static int send_jobs(int c, int max) {
+    size_t len = sizeof(CoordHeader);
+    int n = 0, s;
+    out_reserve(len);
+    while (n < max && (s = job_dequeue()) >= 0) {
+        Job *j = &g_jobs[s];
+        int bytes = GENE_BYTES(j->geneLength);
+        out_reserve(len + sizeof(CoordJobWire) + (size_t)bytes);
+        CoordJobWire w = { (uint32_t)s, j->gen, j->idx, j->geneLength };
+        memcpy(g_out + len, &w, sizeof w);
+        memcpy(g_out + len + sizeof w, j->genes, (size_t)bytes);
+        len += sizeof w + (size_t)bytes;
+        j->state = JOB_CLAIMED;
+        j->client = c;
+        j->claimed_ms = gadb_now_ms();
+        g_claimed++;
+        n++;
+    }
+    CoordHeader h = { COORD_MAGIC, COORD_JOBS, (uint16_t)n, 0, (uint32_t)(len - sizeof h) };
+    memcpy(g_out, &h, sizeof h);
+    g_served += n;
+
+    if (g_pending < g_prefetch / 2) {
+        pthread_mutex_lock(&g_q.lock);
+        g_q.want = g_prefetch - g_pending;
+        db_kick_locked();
+        pthread_mutex_unlock(&g_q.lock);
+    }
+    return client_send(c, g_out, len) == 0 ? n : -1;
+}
+
+// back to the front of the queue, they are the oldest
+static void job_requeue(int s) {
+    Job *j = &g_jobs[s];
+    g_claimed--;
+    j->state = JOB_PENDING;
+    j->next = g_head;
+    g_head = s;
+    if (g_tail < 0) g_tail = s;
+    g_pending++;
+}
+
+static void client_close(int c) {
+    Client *cl = &g_clients[c];
+    close(cl->fd);
+    cl->fd = -1;
+    cl->got = 0;
+    cl->parked = 0;
+    cl->olen = 0;
+    for (int s = 0; s < g_njobs; ++s)
+        if (g_jobs[s].state == JOB_CLAIMED && g_jobs[s].client == c) job_requeue(s);
+}
+
+// Only the first result of a job goes to the database.  One whose lease ran
+// out may be reported by its first holder after it was requeued: pending, the
+// copy is cancelled; claimed again, the second result is dropped.
+static void handle_report(int c) {
+    Client *cl = &g_clients[c];
+    const CoordResultWire *r = (const CoordResultWire *)cl->buf;
+    int n = cl->h.count, taken = 0;
+
+    pthread_mutex_lock(&g_q.lock);
+    if (g_q.nres + n > g_q.rescap) {
+        int cap = 2 * (g_q.nres + n);
+        CoordResultWire *res = realloc(g_q.res, (size_t)cap * sizeof *res);
+        if (!res) { fprintf(stderr, "out of memory\n"); exit(1); }
+        g_q.res = res;
+        g_q.rescap = cap;
+    }
+    for (int i = 0; i < n; ++i) {
+        uint32_t s = r[i].token;
+        // the token names the slot; released, or reused for another row, it no longer matches
+        if (s >= (uint32_t)g_njobs || g_jobs[s].gen != r[i].gen || g_jobs[s].idx != r[i].idx ||
+            (g_jobs[s].state != JOB_CLAIMED && g_jobs[s].state != JOB_PENDING)) {
+            g_duplicates++;
+            continue;
+        }
+        if (g_jobs[s].state == JOB_CLAIMED) {
+            g_claimed--;
+            job_release((int)s);
+        } else {
+            g_jobs[s].state = JOB_CANCELLED;
+            g_pending--;
+        }
+        g_q.res[g_q.nres++] = r[i];
+        taken++;
+    }
+    // a full batch, or nothing left out: the trainer is waiting for these
+    if (g_q.nres >= g_prefetch || (g_pending == 0 && g_claimed == 0)) db_kick_locked();
+    pthread_mutex_unlock(&g_q.lock);
+    g_results += taken;
+
+    CoordHeader h = { COORD_MAGIC, COORD_ACK, (uint16_t)taken, (uint32_t)g_lease_ms, 0 };
+    if (client_send(c, &h, sizeof h) != 0) client_close(c);
+}
+
+static void handle_message(int c) {
+    Client *cl = &g_clients[c];
+    cl->seen_ms = gadb_now_ms();
+    if (cl->h.type == COORD_CLAIM) {
+        int max = cl->h.count;
+        if (max <= 0) max = 1;
+        if (g_pending == 0 && cl->h.arg > 0) {
+            cl->parked = max;
+            cl->deadline = gadb_now_ms() + cl->h.arg;
+            pthread_mutex_lock(&g_q.lock);
+            g_q.want = g_prefetch - g_pending;
+            db_kick_locked();
+            pthread_mutex_unlock(&g_q.lock);
+        } else if (send_jobs(c, max) < 0) {
+            client_close(c);
+        }
+    } else if (cl->h.type == COORD_REPORT) {
+        handle_report(c);
+    } else if (cl->h.type == COORD_EXTEND) {
+        CoordHeader h = { COORD_MAGIC, COORD_ACK, 0, (uint32_t)g_lease_ms, 0 };
+        if (client_send(c, &h, sizeof h) != 0) client_close(c);
+    } else {
+        client_close(c);
+    }
+}
+
+// reads what c sent, handling every complete message until a reply has to wait
+static void client_read(int c) {
+    Client *cl = &g_clients[c];
+    for (;;) {
+        size_t want, have = cl->got;
+        void *dst;
+        if (have < sizeof cl->h) {
+            dst = (char *)&cl->h + have;
+            want = sizeof cl->h - have;
+        } else {
+            size_t off = have - sizeof cl->h;
+            dst = cl->buf + off;
+            want = cl->h.bytes - off;
+        }
+        ssize_t r = want ? recv(cl->fd, dst, want, MSG_DONTWAIT) : 0;
+        if (want && r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+        if (want && r <= 0) { client_close(c); return; }
+        cl->got += (size_t)r;
+        if (cl->got == sizeof cl->h) {
+            size_t max = COORD_MAX_BATCH * sizeof(CoordResultWire);
+            if (cl->h.magic != COORD_MAGIC || cl->h.bytes > max || cl->h.count > COORD_MAX_BATCH ||
+                (cl->h.type == COORD_REPORT && cl->h.bytes != cl->h.count * sizeof(CoordResultWire))) {
+                client_close(c);
+                return;
+            }
+            if (cl->h.bytes > cl->cap) {
+                unsigned char *b = realloc(cl->buf, cl->h.bytes);
+                if (!b) { client_close(c); return; }
+                cl->buf = b;
+                cl->cap = cl->h.bytes;
+            }
+        }
+        if (cl->got >= sizeof cl->h && cl->got == sizeof cl->h + cl->h.bytes) {
+            cl->got = 0;
+            handle_message(c);
+            if (cl->fd < 0 || cl->parked || cl->olen) return;
+        }
+    }
+}
+
+static void client_accept(int lfd) {
+    int fd = accept(lfd, NULL, NULL);
+    if (fd < 0) return;
+    int c = 0;
+    while (c < g_nclients && g_clients[c].fd >= 0) c++;
+    if (c == MAX_CLIENTS) { close(fd); return; }
+    if (c == g_nclients) g_nclients++;
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    g_clients[c].fd = fd;
+    g_clients[c].got = 0;
+    g_clients[c].parked = 0;
+    g_clients[c].olen = 0;
+    g_clients[c].seen_ms = gadb_now_ms();
+}
+
+// parked claims get jobs, or an empty answer once their wait is over;
+// the first one served rotates so small generations spread over everyone
+static void serve_parked(long now) {
+    static int first;
+    if (g_nclients == 0) return;
+    first = (first + 1) % g_nclients;
+    for (int k = 0; k < g_nclients; ++k) {
+        int c = (first + k) % g_nclients;
+        Client *cl = &g_clients[c];
+        if (cl->fd < 0 || !cl->parked) continue;
+        if (g_pending == 0 && now < cl->deadline) continue;
+        int max = cl->parked;
+        cl->parked = 0;
+        if (send_jobs(c, max) < 0) client_close(c);
+        else if (!cl->olen) client_read(c); // may have sent more meanwhile
+    }
+}
+
+// jobs whose holder was not heard from for a lease go back, it stalled;
+// so does a client that has not read its reply for that long
+static void expire_leases(long now) {
+    for (int c = 0; c < g_nclients; ++c)
+        if (g_clients[c].fd >= 0 && g_clients[c].olen && now - g_clients[c].out_ms > g_lease_ms) client_close(c);
+    for (int s = 0; s < g_njobs; ++s) {
+        const Job *j = &g_jobs[s];
+        if (j->state != JOB_CLAIMED) continue;
+        long renewed = g_clients[j->client].seen_ms;
+        if (renewed < j->claimed_ms) renewed = j->claimed_ms;
+        if (now - renewed > g_lease_ms) job_requeue(s);
+    }
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+int main(int argc, char **argv) {
+    const char *db_path = "ga.db";
+    const char *sock_path = "ga.sock";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--db")==0 && i+1<argc) db_path = argv[++i];
+        else if (strcmp(argv[i], "--socket")==0 && i+1<argc) sock_path = argv[++i];
+        else if (strcmp(argv[i], "--prefetch")==0 && i+1<argc) g_prefetch = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--flush-ms")==0 && i+1<argc) g_flush_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--lease-ms")==0 && i+1<argc) g_lease_ms = atoi(argv[++i]);
+    }
+    if (g_prefetch < 1) g_prefetch = 1;
+    if (g_flush_ms < 1) g_flush_ms = 1;
+    if (g_lease_ms < 30) g_lease_ms = 30;
+
+    int rc = gadb_open(&g_db, db_path);
+    if (rc != SQLITE_OK) die_sqlite("sqlite3_open failed", rc);
+    // may start before the trainer, which then finds the tables made
+    gadb_init_schema(&g_db);
+    gadb_watch_open(&g_watch, db_path);
+    sqlite3_randomness(sizeof g_worker, &g_worker);
+    g_worker &= 0x7fffffffffffffffLL;
+
+    struct sockaddr_un a;
+    memset(&a, 0, sizeof a);
+    a.sun_family = AF_UNIX;
+    if (strlen(sock_path) >= sizeof a.sun_path) { fprintf(stderr, "socket path too long\n"); return 1; }
+    strcpy(a.sun_path, sock_path);
+    unlink(sock_path); // left over from a coordinator that was killed
+    int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lfd < 0 || bind(lfd, (struct sockaddr *)&a, sizeof a) != 0 || listen(lfd, 128) != 0) {
+        perror("coordinator socket");
+        return 1;
+    }
+    if (pipe(g_main_wake) != 0 || pipe(g_db_wake) != 0) { perror("pipe"); return 1; }
+    for (int i = 0; i < 2; i++) {
+        fcntl(g_main_wake[i], F_SETFL, O_NONBLOCK);
+        fcntl(g_db_wake[i], F_SETFL, O_NONBLOCK);
+    }
+    for (int c = 0; c < MAX_CLIENTS; c++) g_clients[c].fd = -1;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    g_q.want = g_prefetch;
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, db_thread, NULL) != 0) { fprintf(stderr, "could not start the database thread\n"); return 1; }
+    printf("[coordinator] serving %s on %s (prefetch=%d, flush=%d ms, lease=%d ms)\n",
+           db_path, sock_path, g_prefetch, g_flush_ms, g_lease_ms);
+    fflush(stdout);
+
+    static struct pollfd p[MAX_CLIENTS + 2];
+    static int owner[MAX_CLIENTS + 2];
+    long next_expire = gadb_now_ms() + 1000;
+    while (!g_stop) {
+        int np = 0;
+        p[np] = (struct pollfd){ lfd, POLLIN, 0 };
+        owner[np++] = -1;
+        p[np] = (struct pollfd){ g_main_wake[0], POLLIN, 0 };
+        owner[np++] = -2;
+        long now = gadb_now_ms();
+        long timeout = next_expire - now;
+        for (int c = 0; c < g_nclients; c++) {
+            if (g_clients[c].fd < 0) continue;
+            if (g_clients[c].parked) { // answered from serve_parked()
+                if (g_clients[c].deadline - now < timeout) timeout = g_clients[c].deadline - now;
+                continue;
+            }
+            // a reply still going out first, then the next message
+            p[np] = (struct pollfd){ g_clients[c].fd, g_clients[c].olen ? POLLOUT : POLLIN, 0 };
+            owner[np++] = c;
+        }
+        if (timeout < 0) timeout = 0;
+        if (poll(p, (nfds_t)np, (int)timeout) < 0 && errno != EINTR) { perror("poll"); break; }
+
+        for (int i = 0; i < np; i++) {
+            if (!p[i].revents) continue;
+            if (owner[i] == -1) client_accept(lfd);
+            else if (owner[i] == -2) { pipe_drain(g_main_wake[0]); take_incoming(); }
+            else if (g_clients[owner[i]].fd < 0) continue;
+            else if (!g_clients[owner[i]].olen) client_read(owner[i]);
+            else if (client_flush(owner[i]) != 0) client_close(owner[i]);
+            else if (!g_clients[owner[i]].olen) client_read(owner[i]);
+        }
+        now = gadb_now_ms();
+        serve_parked(now);
+        if (now >= next_expire) {
+            expire_leases(now);
+            next_expire = now + 1000;
+        }
+    }
+
+    printf("[coordinator] %ld jobs served, %ld results, %ld late duplicates dropped; stopping\n",
+           g_served, g_results, g_duplicates);
+    for (int c = 0; c < g_nclients; c++) {
+        if (g_clients[c].fd >= 0) close(g_clients[c].fd);
+        free(g_clients[c].out);
+        free(g_clients[c].buf);
+    }
+    close(lfd);
+    unlink(sock_path);
+    pthread_mutex_lock(&g_q.lock);
+    g_q.quit = 1;
+    db_kick_locked();
+    pthread_mutex_unlock(&g_q.lock);
+    pthread_join(tid, NULL);
+    gadb_watch_close(&g_watch);
+    gadb_close(&g_db);
+    return 0;
+}
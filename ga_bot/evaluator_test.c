@@ -2,168 +2,265 @@
 // Usage:
 //   ./evaluator --db ga.db
 //   ./evaluator --db ga.db --loop
+//   ./evaluator --db ga.db --loop --batch 32 --threads 4
+//   ./evaluator --db ga.db --loop --lease-ms 10000 --speculate-after 5
+//   ./evaluator --coord ga.sock --loop       (through DBCoordinator, see coordinator.c)
+// SIGINT/SIGTERM: the batch in hand is finished and reported, then it exits (see fleet.c)
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
+#include <signal.h>
 #include <sqlite3.h>
 
-#ifdef _WIN32
-#include <windows.h>
-static void sleep_ms(int ms){ Sleep(ms); }
-#else
-#include <time.h>
-static void sleep_ms(int ms){
-    struct timespec ts = { ms/1000, (ms%1000)*1000000L };
-    nanosleep(&ts, NULL);
-}
-#endif
+#include "chromosome.h"
+#include "evalPool.h"
+#include "gadb.h"
+#include "coord.h"
 
-typedef unsigned char bit_t;
-typedef struct {
-    bit_t *genes;
-    int fitness;
-} Chromosome;
+static GaDb g_db; // statements prepared once, see gadb.h
+static EvalPool g_eval; // evaluates a claimed batch, see evaluate_batch()
+static GaDbWatch g_watch = { .fd = -1 }; // wakes us when someone commits
+static sqlite3_int64 g_worker; // our id on the rows we hold
+static int g_lease_ms = 30000;
+static volatile sig_atomic_t g_stop;
 
-static sqlite3 *g_db = NULL;
+// no SA_RESTART: a wait for work returns, and the loop sees g_stop
+static void on_signal(int sig){
+    (void)sig;
+    g_stop = 1;
+}
 
 static void die_sqlite(const char *msg, int rc){
     fprintf(stderr, "[sqlite] %s (rc=%d)\n", msg, rc);
     exit(1);
 }
 
+// WAL, and a busy timeout: the trainer and other evaluators write too
 static void db_open(const char *path){
-    int rc = sqlite3_open(path, &g_db);
+    int rc = gadb_open(&g_db, path);
     if(rc != SQLITE_OK) die_sqlite("sqlite3_open failed", rc);
-    sqlite3_exec(g_db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
-    sqlite3_exec(g_db, "PRAGMA synchronous=NORMAL;", NULL, NULL, NULL);
+    gadb_watch_open(&g_watch, path);
+}
+
+// the tables, when we start before the trainer, or those of an older trainer brought up to date
+static void db_ensure_schema(void){
+    gadb_init_schema(&g_db);
 }
 
 static void db_close(void){
-    if(g_db) sqlite3_close(g_db);
-    g_db = NULL;
+    gadb_watch_close(&g_watch);
+    gadb_close(&g_db);
+}
+
+// Example fitness: count number of 1 bits
+static int fitness(const Chromosome *c, int geneLength){
+    return genePopcount(c, geneLength);
 }
 
-// Represents a claimed chromosome from DB
+// ---------- Heartbeat ----------
+// Renews the leases of our claims every third of a lease, on its own
+// connection so a long evaluation on the main thread cannot let them expire;
+// through the coordinator it sends EXTEND on ours, between our round trips.
 typedef struct {
-    int has_work;
-    int gen;
-    int idx;
-    Chromosome chrom;
-    int geneLength;
-} Claim;
-
-// Claim one pending chromosome atomically
-static Claim claim_one_pending(void){
-    Claim c = {0};
-    char *errmsg = NULL;
-    int rc = sqlite3_exec(g_db, "BEGIN IMMEDIATE;", NULL, NULL, &errmsg);
-    if(rc != SQLITE_OK) return c; // DB busy, skip this loop
-
-    sqlite3_stmt *sel = NULL;
-    rc = sqlite3_prepare_v2(g_db,
-        "SELECT gen, idx, chromosome FROM individuals "
-        "WHERE status='pending' ORDER BY gen ASC, idx ASC LIMIT 1;",
-        -1, &sel, NULL);
-    if(rc != SQLITE_OK){ sqlite3_exec(g_db,"ROLLBACK;",NULL,NULL,NULL); die_sqlite("prepare select", rc); }
-
-    rc = sqlite3_step(sel);
-    if(rc == SQLITE_ROW){
-        c.gen = sqlite3_column_int(sel, 0);
-        c.idx = sqlite3_column_int(sel, 1);
-        const void *blob = sqlite3_column_blob(sel, 2);
-        int blen = sqlite3_column_bytes(sel, 2);
-        c.geneLength = blen; // since bit_t = 1 byte
-        c.chrom.genes = malloc((size_t)blen);
-        memcpy(c.chrom.genes, blob, (size_t)blen);
-        c.has_work = 1;
-    } else {
-        sqlite3_finalize(sel);
-        sqlite3_exec(g_db,"ROLLBACK;",NULL,NULL,NULL);
-        return c;
+    GaDb db;
+    int coord;               // the coordinator's socket, -1: the database
+    pthread_mutex_t io;      // one round trip at a time on coord
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int quit;
+} Heartbeat;
+
+static Heartbeat g_beat = { .coord = -1, .io = PTHREAD_MUTEX_INITIALIZER,
+                             .lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER };
+
+static void *heartbeat_run(void *arg){
+    Heartbeat *h = arg;
+    pthread_mutex_lock(&h->lock);
+    while(!h->quit){
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        long ns = until.tv_nsec + (long)(g_lease_ms / 3 % 1000) * 1000000L;
+        until.tv_sec += g_lease_ms / 3 / 1000 + ns / 1000000000L;
+        until.tv_nsec = ns % 1000000000L;
+        pthread_cond_timedwait(&h->wake, &h->lock, &until);
+        if(h->quit) break;
+        pthread_mutex_unlock(&h->lock);
+        int rc;
+        if(h->coord >= 0){
+            int lease = 0;
+            pthread_mutex_lock(&h->io);
+            rc = coord_extend(h->coord, &lease);
+            pthread_mutex_unlock(&h->io);
+            if(rc == 0 && lease >= 30) g_lease_ms = lease; // the coordinator's, not --lease-ms
+        } else {
+            rc = gadb_heartbeat(&h->db, g_worker, g_lease_ms);
+        }
+        if(rc != 0) fprintf(stderr, "[evaluator] heartbeat failed (rc=%d), retrying\n", rc);
+        pthread_mutex_lock(&h->lock);
     }
-    sqlite3_finalize(sel);
-
-    sqlite3_stmt *upd = NULL;
-    rc = sqlite3_prepare_v2(g_db,
-        "UPDATE individuals SET status='claimed', claimed_ts=strftime('%s','now') "
-        "WHERE gen=? AND idx=?;",
-        -1, &upd, NULL);
-    if(rc != SQLITE_OK){ sqlite3_exec(g_db,"ROLLBACK;",NULL,NULL,NULL); die_sqlite("prepare update", rc); }
-    sqlite3_bind_int(upd, 1, c.gen);
-    sqlite3_bind_int(upd, 2, c.idx);
-    rc = sqlite3_step(upd);
-    sqlite3_finalize(upd);
-    if(rc != SQLITE_DONE){ sqlite3_exec(g_db,"ROLLBACK;",NULL,NULL,NULL); die_sqlite("update step", rc); }
-
-    rc = sqlite3_exec(g_db, "COMMIT;", NULL, NULL, &errmsg);
-    if(rc != SQLITE_OK) die_sqlite("COMMIT", rc);
-    return c;
+    pthread_mutex_unlock(&h->lock);
+    return NULL;
 }
 
-static void free_claim(Claim *c){
-    if(c && c->chrom.genes){ free(c->chrom.genes); c->chrom.genes=NULL; }
+// path: our database, NULL when coord is the coordinator's socket
+static void heartbeat_start(const char *path, int coord){
+    g_beat.coord = coord;
+    if(path){
+        int rc = gadb_open(&g_beat.db, path);
+        if(rc != SQLITE_OK) die_sqlite("heartbeat sqlite3_open failed", rc);
+    }
+    if(pthread_create(&g_beat.tid, NULL, heartbeat_run, &g_beat) != 0){
+        fprintf(stderr, "could not start the heartbeat thread\n");
+        exit(1);
+    }
 }
 
-// Example fitness: count number of 1 bits
-static int fitness(const Chromosome *c, int geneLength){
-    int sum = 0;
-    for(int i=0;i<geneLength;i++)
-        sum += (c->genes[i] ? 1 : 0);
-    return sum;
+static void heartbeat_stop(void){
+    pthread_mutex_lock(&g_beat.lock);
+    g_beat.quit = 1;
+    pthread_cond_signal(&g_beat.wake);
+    pthread_mutex_unlock(&g_beat.lock);
+    pthread_join(g_beat.tid, NULL);
+    if(g_beat.coord < 0) gadb_close(&g_beat.db);
 }
 
-static void report_done(int gen, int idx, int fitness){
-    sqlite3_stmt *st = NULL;
-    int rc = sqlite3_prepare_v2(g_db,
-        "UPDATE individuals SET status='done', fitness=?, done_ts=strftime('%s','now') "
-        "WHERE gen=? AND idx=? AND status='claimed';",
-        -1, &st, NULL);
-    if(rc != SQLITE_OK) die_sqlite("prepare report_done", rc);
-    sqlite3_bind_double(st, 1, (double)fitness);
-    sqlite3_bind_int(st, 2, gen);
-    sqlite3_bind_int(st, 3, idx);
-    rc = sqlite3_step(st);
-    sqlite3_finalize(st);
-    if(rc != SQLITE_DONE) die_sqlite("report_done step", rc);
+// Sleeps until a commit leaves pending rows behind, poll_ms at most: commits
+// that bring no work (results, heartbeats) only cost a few reads
+static void wait_for_work(int poll_ms){
+    long deadline = gadb_now_ms() + poll_ms;
+    for(;;){
+        long left = deadline - gadb_now_ms();
+        if(left <= 0 || !gadb_wait_commit(&g_db, &g_watch, (int)left)) return;
+        if(gadb_any_pending(&g_db)) return;
+    }
+}
+
+// Fitness of jobs[0..n) on the local threads, one run per stretch of equal gene length
+static void evaluate_batch(GaJob *jobs, Chromosome **pop, int n){
+    for(int i=0;i<n;i++) pop[i] = &jobs[i].chrom;
+    for(int i=0;i<n;){
+        int j = i + 1;
+        while(j < n && jobs[j].geneLength == jobs[i].geneLength) j++;
+        if(evalPoolRun(&g_eval, pop + i, j - i, jobs[i].geneLength, fitness) != 0){
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        i = j;
+    }
 }
 
 int main(int argc, char **argv){
     const char *db_path = "ga.db";
+    const char *coord_path = NULL; // claim and report through the coordinator instead
     int keep_looping = 0;
     int poll_ms = 250;
+    int batch = 16;  // rows per claim, their results go back in one transaction
+    int threads = 1; // evaluating a batch, 0 = every core
+    int speculate_after = 2; // s before an idle evaluator duplicates another's claim, < 0 never
 
     for(int i=1;i<argc;i++){
         if(strcmp(argv[i],"--db")==0 && i+1<argc) db_path = argv[++i];
+        else if(strcmp(argv[i],"--coord")==0 && i+1<argc) coord_path = argv[++i];
         else if(strcmp(argv[i],"--loop")==0) keep_looping = 1;
         else if(strcmp(argv[i],"--poll-ms")==0 && i+1<argc) poll_ms = atoi(argv[++i]);
+        else if(strcmp(argv[i],"--batch")==0 && i+1<argc) batch = atoi(argv[++i]);
+        else if(strcmp(argv[i],"--threads")==0 && i+1<argc) threads = atoi(argv[++i]);
+        else if(strcmp(argv[i],"--lease-ms")==0 && i+1<argc) g_lease_ms = atoi(argv[++i]);
+        else if(strcmp(argv[i],"--speculate-after")==0 && i+1<argc) speculate_after = atoi(argv[++i]);
     }
 
-    db_open(db_path);
-    printf("[evaluator] connected to %s (loop=%d)\n", db_path, keep_looping);
+    if(batch < 1) batch = 1;
+    if(g_lease_ms < 30) g_lease_ms = 30;
+    int coord = -1;
+    if(coord_path){
+        coord = coord_connect(coord_path);
+        int lease = 0;
+        if(coord < 0 || coord_extend(coord, &lease) != 0){ fprintf(stderr, "[evaluator] cannot reach the coordinator at %s\n", coord_path); return 1; }
+        if(lease >= 30) g_lease_ms = lease; // its heartbeats follow the coordinator's lease
+        heartbeat_start(NULL, coord);
+    } else {
+        db_open(db_path);
+        db_ensure_schema();
+        sqlite3_randomness(sizeof g_worker, &g_worker);
+        g_worker &= 0x7fffffffffffffffLL;
+        heartbeat_start(db_path, -1);
+    }
+    if(threads != 1 && evalPoolStart(&g_eval, threads) != 0){
+        fprintf(stderr, "could not start %d evaluation threads\n", threads);
+        return 1;
+    }
+    printf("[evaluator] connected to %s (loop=%d, batch=%d, threads=%d)\n",
+           coord_path ? coord_path : db_path, keep_looping, batch, g_eval.threads > 0 ? g_eval.threads : 1);
 
-    for(;;){
-        Claim c = claim_one_pending();
-        if(!c.has_work){
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    GaJob *jobs = calloc((size_t)batch, sizeof *jobs);
+    Chromosome **pop = calloc((size_t)batch, sizeof *pop);
+    if(!jobs || !pop){ fprintf(stderr, "out of memory\n"); return 1; }
+    long last_flush = gadb_now_ms();
+    while(!g_stop){
+        int n;
+        if(coord >= 0){
+            // the coordinator answers when work comes in, or after poll_ms with none
+            pthread_mutex_lock(&g_beat.io);
+            n = coord_claim(coord, jobs, batch, keep_looping ? poll_ms : 0);
+            pthread_mutex_unlock(&g_beat.io);
+            if(n < 0){ fprintf(stderr, "[evaluator] lost the coordinator\n"); break; }
+        } else {
+            // Claim up to batch rows with one statement
+            n = gadb_claim(&g_db, jobs, batch, g_worker, g_lease_ms);
+            // nothing pending: the generation is ending, help with its stragglers
+            if(n == 0 && speculate_after >= 0) n = gadb_speculate(&g_db, jobs, batch, g_worker, speculate_after);
+        }
+        if(n == 0){
+            fflush(stdout); // idle: the result lines so far go out, to DBFleet say
             if(!keep_looping) break;
-            sleep_ms(poll_ms);
+            if(coord < 0) wait_for_work(poll_ms);
             continue;
         }
 
-        // Compute fitness
-        c.chrom.fitness = fitness(&c.chrom, c.geneLength);
-
-        // Report back to DB
-        report_done(c.gen, c.idx, c.chrom.fitness);
+        // Compute fitness, locally and without holding any lock
+        evaluate_batch(jobs, pop, n);
 
-        printf("[evaluator] gen=%d idx=%d len=%d fitness=%d\n",
-               c.gen, c.idx, c.geneLength, c.chrom.fitness);
+        // Report back, the whole batch at once
+        if(coord < 0) gadb_report(&g_db, jobs, n);
+        else {
+            pthread_mutex_lock(&g_beat.io);
+            int rc = coord_report(coord, jobs, n);
+            pthread_mutex_unlock(&g_beat.io);
+            if(rc != 0){ fprintf(stderr, "[evaluator] lost the coordinator\n"); break; }
+        }
 
-        free_claim(&c);
+        for(int i=0;i<n;i++)
+            printf("[evaluator] gen=%d idx=%d len=%d fitness=%d\n",
+                   jobs[i].gen, jobs[i].idx, jobs[i].geneLength, jobs[i].chrom.fitness);
+        // a flush per batch costs more than small generations take to evaluate
+        long now = gadb_now_ms();
+        if(now - last_flush >= 100){
+            fflush(stdout);
+            last_flush = now;
+        }
     }
+    if(g_eval.threads > 0) evalPoolStop(&g_eval);
+    ga_jobs_free(jobs, batch);
+    free(jobs);
+    free(pop);
 
-    db_close();
+    heartbeat_stop();
+    if(coord >= 0){
+        close(coord);
+    } else {
+        gadb_release(&g_db, g_worker); // nothing, unless stopped between a claim and its report
+        db_close();
+    }
     printf("[evaluator] done.\n");
     return 0;
 }
@@ -0,0 +1,530 @@
+// Build: ./build_fleet.sh
+// Usage:
+//   ./DBFleet --spec fleet.spec
+//   ./DBFleet --workers 0 -- ./DBEvaluatorTest --coord ga.sock --loop
+//   ./DBFleet --trainer "./DBGATrainer --db ga.db --external" --workers 4 -- ./DBEvaluatorTest --db ga.db --loop
+//
+// Supervisor of a training box: starts the workers, one per CPU unless told
+// otherwise, each pinned to its own CPU, restarts those that die (waiting
+// longer each time one dies within GA_FLEET_QUICK_MS of its start), and
+// every --report-s prints how many evaluations per second the fleet makes,
+// counting the result lines ("... gen=G idx=I ... fitness=F") of every
+// process' output, which it passes on prefixed with the process' name.
+// --status FILE keeps the same numbers, per worker too, in FILE.
+//
+// When the trainer exits, or on SIGINT/SIGTERM, the fleet drains: the
+// workers get SIGTERM (evaluators finish and report their batch, GASmarty's
+// job goes back to the coordinator's queue) and --drain-s to exit, then the
+// services the same way, and the fleet exits with the trainer's status.
+//
+// Spec file, one entry per line, # starts a comment, words are separated
+// by blanks and may be quoted with ' or ":
+//   env NAME=VALUE       set for every process started after it
+//   service COMMAND...   started first and stopped last, e.g. DBCoordinator
+//   trainer COMMAND...   at most one; its exit drains the fleet
+//   N COMMAND...         N workers, 0 for one per CPU
+// e.g.
+//   env LD_LIBRARY_PATH=/lib/xpilot-ai/binaries/
+//   service ./DBCoordinator --db ga.db --socket ga.sock
+//   trainer ./DBGATrainer --db ga.db --external
+//   0 ./DBEvaluatorTest --coord ga.sock --loop
+//   2 ./GASmarty -coord ga.sock -join
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_PROCS 1024
+#define MAX_CPUS 1024
+#define GA_FLEET_QUICK_MS 5000   // a process that dies sooner is failing, not done
+#define GA_FLEET_BACKOFF_MS 500  // first wait before restarting a failing one, doubled up to 10 s
+
+typedef enum { ROLE_SERVICE, ROLE_TRAINER, ROLE_WORKER } Role;
+
+typedef struct {
+    Role role;
+    char name[64];           // "DBEvaluatorTest#3"
+    char **argv;             // shared with the other workers of its line
+    int cpu;                 // pinned to, -1: not pinned
+    pid_t pid;               // 0: not running
+    int out;                 // its stdout and stderr, -1: closed
+    char line[4096];         // output not yet ended by a newline
+    size_t len;
+    long started_ms;
+    long restart_ms;         // when to start it again, 0: not due
+    int fails;               // quick deaths in a row
+    int status;              // of the last exit
+    long evaluations;
+    long restarts;
+} Proc;
+
+static Proc g_procs[MAX_PROCS];
+static int g_nprocs;
+static int g_cpus[MAX_CPUS], g_ncpus;
+static int g_pin = 1, g_quiet, g_report_s = 5, g_drain_s = 10;
+static const char *g_status_path;
+static int g_sig_pipe[2];        // SIGCHLD, SIGINT and SIGTERM wake the loop through it
+static volatile sig_atomic_t g_stop;
+
+static long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void on_signal(int sig) {
+    int e = errno;
+    if (sig != SIGCHLD) g_stop = 1;
+    char c = 0;
+    ssize_t w = write(g_sig_pipe[1], &c, 1); // full pipe: a wake is pending anyway
+    (void)w;
+    errno = e;
+}
+
+// ---------- Spec ----------
+// Splits s into words, blanks apart, ' and " quoting; a NULL-terminated array, NULL when empty
+static char **split_words(const char *s) {
+    size_t cap = 8, n = 0;
+    char **argv = malloc(cap * sizeof *argv);
+    char *buf = malloc(strlen(s) + 1), *o = buf;
+    if (!argv || !buf) { fprintf(stderr, "out of memory\n"); exit(1); }
+    for (;;) {
+        while (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n') s++;
+        if (!*s || *s == '#') break;
+        char *word = o;
+        while (*s && *s != ' ' && *s != '\t' && *s != '\r' && *s != '\n') {
+            if (*s == '\'' || *s == '"') {
+                char q = *s++;
+                while (*s && *s != q) *o++ = *s++;
+                if (*s) s++;
+            } else {
+                *o++ = *s++;
+            }
+        }
+        *o++ = 0;
+        if (n + 2 > cap) {
+            cap *= 2;
+            char **a = realloc(argv, cap * sizeof *argv);
+            if (!a) { fprintf(stderr, "out of memory\n"); exit(1); }
+            argv = a;
+        }
+        argv[n++] = word;
+    }
+    argv[n] = NULL;
+    if (n == 0) {
+        free(argv);
+        free(buf);
+        return NULL;
+    }
+    return argv; // buf lives as long as the words, i.e. the fleet
+}
+
+static void add_procs(Role role, int count, char **argv) {
+    const char *base = strrchr(argv[0], '/');
+    base = base ? base + 1 : argv[0];
+    int workers = 0;
+    for (int i = 0; i < g_nprocs; ++i) workers += g_procs[i].role == ROLE_WORKER;
+    for (int k = 0; k < count; ++k) {
+        if (g_nprocs == MAX_PROCS) { fprintf(stderr, "[fleet] more than %d processes\n", MAX_PROCS); exit(1); }
+        Proc *p = &g_procs[g_nprocs++];
+        memset(p, 0, sizeof *p);
+        p->role = role;
+        p->argv = argv;
+        p->out = -1;
+        p->cpu = role == ROLE_WORKER && g_pin && g_ncpus > 0 ? g_cpus[(workers + k) % g_ncpus] : -1;
+        if (role == ROLE_WORKER) snprintf(p->name, sizeof p->name, "%s#%d", base, k);
+        else snprintf(p->name, sizeof p->name, "%s", base);
+    }
+}
+
+// Reads the spec at path; env lines take effect at once, 0 if it was good
+static int read_spec(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) { perror(path); return -1; }
+    char text[4096];
+    int lineno = 0, trainers = 0;
+    while (fgets(text, sizeof text, f)) {
+        lineno++;
+        char **w = split_words(text);
+        if (!w) continue;
+        if (strcmp(w[0], "env") == 0 && w[1] && strchr(w[1], '=')) {
+            putenv(w[1]);
+        } else if (strcmp(w[0], "service") == 0 && w[1]) {
+            add_procs(ROLE_SERVICE, 1, w + 1);
+        } else if (strcmp(w[0], "trainer") == 0 && w[1] && trainers++ == 0) {
+            add_procs(ROLE_TRAINER, 1, w + 1);
+        } else if (w[0][0] >= '0' && w[0][0] <= '9' && w[1]) {
+            int n = atoi(w[0]);
+            add_procs(ROLE_WORKER, n > 0 ? n : g_ncpus, w + 1);
+        } else {
+            fprintf(stderr, "%s:%d: not an env, service, trainer or worker line\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+// the CPUs we may run on, every worker gets one of them
+static void find_cpus(void) {
+    g_ncpus = 0;
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof set, &set) == 0)
+        for (int c = 0; c < CPU_SETSIZE && g_ncpus < MAX_CPUS; ++c)
+            if (CPU_ISSET(c, &set)) g_cpus[g_ncpus++] = c;
+#endif
+    if (g_ncpus == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int c = 0; c < n && c < MAX_CPUS; ++c) g_cpus[g_ncpus++] = c;
+        g_pin = 0; // no affinity to set
+    }
+    if (g_ncpus == 0) g_cpus[g_ncpus++] = 0;
+}
+
+// ---------- Processes ----------
+static void proc_start(Proc *p) {
+    int fds[2];
+    if (pipe(fds) != 0) { perror("[fleet] pipe"); p->restart_ms = now_ms() + 1000; return; }
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("[fleet] fork");
+        close(fds[0]);
+        close(fds[1]);
+        p->restart_ms = now_ms() + 1000;
+        return;
+    }
+    if (pid == 0) {
+        // its own process group: a Ctrl-C reaches the fleet only, which drains in order
+        setpgid(0, 0);
+        signal(SIGPIPE, SIG_DFL);
+        dup2(fds[1], STDOUT_FILENO);
+        dup2(fds[1], STDERR_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+#ifdef __linux__
+        if (p->cpu >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(p->cpu, &set);
+            sched_setaffinity(0, sizeof set, &set);
+        }
+#endif
+        execvp(p->argv[0], p->argv);
+        fprintf(stderr, "cannot run %s: %s\n", p->argv[0], strerror(errno));
+        _exit(127);
+    }
+    close(fds[1]);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    if (p->out >= 0) close(p->out); // a leftover of the previous run
+    p->out = fds[0];
+    p->len = 0;
+    p->pid = pid;
+    p->started_ms = now_ms();
+    p->restart_ms = 0;
+    if (p->cpu >= 0) printf("[fleet] %s started, pid %d on CPU %d\n", p->name, (int)pid, p->cpu);
+    else printf("[fleet] %s started, pid %d\n", p->name, (int)pid);
+}
+
+// a result line of an evaluator or GASmarty: "[...] gen=G idx=I ... fitness=F"
+static int is_result(const char *s) {
+    return strstr(s, " gen=") && strstr(s, " idx=") && strstr(s, " fitness=");
+}
+
+static void proc_line(Proc *p, char *s) {
+    int result = is_result(s);
+    if (result) p->evaluations++;
+    if (!(result && g_quiet)) printf("[%s] %s\n", p->name, s);
+}
+
+// passes on what p wrote, line by line; closes p->out at its end
+static void proc_read(Proc *p) {
+    for (;;) {
+        if (p->len == sizeof p->line - 1) { // a line that long goes out in pieces
+            p->line[p->len] = 0;
+            proc_line(p, p->line);
+            p->len = 0;
+        }
+        ssize_t r = read(p->out, p->line + p->len, sizeof p->line - 1 - p->len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (r <= 0) {
+            if (p->len > 0) {
+                p->line[p->len] = 0;
+                proc_line(p, p->line);
+            }
+            close(p->out);
+            p->out = -1;
+            p->len = 0;
+            return;
+        }
+        size_t end = p->len + (size_t)r, start = 0;
+        for (size_t i = p->len; i < end; ++i) {
+            if (p->line[i] != '\n') continue;
+            p->line[i] = 0;
+            proc_line(p, p->line + start);
+            start = i + 1;
+        }
+        memmove(p->line, p->line + start, end - start);
+        p->len = end - start;
+    }
+}
+
+// collects the processes that exited and, unless draining, schedules their restart
+static void reap(int draining) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        Proc *p = NULL;
+        for (int i = 0; i < g_nprocs; ++i) if (g_procs[i].pid == pid) p = &g_procs[i];
+        if (!p) continue;
+        if (p->out >= 0) proc_read(p); // its last words
+        p->pid = 0;
+        p->status = status;
+        long now = now_ms(), up = now - p->started_ms;
+        char how[64];
+        if (WIFSIGNALED(status)) snprintf(how, sizeof how, "was killed by signal %d", WTERMSIG(status));
+        else snprintf(how, sizeof how, "exited %d", WEXITSTATUS(status));
+        if (p->role == ROLE_TRAINER || draining) {
+            printf("[fleet] %s %s after %.1f s\n", p->name, how, up / 1000.0);
+            continue;
+        }
+        p->fails = up < GA_FLEET_QUICK_MS ? p->fails + 1 : 0;
+        long wait = 0;
+        if (p->fails > 0) {
+            wait = GA_FLEET_BACKOFF_MS;
+            for (int k = 1; k < p->fails && wait < 10000; ++k) wait *= 2;
+            if (wait > 10000) wait = 10000;
+        }
+        p->restart_ms = now + wait;
+        p->restarts++;
+        printf("[fleet] %s %s after %.1f s, restarting in %.1f s\n", p->name, how, up / 1000.0, wait / 1000.0);
+    }
+}
+
+// sig to the running processes of role, none of which is restarted any more; 1 when there were any
+static int signal_role(Role role, int sig) {
+    int any = 0;
+    for (int i = 0; i < g_nprocs; ++i) {
+        Proc *p = &g_procs[i];
+        if (p->role != role) continue;
+        p->restart_ms = 0;
+        if (p->pid > 0) {
+            kill(p->pid, sig);
+            any = 1;
+        }
+    }
+    return any;
+}
+
+static int running(Role role) {
+    for (int i = 0; i < g_nprocs; ++i)
+        if (g_procs[i].role == role && g_procs[i].pid > 0) return 1;
+    return 0;
+}
+
+// ---------- Throughput ----------
+typedef struct {
+    long start_ms, last_ms;
+    long last_evaluations;
+} Meter;
+
+static long total_evaluations(void) {
+    long n = 0;
+    for (int i = 0; i < g_nprocs; ++i) n += g_procs[i].evaluations;
+    return n;
+}
+
+// prints, and writes to --status, the evaluations per second since the last report
+static void report(Meter *m, long now) {
+    long total = total_evaluations(), restarts = 0;
+    int up = 0, workers = 0;
+    for (int i = 0; i < g_nprocs; ++i) {
+        if (g_procs[i].role != ROLE_WORKER) continue;
+        workers++;
+        up += g_procs[i].pid > 0;
+        restarts += g_procs[i].restarts;
+    }
+    double secs = (now - m->last_ms) / 1000.0;
+    double rate = secs > 0 ? (total - m->last_evaluations) / secs : 0;
+    printf("[fleet] %d/%d workers up, %ld restarts, %.1f evaluations/s (%ld in %.0f s)\n",
+           up, workers, restarts, rate, total, (now - m->start_ms) / 1000.0);
+    fflush(stdout);
+    m->last_ms = now;
+    m->last_evaluations = total;
+
+    if (!g_status_path) return;
+    char tmp[4096];
+    if (snprintf(tmp, sizeof tmp, "%s.tmp", g_status_path) >= (int)sizeof tmp) return;
+    FILE *f = fopen(tmp, "w");
+    if (!f) return;
+    fprintf(f, "workers %d\nup %d\nrestarts %ld\nevaluations %ld\nper_second %.1f\nseconds %.0f\n",
+            workers, up, restarts, total, rate, (now - m->start_ms) / 1000.0);
+    for (int i = 0; i < g_nprocs; ++i) {
+        const Proc *p = &g_procs[i];
+        fprintf(f, "proc %s pid %d cpu %d evaluations %ld restarts %ld\n",
+                p->name, (int)p->pid, p->cpu, p->evaluations, p->restarts);
+    }
+    if (fclose(f) == 0) rename(tmp, g_status_path);
+    else remove(tmp);
+}
+
+// ---------- Main ----------
+typedef enum { RUN, DRAIN_WORKERS, DRAIN_SERVICES, DONE } Stage;
+
+int main(int argc, char **argv) {
+    const char *spec = NULL;
+    const char *trainer = NULL;
+    int workers = 0;
+    char **command = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--spec")==0 && i+1<argc) spec = argv[++i];
+        else if (strcmp(argv[i], "--trainer")==0 && i+1<argc) trainer = argv[++i];
+        else if (strcmp(argv[i], "--workers")==0 && i+1<argc) workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--no-pin")==0) g_pin = 0;
+        else if (strcmp(argv[i], "--quiet")==0) g_quiet = 1;
+        else if (strcmp(argv[i], "--report-s")==0 && i+1<argc) g_report_s = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--drain-s")==0 && i+1<argc) g_drain_s = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--status")==0 && i+1<argc) g_status_path = argv[++i];
+        else if (strcmp(argv[i], "--")==0 && i+1<argc) { command = argv + i + 1; break; }
+    }
+    if (g_report_s < 1) g_report_s = 1;
+    if (g_drain_s < 0) g_drain_s = 0;
+    find_cpus();
+    if (spec && read_spec(spec) != 0) return 1;
+    if (trainer) {
+        char **w = split_words(trainer);
+        if (w) add_procs(ROLE_TRAINER, 1, w);
+    }
+    if (command) add_procs(ROLE_WORKER, workers > 0 ? workers : g_ncpus, command);
+    if (g_nprocs == 0) {
+        fprintf(stderr, "usage: %s --spec FILE | [--trainer COMMAND] [--workers N] -- COMMAND...\n", argv[0]);
+        return 1;
+    }
+
+    if (pipe(g_sig_pipe) != 0) { perror("pipe"); return 1; }
+    for (int i = 0; i < 2; i++) {
+        fcntl(g_sig_pipe[i], F_SETFL, O_NONBLOCK);
+        fcntl(g_sig_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGCHLD, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    // services first so the others find them, e.g. the coordinator's socket
+    for (int r = ROLE_SERVICE; r <= ROLE_WORKER; ++r)
+        for (int i = 0; i < g_nprocs; ++i)
+            if (g_procs[i].role == (Role)r) proc_start(&g_procs[i]);
+    printf("[fleet] %d processes, %d CPUs%s\n", g_nprocs, g_ncpus, g_pin ? ", workers pinned" : "");
+
+    Meter meter = { now_ms(), now_ms(), 0 };
+    long next_report = meter.start_ms + g_report_s * 1000L;
+    long deadline = 0;
+    Stage stage = RUN;
+    static struct pollfd pfd[MAX_PROCS + 1];
+    static int owner[MAX_PROCS + 1];
+    while (stage != DONE) {
+        long now = now_ms();
+        long timeout = next_report - now;
+        int np = 0;
+        pfd[np] = (struct pollfd){ g_sig_pipe[0], POLLIN, 0 };
+        owner[np++] = -1;
+        for (int i = 0; i < g_nprocs; ++i) {
+            Proc *p = &g_procs[i];
+            if (p->out >= 0) {
+                pfd[np] = (struct pollfd){ p->out, POLLIN, 0 };
+                owner[np++] = i;
+            }
+            if (p->restart_ms && p->restart_ms - now < timeout) timeout = p->restart_ms - now;
+        }
+        if (deadline && deadline - now < timeout) timeout = deadline - now;
+        if (timeout < 0) timeout = 0;
+        if (poll(pfd, (nfds_t)np, (int)timeout) < 0 && errno != EINTR) { perror("poll"); break; }
+
+        for (int k = 0; k < np; ++k) {
+            if (!pfd[k].revents) continue;
+            if (owner[k] < 0) {
+                char buf[64];
+                while (read(g_sig_pipe[0], buf, sizeof buf) > 0) {}
+            } else if (g_procs[owner[k]].out >= 0) {
+                proc_read(&g_procs[owner[k]]);
+            }
+        }
+        reap(stage != RUN);
+        now = now_ms();
+
+        if (stage == RUN) {
+            int trainer_done = 0;
+            for (int i = 0; i < g_nprocs; ++i) {
+                Proc *p = &g_procs[i];
+                if (p->role == ROLE_TRAINER && p->pid == 0) trainer_done = 1;
+            }
+            if (trainer_done || g_stop) {
+                printf("[fleet] %s, draining\n", g_stop ? "stopping" : "the trainer is done");
+                signal_role(ROLE_TRAINER, SIGTERM);
+                signal_role(ROLE_WORKER, SIGTERM);
+                stage = DRAIN_WORKERS;
+                deadline = now + g_drain_s * 1000L;
+            } else {
+                for (int i = 0; i < g_nprocs; ++i)
+                    if (g_procs[i].restart_ms && g_procs[i].restart_ms <= now) proc_start(&g_procs[i]);
+            }
+        }
+        if (stage == DRAIN_WORKERS) {
+            if (!running(ROLE_WORKER) && !running(ROLE_TRAINER)) {
+                signal_role(ROLE_SERVICE, SIGTERM);
+                stage = DRAIN_SERVICES;
+                deadline = now + g_drain_s * 1000L;
+            } else if (now >= deadline) {
+                printf("[fleet] workers still up after %d s, killing them\n", g_drain_s);
+                signal_role(ROLE_WORKER, SIGKILL);
+                signal_role(ROLE_TRAINER, SIGKILL);
+                deadline = now + 1000;
+            }
+        }
+        if (stage == DRAIN_SERVICES) {
+            if (!running(ROLE_SERVICE)) {
+                stage = DONE;
+            } else if (now >= deadline) {
+                printf("[fleet] services still up after %d s, killing them\n", g_drain_s);
+                signal_role(ROLE_SERVICE, SIGKILL);
+                deadline = now + 1000;
+            }
+        }
+        if (now >= next_report) {
+            report(&meter, now);
+            next_report = now + g_report_s * 1000L;
+        }
+    }
+
+    // what the last ones wrote before exiting
+    for (int i = 0; i < g_nprocs; ++i) if (g_procs[i].out >= 0) proc_read(&g_procs[i]);
+    // and the rate over the whole run
+    meter.last_ms = meter.start_ms;
+    meter.last_evaluations = 0;
+    report(&meter, now_ms());
+    // the trainer's, as a shell would have it
+    for (int i = 0; i < g_nprocs; ++i) {
+        const Proc *p = &g_procs[i];
+        if (p->role == ROLE_TRAINER)
+            return WIFEXITED(p->status) ? WEXITSTATUS(p->status) : 128 + WTERMSIG(p->status);
+    }
+    return 0;
+}
@@ -4,6 +4,8 @@
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
+#include <limits.h>
+#include <math.h>
 
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -12,6 +14,22 @@
     #include <getopt.h>
 #endif
 #include <sqlite3.h>
+#include "chromosome.h"
+#include "geneMutate.h"
+#include "population.h"
+#include "selection.h"
+#include "evalPool.h"
+#include "migration.h"
+#include "checkpoint.h"
+#include "gadb.h"
+#include "gaRules.h"
+#include "simBatch.h"
+
+// rngStream() keys, the experiment seed picks the run
+#define RNG_STREAM_INIT 1      /* (0, individual) */
+#define RNG_STREAM_REPRODUCE 2 /* (generation, child) */
+#define RNG_STREAM_ISLAND 3    /* (island, 0), the seed of an island's own streams */
+#define RNG_STREAM_STEADY 4    /* (birth, 0), one steady-state child */
 
 #if defined(_WIN32) || defined(_WIN64)
 // Windows-compatible getline implementation
@@ -41,23 +59,6 @@ size_t getline(char **lineptr, size_t *n, FILE *stream) {
 #endif
 
 
-// --- add near your SQLite helpers ---
-static void sleep_ms(int ms) {
-#ifdef _WIN32
-    Sleep(ms);
-#else
-    struct timespec ts; ts.tv_sec = ms / 1000; ts.tv_nsec = (ms % 1000) * 1000000L;
-    nanosleep(&ts, NULL);
-#endif
-}
-
-typedef unsigned char bit_t; /* 0 or 1 */
-
-typedef struct {
-    bit_t *genes;
-    int fitness;
-} Chromosome;
-void sortPop(Chromosome** in, int population);
 Chromosome *createChromosome(int L);
 typedef struct {
     int generation;
@@ -70,132 +71,275 @@ typedef struct {
 } Hyper;
 
 // ---------- SQLite helpers (NEW) ----------
-static sqlite3 *g_db = NULL;
+static GaDb g_db;                // every statement prepared once, see gadb.h
+static GaDbWatch g_watch = { .fd = -1 }; // wakes the waits for evaluators on their commits
+static EvalPool g_eval; // LOCAL mode fitness threads
+static CheckpointWriter g_ckpt; // checkpoints are written on its thread
+static pthread_mutex_t g_db_lock = PTHREAD_MUTEX_INITIALIZER; // island threads share g_db
+static int g_archive_every = 10;  // generations between archive rolls, 0 never; see db_archive_roll()
+static int g_archive_last;        // generation of the last roll
+static GaDbArchived g_archived;
 
 static void die_sqlite(const char *msg, int rc) {
     fprintf(stderr, "SQLite error: %s (rc=%d)\n", msg, rc);
     exit(1);
 }
 
+// WAL and synchronous=NORMAL: durable enough, still fast.  Evaluators write
+// while we do (always so with --steady), gadb_open() waits out their locks.
 static void db_open(const char *path) {
-    int rc = sqlite3_open(path, &g_db);
+    int rc = gadb_open(&g_db, path);
     if (rc != SQLITE_OK) die_sqlite("sqlite3_open failed", rc);
-    // pragma: durable enough, still fast
-    sqlite3_exec(g_db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
-    sqlite3_exec(g_db, "PRAGMA synchronous=NORMAL;", NULL, NULL, NULL);
+    gadb_watch_open(&g_watch, path);
 }
 
+// what is left of individuals_archive is packed and the WAL truncated, so
+// the database is whole without its -wal file
 static void db_close(void) {
-    if (g_db) sqlite3_close(g_db);
-    g_db = NULL;
+    if (g_archive_every > 0) gadb_archive_roll(&g_db, INT_MAX, &g_archived);
+    gadb_checkpoint(&g_db, SQLITE_CHECKPOINT_TRUNCATE, 1000);
+    if (g_archived.rows > 0)
+        printf("Archive: %ld rows in %ld packed generations, %lld bytes (%lld unpacked)\n",
+               g_archived.rows, g_archived.gens, g_archived.packed, g_archived.raw);
+    gadb_watch_close(&g_watch);
+    gadb_close(&g_db);
 }
 
+// tables, indexes and the migrations of older databases, see gadb.h
 static void db_init_schema(void) {
-    const char *sql =
-        "CREATE TABLE IF NOT EXISTS generations ("
-        "  gen INTEGER PRIMARY KEY,"
-        "  created_ts INTEGER NOT NULL"
-        ");"
-        "CREATE TABLE IF NOT EXISTS individuals ("
-        "  gen INTEGER NOT NULL,"
-        "  idx INTEGER NOT NULL,"
-        "  chromosome BLOB NOT NULL,"
-        "  status TEXT NOT NULL DEFAULT 'pending',"   /* pending|claimed|done */
-        "  fitness REAL,"
-        "  claimed_ts INTEGER,"
-        "  done_ts INTEGER,"
-        "  PRIMARY KEY(gen, idx)"
-        ");"
-        "CREATE INDEX IF NOT EXISTS idx_indiv_status ON individuals(status);";
-    int rc = sqlite3_exec(g_db, sql, NULL, NULL, NULL);
-    if (rc != SQLITE_OK) die_sqlite("init schema failed", rc);
-}
-
-// Insert/replace all individuals for a generation as pending with their chromosome bytes
+    gadb_init_schema(&g_db);
+}
+
+// Claims whose evaluator stopped sending heartbeats go back to pending, at most once a second
+static int g_lease_ms = 30000; // lease of claims made without one
+static void db_reclaim_expired(void) {
+    static time_t last;
+    time_t now = time(NULL);
+    if (now == last) return;
+    last = now;
+    int n = gadb_reclaim(&g_db, g_lease_ms);
+    if (n > 0) printf("[lease] %d expired claim%s back to pending\n", n, n == 1 ? "" : "s");
+}
+
+// Once g_archive_every generations have passed since the last time, packs
+// the finished ones (individuals_archive) into generation_archive and
+// rewinds the WAL, while the evaluators wait for the next generation
+static void db_archive_roll(int gen) {
+    if (g_archive_every <= 0 || gen - g_archive_last < g_archive_every) return;
+    g_archive_last = gen;
+    gadb_archive_roll(&g_db, gen, &g_archived);
+    gadb_checkpoint(&g_db, SQLITE_CHECKPOINT_RESTART, 100);
+}
+
+// ---------- Fitness cache ----------
+// fitness_cache keeps, per genome (keyed by geneHash of the packed genes),
+// the running mean and variance of every fitness it was evaluated to.
+// Before a generation goes out, genomes with at least --cache-refine
+// samples (1 by default) are stored as done with their mean instead of
+// pending, so elites and duplicate children are not played again; genomes
+// with fewer samples are evaluated and the new sample refines their mean,
+// which then stands as their fitness.  --no-cache turns it off.  Entries
+// are kept per fitness function (fn: the mode and its parameters, see
+// main()), so a run scored another way does not reuse them.
+typedef struct {
+    int enabled;
+    char fn[160];            // fitness_fn of this run's entries
+    int refine;              // samples a genome needs before its mean is reused
+    int gen;                 // generation the arrays below describe, -1 none
+    int n, cap;
+    uint64_t *hash;
+    unsigned char *cached;   // 1: fitness came from the cache, not evaluated
+    Chromosome **todo;       // scratch, the individuals left to evaluate
+    long hits, misses;
+} FitnessCache;
+
+static FitnessCache g_cache = { .enabled = 1, .refine = 1, .gen = -1 };
+
+static int cache_hit(int gen, int i) {
+    return g_cache.gen == gen && i < g_cache.n && g_cache.cached[i];
+}
+
+// the individuals of gen the cache did not score, *n of them
+static Chromosome **cache_todo(int gen, Chromosome **pop, int popSize, int *n) {
+    if (g_cache.gen != gen || g_cache.n != popSize) { *n = popSize; return pop; }
+    int k = 0;
+    for (int i = 0; i < popSize; ++i) if (!g_cache.cached[i]) g_cache.todo[k++] = pop[i];
+    *n = k;
+    return g_cache.todo;
+}
+
+// cached mean of hash with at least g_cache.refine samples into *mean, 1 on a hit
+static int cache_find(uint64_t hash, int geneLength, double *mean) {
+    int hit = 0;
+    sqlite3_stmt *sel = gadb_stmt(&g_db, GADB_CACHE_FIND);
+    sqlite3_bind_int64(sel, 1, (sqlite3_int64)hash);
+    sqlite3_bind_int(sel, 2, geneLength);
+    sqlite3_bind_text(sel, 3, g_cache.fn, -1, SQLITE_STATIC);
+    int rc = sqlite3_step(sel);
+    if (rc == SQLITE_ROW) {
+        if (sqlite3_column_int(sel, 0) >= g_cache.refine) {
+            *mean = sqlite3_column_double(sel, 1);
+            hit = 1;
+        }
+    } else if (rc != SQLITE_DONE) die_sqlite("cache lookup step failed", rc);
+    sqlite3_reset(sel);
+    return hit;
+}
+
+// Looks up every genome of generation gen, hits get the cached mean as fitness
+static void cache_lookup(int gen, Chromosome **pop, int popSize, int geneLength) {
+    if (popSize > g_cache.cap) {
+        g_cache.hash = realloc(g_cache.hash, (size_t)popSize * sizeof *g_cache.hash);
+        g_cache.cached = realloc(g_cache.cached, (size_t)popSize);
+        g_cache.todo = realloc(g_cache.todo, (size_t)popSize * sizeof *g_cache.todo);
+        if (!g_cache.hash || !g_cache.cached || !g_cache.todo) { fprintf(stderr, "out of memory\n"); exit(1); }
+        g_cache.cap = popSize;
+    }
+    g_cache.gen = gen;
+    g_cache.n = popSize;
+    for (int i = 0; i < popSize; ++i) {
+        double mean;
+        g_cache.hash[i] = geneHash(pop[i], geneLength);
+        g_cache.cached[i] = g_cache.enabled && cache_find(g_cache.hash[i], geneLength, &mean);
+        if (g_cache.cached[i]) {
+            pop[i]->fitness = (int)lround(mean);
+            g_cache.hits++;
+        } else {
+            g_cache.misses++;
+        }
+    }
+}
+
+// adds one fitness sample of hash, returns the genome's mean with it
+static double cache_add(uint64_t hash, int geneLength, int fitness) {
+    sqlite3_stmt *ups = gadb_stmt(&g_db, GADB_CACHE_ADD);
+    sqlite3_bind_int64(ups, 1, (sqlite3_int64)hash);
+    sqlite3_bind_int(ups, 2, geneLength);
+    sqlite3_bind_double(ups, 3, (double)fitness);
+    sqlite3_bind_text(ups, 4, g_cache.fn, -1, SQLITE_STATIC);
+    int rc = sqlite3_step(ups);
+    if (rc != SQLITE_ROW) die_sqlite("cache update step failed", rc);
+    double mean = sqlite3_column_double(ups, 0);
+    while ((rc = sqlite3_step(ups)) == SQLITE_ROW) {}
+    if (rc != SQLITE_DONE) die_sqlite("cache update step failed", rc);
+    sqlite3_reset(ups);
+    return mean;
+}
+
+// Adds the fitness of every individual of gen that was evaluated, in one transaction.
+// With --cache-refine above 1 their fitness becomes the genome's mean so far.
+// A generation that was not looked up (a resumed one) is left out, its hits are unknown.
+static void cache_record(int gen, Chromosome **pop, int popSize, int geneLength) {
+    if (!g_cache.enabled || !g_db.db || g_cache.gen != gen || g_cache.n != popSize) return;
+    gadb_begin(&g_db);
+    for (int i = 0; i < popSize; ++i) {
+        if (cache_hit(gen, i)) continue;
+        double mean = cache_add(g_cache.hash[i], geneLength, pop[i]->fitness);
+        if (g_cache.refine > 1) pop[i]->fitness = (int)lround(mean);
+    }
+    gadb_commit(&g_db);
+}
+
+// Insert/replace all individuals for a generation with their packed chromosomes: as pending,
+// or as done when the fitness cache knows the genome; the generations before go to the archive
 static void db_insert_generation(int gen, Chromosome **pop, int popSize, int geneLength) {
-    int rc;
-    sqlite3_stmt *ins = NULL, *ins_gen = NULL;
+    gadb_begin(&g_db);
+    cache_lookup(gen, pop, popSize, geneLength);
 
-    rc = sqlite3_exec(g_db, "BEGIN IMMEDIATE;", NULL, NULL, NULL);
-    if (rc != SQLITE_OK) die_sqlite("BEGIN failed", rc);
+    // the generations before are finished, only this one stays in the queue
+    gadb_archive_before(&g_db, gen);
 
-    rc = sqlite3_prepare_v2(g_db,
-        "INSERT OR IGNORE INTO generations(gen, created_ts) VALUES(?, strftime('%s','now'));",
-        -1, &ins_gen, NULL);
-    if (rc != SQLITE_OK) die_sqlite("prepare gen insert failed", rc);
+    sqlite3_stmt *ins_gen = gadb_stmt(&g_db, GADB_GEN_INSERT);
     sqlite3_bind_int(ins_gen, 1, gen);
-    rc = sqlite3_step(ins_gen);
-    if (rc != SQLITE_DONE && rc != SQLITE_CONSTRAINT) die_sqlite("gen insert step failed", rc);
-    sqlite3_finalize(ins_gen);
-
-    rc = sqlite3_prepare_v2(g_db,
-        "INSERT OR REPLACE INTO individuals(gen, idx, chromosome, status) "
-        "VALUES(?, ?, ?, 'pending');",
-        -1, &ins, NULL);
-    if (rc != SQLITE_OK) die_sqlite("prepare indiv insert failed", rc);
+    gadb_exec(&g_db, ins_gen, "gen insert step failed");
 
+    sqlite3_stmt *ins = gadb_stmt(&g_db, GADB_INDIV_INSERT);
+    unsigned char *blob = malloc((size_t)GENE_BYTES(geneLength));
     for (int i = 0; i < popSize; ++i) {
         Chromosome *c = pop[i];
         sqlite3_bind_int(ins, 1, gen);
         sqlite3_bind_int(ins, 2, i);
-        // store raw bytes of your bit array
-        sqlite3_bind_blob(ins, 3, (const void*)c->genes, (int)geneLength * (int)sizeof(bit_t), SQLITE_STATIC);
-        rc = sqlite3_step(ins);
-        if (rc != SQLITE_DONE) die_sqlite("individual insert step failed", rc);
-        sqlite3_reset(ins);
-        sqlite3_clear_bindings(ins);
-    }
-    sqlite3_finalize(ins);
-
-    rc = sqlite3_exec(g_db, "COMMIT;", NULL, NULL, NULL);
-    if (rc != SQLITE_OK) die_sqlite("COMMIT failed", rc);
-}
-
-// Update fitness for one individual and mark done
-static void db_update_fitness(int gen, int idx, int fitness) {
-    sqlite3_stmt *upd = NULL;
-    int rc = sqlite3_prepare_v2(g_db,
-        "UPDATE individuals "
-        "SET status='done', fitness=?, done_ts=strftime('%s','now') "
-        "WHERE gen=? AND idx=?;",
-        -1, &upd, NULL);
-    if (rc != SQLITE_OK) die_sqlite("prepare update failed", rc);
-    sqlite3_bind_double(upd, 1, (double)fitness);
-    sqlite3_bind_int(upd, 2, gen);
-    sqlite3_bind_int(upd, 3, idx);
-    rc = sqlite3_step(upd);
-    sqlite3_finalize(upd);
-    if (rc != SQLITE_DONE) die_sqlite("update fitness step failed", rc);
-}
-
-// wait until COUNT(done) == popsize
-static void db_wait_for_generation_done(int gen, int popsize, int poll_ms) {
-    sqlite3_stmt *st = NULL;
-    int rc = sqlite3_prepare_v2(g_db,
-        "SELECT COUNT(*) FROM individuals WHERE gen=? AND status='done';",
-        -1, &st, NULL);
-    if (rc != SQLITE_OK) die_sqlite("prepare wait stmt failed", rc);
+        // 8 genes per byte, see genePack()
+        genePack(c, geneLength, blob);
+        sqlite3_bind_blob(ins, 3, blob, GENE_BYTES(geneLength), SQLITE_STATIC);
+        sqlite3_bind_int(ins, 4, geneLength);
+        if (g_cache.cached[i]) sqlite3_bind_double(ins, 5, (double)c->fitness);
+        else sqlite3_bind_null(ins, 5);
+        gadb_exec(&g_db, ins, "individual insert step failed");
+    }
+    free(blob);
+
+    gadb_commit(&g_db);
+}
+
+// Store the fitness of a whole evaluated generation (pop[i] is idx i) and mark it done,
+// skipping the rows the fitness cache already filled, in one transaction
+static void db_update_fitness_batch(int gen, Chromosome **pop, int popSize) {
+    gadb_begin(&g_db);
+    sqlite3_stmt *upd = gadb_stmt(&g_db, GADB_FITNESS_UPDATE);
+    for (int i = 0; i < popSize; ++i) {
+        if (cache_hit(gen, i)) continue; // stored as done already
+        sqlite3_bind_double(upd, 1, (double)pop[i]->fitness);
+        sqlite3_bind_int(upd, 2, gen);
+        sqlite3_bind_int(upd, 3, i);
+        gadb_exec(&g_db, upd, "update fitness step failed");
+    }
+    gadb_commit(&g_db);
+}
+
+// Store an evaluated generation of one island as done rows idx = island*popSize + i,
+// in one transaction.  Islands run on their own threads, g_db_lock keeps one on g_db at a time.
+static void db_insert_island_generation(int gen, int island, Chromosome **pop, int popSize, int geneLength) {
+    pthread_mutex_lock(&g_db_lock);
+    gadb_begin(&g_db);
+
+    sqlite3_stmt *ins_gen = gadb_stmt(&g_db, GADB_GEN_INSERT);
+    sqlite3_bind_int(ins_gen, 1, gen);
+    gadb_exec(&g_db, ins_gen, "gen insert step failed");
+
+    // the other islands may still write the generations before, those wait for the next pass
+    gadb_archive_before(&g_db, gen);
+
+    sqlite3_stmt *ins = gadb_stmt(&g_db, GADB_ISLAND_INSERT);
+    unsigned char *blob = malloc((size_t)GENE_BYTES(geneLength));
+    for (int i = 0; i < popSize; ++i) {
+        genePack(pop[i], geneLength, blob);
+        sqlite3_bind_int(ins, 1, gen);
+        sqlite3_bind_int(ins, 2, island * popSize + i);
+        sqlite3_bind_blob(ins, 3, blob, GENE_BYTES(geneLength), SQLITE_STATIC);
+        sqlite3_bind_int(ins, 4, geneLength);
+        sqlite3_bind_int(ins, 5, island);
+        sqlite3_bind_double(ins, 6, (double)pop[i]->fitness);
+        gadb_exec(&g_db, ins, "island insert step failed");
+    }
+    free(blob);
+
+    gadb_commit(&g_db);
+    if (island == 0) db_archive_roll(gen);
+    pthread_mutex_unlock(&g_db_lock);
+}
 
+// wait until COUNT(done) == popsize, counting again whenever someone commits
+// and every poll_ms anyway; the count is reset before sleeping so no read
+// snapshot stays open in between
+static void db_wait_for_generation_done(int gen, int popsize, int poll_ms) {
     for (;;) {
-        sqlite3_reset(st);
-        sqlite3_clear_bindings(st);
+        sqlite3_stmt *st = gadb_stmt(&g_db, GADB_COUNT_DONE);
         sqlite3_bind_int(st, 1, gen);
-        rc = sqlite3_step(st);
+        int rc = sqlite3_step(st);
         if (rc != SQLITE_ROW) die_sqlite("wait step failed", rc);
         int done = sqlite3_column_int(st, 0);
-        if (done >= popsize) { sqlite3_finalize(st); return; }
-        sleep_ms(poll_ms);
+        sqlite3_reset(st);
+        if (done >= popsize) return;
+        db_reclaim_expired();
+        gadb_wait_commit(&g_db, &g_watch, poll_ms);
     }
 }
 
-// load fitness back into in-memory population after external eval
-static void db_load_fitnesses_for_gen(int gen, Chromosome **pop, int popsize) {
-    sqlite3_stmt *st = NULL;
-    int rc = sqlite3_prepare_v2(g_db,
-        "SELECT idx, fitness FROM individuals WHERE gen=? AND status='done' ORDER BY idx;",
-        -1, &st, NULL);
-    if (rc != SQLITE_OK) die_sqlite("prepare pull fitness failed", rc);
-
+// load fitness back into in-memory population after external eval, and feed the fitness cache
+static void db_load_fitnesses_for_gen(int gen, Chromosome **pop, int popsize, int geneLength) {
+    sqlite3_stmt *st = gadb_stmt(&g_db, GADB_LOAD_FITNESS);
+    int rc;
     sqlite3_bind_int(st, 1, gen);
     while ((rc = sqlite3_step(st)) == SQLITE_ROW) {
         int idx = sqlite3_column_int(st, 0);
@@ -203,10 +347,8 @@ static void db_load_fitnesses_for_gen(int gen, Chromosome **pop, int popsize) {
         if (idx >= 0 && idx < popsize && pop[idx]) pop[idx]->fitness = (int)(fit + 0.5);
     }
     if (rc != SQLITE_DONE) die_sqlite("pull fitness step failed", rc);
-    sqlite3_finalize(st);
-
-    // keep your sort order consistent for selection
-    sortPop(pop, popsize);
+    sqlite3_reset(st);
+    cache_record(gen, pop, popsize, geneLength);
 }
 
 #include <sys/stat.h>
@@ -216,107 +358,125 @@ static int file_exists(const char *p){
     return (p && stat(p, &st) == 0 && S_ISREG(st.st_mode));
 }
 
+// --export-gen: a generation's rows as CSV on stdout, genes as a bit string;
+// packed ones come out of generation_archive as they went in
+typedef struct {
+    int gen;
+    GaJob job;               // scratch for the genes
+} ExportCtx;
+
+static void export_row(void *arg, const GaPackRow *row) {
+    ExportCtx *x = arg;
+    int L = row->gene_len >= 0 ? row->gene_len : row->bytes; // NULL: one byte per gene
+    ga_job_unpack(&x->job, L, row->genes, row->bytes, row->gene_len >= 0);
+    printf("%d,%d,", x->gen, row->idx);
+    if (row->gene_len >= 0) printf("%d", row->gene_len);
+    putchar(',');
+    if (row->island >= 0) printf("%d", row->island);
+    putchar(',');
+    if (row->has_fitness) printf("%.17g", row->fitness);
+    putchar(',');
+    if (row->has_done_ts) printf("%lld", (long long)row->done_ts);
+    putchar(',');
+    for (int i = 0; i < L; ++i) putchar('0' + geneGet(&x->job.chrom, i));
+    putchar('\n');
+}
+
+static int db_export_generation(int gen) {
+    ExportCtx x = { gen, { 0 } };
+    printf("gen,idx,gene_len,island,fitness,done_ts,genes\n");
+    long n = gadb_generation_rows(&g_db, gen, export_row, &x);
+    ga_jobs_free(&x.job, 1);
+    if (n < 0) fprintf(stderr, "generation %d: a packed BLOB is damaged\n", gen);
+    else if (n == 0) fprintf(stderr, "generation %d: no rows\n", gen);
+    return n > 0 ? 0 : 1;
+}
+
 // Returns 1 if there is any row in DB, 0 if empty
 static int db_has_any_rows(void){
-    sqlite3_stmt *st=NULL; int rc, any=0;
-    rc = sqlite3_prepare_v2(g_db, "SELECT 1 FROM individuals LIMIT 1;", -1, &st, NULL);
-    if(rc==SQLITE_OK && sqlite3_step(st)==SQLITE_ROW) any=1;
-    if(st) sqlite3_finalize(st);
+    sqlite3_stmt *st = gadb_stmt(&g_db, GADB_ANY_ROWS);
+    int any = sqlite3_step(st)==SQLITE_ROW;
+    sqlite3_reset(st);
     return any;
 }
 
+// The run's seed: the one stored in the database, so a resumed run draws the
+// same streams, or else seed, which is stored for the next resume
+static uint64_t db_run_seed(uint64_t seed){
+    sqlite3_stmt *st = gadb_stmt(&g_db, GADB_RUN_SEED);
+    int rc = sqlite3_step(st);
+    if(rc==SQLITE_ROW) seed = (uint64_t)sqlite3_column_int64(st,0);
+    sqlite3_reset(st);
+    if(rc==SQLITE_ROW) return seed;
+    if(rc!=SQLITE_DONE) die_sqlite("step run seed", rc);
+    st = gadb_stmt(&g_db, GADB_RUN_INSERT);
+    sqlite3_bind_int64(st,1,(sqlite3_int64)seed);
+    gadb_exec(&g_db, st, "run seed insert failed");
+    return seed;
+}
+
 // Get latest generation number present in the DB; returns 1 on success
 static int db_get_latest_gen(int *out_gen){
-    sqlite3_stmt *st=NULL; int rc;
-    rc = sqlite3_prepare_v2(g_db, "SELECT MAX(gen) FROM individuals;", -1, &st, NULL);
-    if(rc!=SQLITE_OK) die_sqlite("prepare MAX(gen)", rc);
-    rc = sqlite3_step(st);
-    if(rc==SQLITE_ROW && !sqlite3_column_type(st,0)==SQLITE_NULL){
+    sqlite3_stmt *st = gadb_stmt(&g_db, GADB_LATEST_GEN);
+    int found = 0;
+    int rc = sqlite3_step(st);
+    if(rc==SQLITE_ROW && sqlite3_column_type(st,0)!=SQLITE_NULL){
         *out_gen = sqlite3_column_int(st,0);
-        sqlite3_finalize(st);
-        return 1;
-    }
-    sqlite3_finalize(st);
-    return 0;
+        found = 1;
+    } else if(rc!=SQLITE_ROW) die_sqlite("step MAX(gen)", rc);
+    sqlite3_reset(st);
+    return found;
 }
 
 // Count done vs total for a generation
 static void db_counts_for_gen(int gen, int *out_total, int *out_done){
-    sqlite3_stmt *st=NULL; int rc;
+    sqlite3_stmt *st = gadb_stmt(&g_db, GADB_GEN_COUNTS);
     *out_total=0; *out_done=0;
-    rc = sqlite3_prepare_v2(g_db,
-        "SELECT COUNT(*), SUM(status='done') FROM individuals WHERE gen=?;", -1, &st, NULL);
-    if(rc!=SQLITE_OK) die_sqlite("prepare counts", rc);
     sqlite3_bind_int(st,1,gen);
     if(sqlite3_step(st)==SQLITE_ROW){
         *out_total = sqlite3_column_int(st,0);
         *out_done  = sqlite3_column_int(st,1);
     }
-    sqlite3_finalize(st);
+    sqlite3_reset(st);
 }
 
 // Get pop size and geneLength for a generation
 static void db_get_shape_for_gen(int gen, int *popsize, int *geneLength){
-    sqlite3_stmt *st=NULL; int rc;
-    *popsize=0; *geneLength=0;
-    // pop size
-    rc = sqlite3_prepare_v2(g_db,
-        "SELECT COUNT(*) FROM individuals WHERE gen=?;", -1, &st, NULL);
-    if(rc!=SQLITE_OK) die_sqlite("prepare popsize", rc);
-    sqlite3_bind_int(st,1,gen);
-    if(sqlite3_step(st)==SQLITE_ROW) *popsize = sqlite3_column_int(st,0);
-    sqlite3_finalize(st);
-    // geneLength from first row blob size
-    rc = sqlite3_prepare_v2(g_db,
-        "SELECT LENGTH(chromosome) FROM individuals WHERE gen=? ORDER BY idx LIMIT 1;", -1, &st, NULL);
-    if(rc!=SQLITE_OK) die_sqlite("prepare geneLength", rc);
+    int done;
+    *geneLength=0;
+    db_counts_for_gen(gen, popsize, &done);
+    // geneLength from the first row
+    sqlite3_stmt *st = gadb_stmt(&g_db, GADB_GEN_GENE_LEN);
     sqlite3_bind_int(st,1,gen);
     if(sqlite3_step(st)==SQLITE_ROW) *geneLength = sqlite3_column_int(st,0);
-    sqlite3_finalize(st);
-}
-
-// Ensure in-memory population is allocated to match (re)loaded shape
-static void ensure_population(Chromosome ***pop, int *cur_popsize, int new_popsize, int new_geneLength){
-    if(*pop && *cur_popsize==new_popsize) return; // assume chromosomes already sized
-    // free old if present (simple/free-only version; adjust as you need)
-    if(*pop){
-        for(int i=0;i<*cur_popsize;i++){
-            if((*pop)[i]){
-                free((*pop)[i]->genes);
-                free((*pop)[i]);
-            }
-        }
-        free(*pop);
-    }
-    *pop = (Chromosome**)malloc((size_t)new_popsize*sizeof(Chromosome*));
-    for(int i=0;i<new_popsize;i++){
-        (*pop)[i] = createChromosome(new_geneLength);
+    sqlite3_reset(st);
+}
+
+static void ensure_population(Population *P, int new_popsize, int new_geneLength){
+    if(populationInit(P, new_popsize, new_geneLength) != 0){
+        fprintf(stderr, "could not allocate a population of %d x %d genes\n", new_popsize, new_geneLength);
+        exit(1);
     }
-    *cur_popsize = new_popsize;
 }
 
 // Load chromosomes + fitness from DB into memory
 static void db_load_population_for_gen(int gen, Chromosome **pop, int popsize, int geneLength){
-    sqlite3_stmt *st=NULL; int rc;
-    rc = sqlite3_prepare_v2(g_db,
-        "SELECT idx, chromosome, fitness FROM individuals WHERE gen=? ORDER BY idx;", -1, &st, NULL);
-    if(rc!=SQLITE_OK) die_sqlite("prepare load pop", rc);
+    sqlite3_stmt *st = gadb_stmt(&g_db, GADB_LOAD_POPULATION); int rc;
     sqlite3_bind_int(st,1,gen);
     while((rc=sqlite3_step(st))==SQLITE_ROW){
         int idx = sqlite3_column_int(st,0);
         const void *blob = sqlite3_column_blob(st,1);
         int blen = sqlite3_column_bytes(st,1);
         double fit = sqlite3_column_type(st,2)==SQLITE_NULL ? 0.0 : sqlite3_column_double(st,2);
+        int packed = sqlite3_column_type(st,3)!=SQLITE_NULL;
         if(idx>=0 && idx<popsize && pop[idx]){
-            int tocopy = blen < geneLength ? blen : geneLength;
-            memcpy(pop[idx]->genes, blob, (size_t)tocopy);
-            if (tocopy < geneLength) memset(pop[idx]->genes + tocopy, 0, (size_t)(geneLength - tocopy));
+            if (packed) geneUnpack(pop[idx], geneLength, blob, blen);
+            else geneUnpackBytes(pop[idx], geneLength, blob, blen);
             pop[idx]->fitness = (int)(fit + 0.5);
         }
     }
     if(rc!=SQLITE_DONE) die_sqlite("step load pop", rc);
-    sqlite3_finalize(st);
-    sortPop(pop, popsize);
+    sqlite3_reset(st);
 }
 
 
@@ -324,10 +484,10 @@ void printChromosomeSingle(const Chromosome *c, int L)
 {
     printf("fitness=%d genes=", c->fitness);
 
-    /* print gene bits as characters; safe if genes is an array of bit_t bytes */
+    /* print gene bits as characters */
     if (c->genes) {
         for (int j = 0; j < L; ++j) {
-            printf(c->genes[j] ? "1" : "0");
+            printf(geneGet(c, j) ? "1" : "0");
         }
     } else {
         printf("<no-genes>");
@@ -345,10 +505,10 @@ void printChromosome(const Chromosome *c, int idx, int L)
     if (idx >= 0) printf("[%d] ", idx);
     printf("fitness=%d genes=", c->fitness);
 
-    /* print gene bits as characters; safe if genes is an array of bit_t bytes */
+    /* print gene bits as characters */
     if (c->genes) {
         for (int j = 0; j < L; ++j) {
-            printf(c->genes[j] ? "1" : "0");
+            printf(geneGet(c, j) ? "1" : "0");
         }
     } else {
         printf("<no-genes>");
@@ -393,7 +553,7 @@ void printPopulation(Chromosome **pop, int pop_size, int L)
 Chromosome *createChromosome(int L)
 {
     Chromosome *c = malloc(sizeof(Chromosome));
-    c->genes = calloc((size_t)L, sizeof(bit_t));
+    c->genes = calloc((size_t)GENE_WORDS(L), sizeof(gene_word_t));
     c->fitness = 0;
     return c;
 }
@@ -406,139 +566,158 @@ void freeChromosome(Chromosome* c)
 }
 
 void copyChromosome(Chromosome *out, const Chromosome *src, int length) {
-    memcpy(out->genes, src->genes, (size_t)length * sizeof(bit_t));
+    memcpy(out->genes, src->genes, (size_t)GENE_WORDS(length) * sizeof(gene_word_t));
     out->fitness = src->fitness;
 }
 
-void randomChromosome(Chromosome *ind, int geneLength) {
-    for (int i = 0; i < geneLength; ++i) {
-        ind->genes[i] = (rand() < RAND_MAX / 2) ? 1 : 0;
-    }
+void randomChromosome(Chromosome *ind, int geneLength, Rng *rng) {
+    int n = GENE_WORDS(geneLength);
+    for (int w = 0; w < n; ++w) ind->genes[w] = rngNext(rng);
+    if (n > 0) ind->genes[n - 1] &= geneTailMask(geneLength);
 }
 
 int fitness(const Chromosome *ind, int geneLength) {
-    int sum = 0;
-    for (int i = 0; i < geneLength; ++i) sum += (ind->genes[i] ? 1 : 0);
-    return sum;
+    return genePopcount(ind, geneLength);
 }
 
-int compareChromosomeFit(const void* a, const void* b)
-{
-    Chromosome *A = *(Chromosome **)a;
-    Chromosome *B = *(Chromosome **)b;
-    if (A->fitness > B->fitness) return -1;
-    if (A->fitness < B->fitness) return 1;
-    return 0;
-}
-void sortPop(Chromosome** in, int population)
-{
-    qsort(in, (size_t)population, sizeof(Chromosome*), compareChromosomeFit);
-}
-//evaluate and sort 
+//evaluate, selection happens in reproduce()
 int evaluate(Chromosome** pop, int (*fitfunc)(const Chromosome *, int), int popSize, int geneLength)
 {
     for(int i=0;i<popSize;i++){
         pop[i]->fitness = fitfunc(pop[i], geneLength);
     }
-    sortPop(pop,popSize);
 }
 
+// LOCAL mode: fitness of the genomes the cache did not know on every core through g_eval,
+// then one batched DB write
 int evaluate_sqlite(Chromosome** pop, int (*fitfunc)(const Chromosome *, int),
                     int popSize, int geneLength, int generation)
 {
-    for (int i = 0; i < popSize; i++) {
-        pop[i]->fitness = fitfunc(pop[i], geneLength);
-        // NEW: persist fitness to DB
-        if (g_db) db_update_fitness(generation, i, pop[i]->fitness);
+    int n;
+    Chromosome **todo = cache_todo(generation, pop, popSize, &n);
+    if (evalPoolRun(&g_eval, todo, n, geneLength, fitfunc) != 0) {
+        fprintf(stderr, "out of memory evaluating generation %d\n", generation);
+        exit(1);
+    }
+    if (g_db.db) db_update_fitness_batch(generation, pop, popSize);
+    cache_record(generation, pop, popSize, geneLength);
+    return 0;
+}
+
+// score the generation in the batched simulator, then persist like evaluate_sqlite
+int evaluate_sim(Chromosome** pop, int popSize, int geneLength, int generation, const SimBatchConfig *cfg)
+{
+    int n;
+    Chromosome **todo = cache_todo(generation, pop, popSize, &n);
+    if (n > 0 && simBatchEvaluate(todo, n, geneLength, cfg) != 0) {
+        fprintf(stderr, "simulated evaluation failed\n");
+        exit(1);
     }
-    sortPop(pop, popSize);
+    if (g_db.db) db_update_fitness_batch(generation, pop, popSize);
+    cache_record(generation, pop, popSize, geneLength);
     return 0;
 }
 
 
-void crossover(const Chromosome *a, const Chromosome *b, Chromosome *c1, int geneLength) {
-    int point = rand() % geneLength;
+// genes [0, p) from a, [p, point) from b, the rest of c1 is left as it was
+void crossover(const Chromosome *a, const Chromosome *b, Chromosome *c1, int geneLength, Rng *rng) {
+    int point = (int)rngBelow(rng, (uint32_t)geneLength);
     point = point < 2 ? 2 : point;
-    int p = 1 + rand() % (point - 1);
-    for (int i = 0; i < p; ++i) {
-        c1->genes[i] = a->genes[i];
-    }
-    for (int i = p; i < point; ++i) {
-        c1->genes[i] = b->genes[i];
-    }
+    int p = 1 + (int)rngBelow(rng, (uint32_t)(point - 1));
+    geneCopyRange(c1, a, 0, p);
+    geneCopyRange(c1, b, p, point);
 }
 
-void mutate(Chromosome *c, int length, double mr) {
-    for (int i = 0; i < length; ++i) {
-        double r = (double)rand() / (double)RAND_MAX;
-        if (r < mr) c->genes[i] = c->genes[i] ? 0 : 1;
-    }
+// geometric gaps between flips, see geneMutate.h
+void mutate(Chromosome *c, int length, double mr, Rng *rng) {
+    geneMutate(c, length, mr, rng);
 }
 
 
-//a and b will be less than elites
-int selectParents(int elites, int *a, int *b) {
-    if (elites < 2) return -1;
-    int x = rand() % elites;
-    int y = rand() % (elites - 1);
-    if (y >= x) y += 1;
-    *a = x;
-    *b = y;
+//two different parents: uniform among the elites, or by sel's tournament/rank over the population
+int selectParents(const Selection *sel, int elites, int *a, int *b, Rng *rng) {
+    if (sel->mode == SELECT_ELITE) {
+        if (elites < 2) return -1;
+        int x = (int)rngBelow(rng, (uint32_t)elites);
+        int y = (int)rngBelow(rng, (uint32_t)(elites - 1));
+        if (y >= x) y += 1;
+        *a = x;
+        *b = y;
+        return 0;
+    }
+    if (sel->size < 2) return -1;
+    *a = selectionDraw(sel, elites, rng);
+    // a strong tournament keeps drawing the same best; after a few tries anyone else will do
+    for (int t = 0; t < 8; ++t) {
+        *b = selectionDraw(sel, elites, rng);
+        if (*b != *a) return 0;
+    }
+    *b = (int)rngBelow(rng, (uint32_t)(sel->size - 1));
+    if (*b >= *a) *b += 1;
     return 0;
 }
 
-//in-place operation of reproduction
-//leave elitism Chromosomes as is
-void reproduce(Chromosome** pop, int elitism, double mr, int popSize, int geneLength)
+//breeds the next generation into the other buffer and swaps it in
+//the elitism best Chromosomes carry over as they are
+//child i of generation gen draws from its own stream, so children do not depend on each other
+void reproduce(Population *P, Selection *sel, int elitism, double mr, uint64_t seed, int gen)
 {
-    for(int i=elitism;i<popSize;i++)
+    Chromosome **pop = P->pop, **next = P->next;
+    //elites to the front, best first, without sorting the rest
+    if(selectionElites(sel, pop, P->size, elitism) != 0)
+    {
+        printf("Out of memory selecting generation %d\n", gen);
+        exit(1);
+    }
+    //slot i starts as pop[i]: elites stay, children keep the genes crossover does not cover
+    for(int i=0;i<P->size;i++)
+        copyChromosome(next[i],pop[i],P->geneLength);
+    for(int i=elitism;i<P->size;i++)
     {
+        Rng rng;
+        rngStream(&rng, seed, RNG_STREAM_REPRODUCE, (uint64_t)gen, (uint64_t)i);
         int a, b;
-        selectParents(elitism, &a, &b);
-        crossover(pop[a],pop[b],pop[i],geneLength);
-        mutate(pop[i],geneLength,mr);
-        pop[i]->fitness = 0;
+        selectParents(sel, elitism, &a, &b, &rng);
+        crossover(pop[a],pop[b],next[i],P->geneLength,&rng);
+        mutate(next[i],P->geneLength,mr,&rng);
+        next[i]->fitness = 0;
     }
+    populationSwap(P);
 }
 
-void createPopulation(Chromosome** pop, int population, int geneLength)
+void createPopulation(Population *P, uint64_t seed)
 {
-    for (int i = 0; i < population; ++i) {
-        pop[i] = createChromosome(geneLength);
-        randomChromosome(pop[i],geneLength); //for testing
+    for (int i = 0; i < P->size; ++i) {
+        Rng rng;
+        rngStream(&rng, seed, RNG_STREAM_INIT, 0, (uint64_t)i);
+        randomChromosome(P->pop[i],P->geneLength,&rng); //for testing
+        P->pop[i]->fitness = 0;
     }
 }
 
-int savePopulation(const char *path, Chromosome **pop, Hyper* hyperparm)
+static void checkpointHeader(CheckpointHeader *h, const Hyper *hyperparm, uint64_t seed)
+{
+    memset(h, 0, sizeof *h);
+    h->generation = hyperparm->generation;
+    h->population = hyperparm->population;
+    h->geneLength = hyperparm->geneLength;
+    h->elitism = hyperparm->elitism;
+    h->generations = hyperparm->generations;
+    h->saveEvery = hyperparm->saveEvery;
+    h->mutation = hyperparm->mutation;
+    h->seed = seed;
+}
+
+// binary checkpoint of pop, written on the writer's thread (see checkpoint.h)
+int savePopulation(CheckpointWriter *w, const char *path, Chromosome **pop, const Hyper *hyperparm, uint64_t seed)
 {
+    CheckpointHeader h;
     if (!path || !pop || hyperparm->population <= 0 || hyperparm->geneLength <= 1) return -1;
-    FILE *f = fopen(path, "w");
-    if (!f) return -1;
-    fprintf(f, "# generation=%d population=%d geneLength=%d elitism=%d generations=%d saveEvery=%d mutation=%f\n", 
-            hyperparm->generation, //current generation
-            hyperparm->population,
-            hyperparm->geneLength, 
-            hyperparm->elitism,
-            hyperparm->generations,
-            hyperparm->saveEvery,
-            hyperparm->mutation);
-
-    for (int i = 0; i < hyperparm->population; ++i) {
-        Chromosome *c = pop[i];
-        if (!c || !c->genes) {
-            if (fprintf(f, "0 ") < 0) { fclose(f); return -1; }
-            for (int g = 0; g < hyperparm->geneLength; ++g) if (fputc('0', f) == EOF) { fclose(f); return -1; }
-            if (fputc('\n', f) == EOF) { fclose(f); return -1; }
-            continue;
-        }
-        if (fprintf(f, "%d ", c->fitness) < 0) { fclose(f); return -1; }
-        for (int g = 0; g < hyperparm->geneLength; ++g) {
-            if (fputc(c->genes[g] ? '1' : '0', f) == EOF) { fclose(f); return -1; }
-        }
-        if (fputc('\n', f) == EOF) { fclose(f); return -1; }
+    checkpointHeader(&h, hyperparm, seed);
+    if (checkpointWriterSave(w, path, &h, pop) != 0) {
+        fprintf(stderr, "could not save checkpoint %s\n", path);
+        return -1;
     }
-
-    fclose(f);
     return 0;
 }
 
@@ -640,6 +819,7 @@ int parseDataLine(char *line, int *out_fit, char **out_bits) {
     return 0;
 }
 
+// imports an old text checkpoint ('0'/'1' per gene)
 int loadPopulation(const char *path, Chromosome **pop, Hyper* hyperparm)
 {
     if (!path || !pop) return -1;
@@ -674,7 +854,7 @@ int loadPopulation(const char *path, Chromosome **pop, Hyper* hyperparm)
             if (!c) continue;
             pop[filled] = c;
         }
-        for (int i = 0; i < hyperparm->geneLength; ++i) c->genes[i] = (bits[i] == '1') ? 1 : 0;
+        for (int i = 0; i < hyperparm->geneLength; ++i) geneSet(c, i, bits[i] == '1');
         c->fitness = fit;
         filled++;
     }
@@ -697,9 +877,354 @@ void removeNumericSuffix(char *s) {
     printf("success");
 }
 
+// ---------- Island model ----------
+// --islands K runs K populations of --population (default 10) each, one thread per island.
+// Island k sends its --migrants best to island k+1 (a ring) every --migrate-every
+// generations through a MigrationRing and takes in whatever has arrived from
+// k-1 after each evaluation, replacing its worst.  Nothing waits on another
+// island, and each island stores its generations itself (island column).
+typedef struct {
+    int id;
+    Population P;
+    Selection sel;
+    MigrationRing *in, *out;   // from island id-1, to island id+1
+    Hyper hyperparm;
+    uint64_t seed;             // the island's own seed, see RNG_STREAM_ISLAND
+    int migrateEvery, migrants;
+    int use_sim;
+    SimBatchConfig simcfg;
+    const char *path;
+    CheckpointWriter writer;
+    int received;              // migrants taken in
+} Island;
+
+static void island_evaluate(Island *is, int gen)
+{
+    Population *P = &is->P;
+    if (is->use_sim) {
+        if (simBatchEvaluate(P->pop, P->size, P->geneLength, &is->simcfg) != 0) {
+            fprintf(stderr, "island %d: simulated evaluation failed\n", is->id);
+            exit(1);
+        }
+    } else {
+        for (int i = 0; i < P->size; i++) P->pop[i]->fitness = fitness(P->pop[i], P->geneLength);
+    }
+
+    // migrants that arrived meanwhile replace the worst, as they are (fitness included)
+    int m = selectionWorst(&is->sel, P->pop, P->size, is->migrants);
+    for (int j = 0; j < m; j++) {
+        if (migrationPop(is->in, P->pop[is->sel.keys[P->size - m + j].index]) != 0) break;
+        is->received++;
+    }
+
+    if (g_db.db) db_insert_island_generation(gen, is->id, P->pop, P->size, P->geneLength);
+
+    if (gen % is->migrateEvery == 0) {
+        selectionElites(&is->sel, P->pop, P->size, is->migrants);
+        for (int j = 0; j < is->migrants && j < P->size; j++)
+            if (migrationPush(is->out, P->pop[j]) != 0) break; // next island is behind, drop the rest
+    }
+}
+
+static void *island_run(void *arg)
+{
+    Island *is = arg;
+    Hyper *h = &is->hyperparm;
+    checkpointWriterStart(&is->writer); // on failure it saves in the loop
+    createPopulation(&is->P, is->seed);
+    island_evaluate(is, h->generation);
+    for (int i = h->generation + 1; i <= h->generations; i++) {
+        reproduce(&is->P, &is->sel, h->elitism, h->mutation, is->seed, i);
+        island_evaluate(is, i);
+        if (i % h->saveEvery == 0) {
+            char buf[256];
+            snprintf(buf, sizeof buf, "%s-island%d-%d", is->path, is->id, i);
+            h->generation = i;
+            savePopulation(&is->writer, buf, is->P.pop, h, is->seed);
+        }
+    }
+    checkpointWriterStop(&is->writer);
+    return NULL;
+}
+
+// runs K islands to hyperparm->generations, prints each island's final population
+static int run_islands(int K, const Hyper *hyperparm, const Selection *sel, int migrateEvery, int migrants,
+                       uint64_t seed, int use_sim, const SimBatchConfig *simcfg, const char *path)
+{
+    Island *islands = calloc((size_t)K, sizeof *islands);
+    MigrationRing *rings = calloc((size_t)K, sizeof *rings);
+    pthread_t *tid = calloc((size_t)K, sizeof *tid);
+    if (!islands || !rings || !tid) { fprintf(stderr, "out of memory\n"); exit(1); }
+
+    for (int k = 0; k < K; k++) {
+        Island *is = &islands[k];
+        is->id = k;
+        ensure_population(&is->P, hyperparm->population, hyperparm->geneLength);
+        is->sel = *sel;
+        is->sel.keys = NULL;
+        is->sel.tmp = NULL;
+        is->sel.capacity = 0;
+        // room for two rounds of migrants, in case the receiver is a round behind
+        if (migrationRingInit(&rings[k], 2 * migrants, hyperparm->geneLength) != 0) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        is->out = &rings[k];
+        is->in = &rings[(k + K - 1) % K];
+        is->hyperparm = *hyperparm;
+        Rng r;
+        rngStream(&r, seed, RNG_STREAM_ISLAND, (uint64_t)k, 0);
+        is->seed = rngNext(&r);
+        is->migrateEvery = migrateEvery;
+        is->migrants = migrants;
+        is->use_sim = use_sim;
+        is->simcfg = *simcfg;
+        is->simcfg.threads = 1; // the islands are the parallelism
+        is->path = path;
+    }
+    for (int k = 0; k < K; k++) {
+        if (pthread_create(&tid[k], NULL, island_run, &islands[k]) != 0) {
+            fprintf(stderr, "could not start island %d\n", k);
+            exit(1);
+        }
+    }
+    for (int k = 0; k < K; k++) pthread_join(tid[k], NULL);
+
+    for (int k = 0; k < K; k++) {
+        printf("Island %d (%d migrants received):\n---------------------------------------------------------\n",
+               k, islands[k].received);
+        printPopulation(islands[k].P.pop, islands[k].P.size, islands[k].P.geneLength);
+        selectionFree(&islands[k].sel);
+        populationFree(&islands[k].P);
+        migrationRingFree(&rings[k]);
+    }
+    free(islands);
+    free(rings);
+    free(tid);
+    return 0;
+}
+
+// hit rate of the fitness cache, and its buffers go
+static void cache_report(void) {
+    if (g_cache.enabled)
+        printf("Fitness cache: %ld of %ld genomes scored without evaluation\n",
+               g_cache.hits, g_cache.hits + g_cache.misses);
+    free(g_cache.hash);
+    free(g_cache.cached);
+    free(g_cache.todo);
+    g_cache.hash = NULL;
+    g_cache.cached = NULL;
+    g_cache.todo = NULL;
+    g_cache.cap = g_cache.n = 0;
+    g_cache.gen = -1;
+}
+
+// ---------- Steady-state mode ----------
+// --steady (with --external) drops the generation barrier.  population
+// individuals are always out for evaluation; whenever results land, each one
+// joins the population (replacing its worst member once it is full, if it
+// is better) and one child is bred from the population to take its place.
+// Birth b is stored as row (first + b / population, b % population), so the
+// evaluators claim it like any other row and "gen" counts population-sized
+// batches of births; the run ends with batch --generations.
+
+typedef struct {
+    long birth;
+    Chromosome *c;
+    uint64_t hash;             // geneHash of c
+    int cached;                // stored as done from the fitness cache
+} SteadyInflight;
+
+// Insert births[0..n) as pending rows, or as done ones when the fitness cache knows
+// the genome (the next poll takes those in at once), one transaction
+static void db_insert_births(int first, int popSize, SteadyInflight *births, int n, int geneLength) {
+    if (n <= 0) return;
+    gadb_begin(&g_db);
+
+    unsigned char *blob = malloc((size_t)GENE_BYTES(geneLength));
+    for (int i = 0; i < n; ++i) {
+        int gen = first + (int)(births[i].birth / popSize);
+        double mean;
+        births[i].hash = geneHash(births[i].c, geneLength);
+        births[i].cached = g_cache.enabled && cache_find(births[i].hash, geneLength, &mean);
+        if (births[i].cached) g_cache.hits++;
+        else g_cache.misses++;
+        if (births[i].birth % popSize == 0 || i == 0) {
+            sqlite3_stmt *ins_gen = gadb_stmt(&g_db, GADB_GEN_INSERT);
+            sqlite3_bind_int(ins_gen, 1, gen);
+            gadb_exec(&g_db, ins_gen, "gen insert step failed");
+        }
+        sqlite3_stmt *ins = gadb_stmt(&g_db, GADB_INDIV_INSERT);
+        genePack(births[i].c, geneLength, blob);
+        sqlite3_bind_int(ins, 1, gen);
+        sqlite3_bind_int(ins, 2, (int)(births[i].birth % popSize));
+        sqlite3_bind_blob(ins, 3, blob, GENE_BYTES(geneLength), SQLITE_STATIC);
+        sqlite3_bind_int(ins, 4, geneLength);
+        if (births[i].cached) sqlite3_bind_double(ins, 5, mean);
+        gadb_exec(&g_db, ins, "individual insert step failed");
+    }
+    free(blob);
+
+    gadb_commit(&g_db);
+}
+
+// in-flight entry of birth b, entries are ordered by birth
+static int steady_find(const SteadyInflight *fl, int n, long b) {
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (fl[mid].birth < b) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < n && fl[lo].birth == b ? lo : -1;
+}
+
+// breeds birth b from members[0..m) into c, a random individual while there are too few members
+static void steady_breed(Chromosome *c, long b, Chromosome **members, int m, Selection *sel,
+                         const Hyper *h, uint64_t seed) {
+    Rng rng;
+    rngStream(&rng, seed, RNG_STREAM_STEADY, (uint64_t)b, 0);
+    int elites = h->elitism < m ? h->elitism : m;
+    int a, p;
+    if (m < 2 || selectionElites(sel, members, m, elites) != 0 || selectParents(sel, elites, &a, &p, &rng) != 0) {
+        randomChromosome(c, h->geneLength, &rng);
+    } else {
+        copyChromosome(c, members[a], h->geneLength);
+        crossover(members[a], members[p], c, h->geneLength, &rng);
+        mutate(c, h->geneLength, h->mutation, &rng);
+    }
+    c->fitness = 0;
+}
+
+static void run_steady(Hyper *h, Selection *sel, uint64_t seed, int poll_ms, const char *path) {
+    int N = h->population, L = h->geneLength, first = h->generation;
+    long total = (long)(h->generations - first + 1) * N; // births to evaluate
+    Population P = {0};
+    ensure_population(&P, N, L); // 2N Chromosomes: members and in-flight
+    Chromosome **members = malloc((size_t)N * sizeof *members);
+    Chromosome **spare = malloc((size_t)2 * N * sizeof *spare);
+    int m = 0, nspare = 0;       // spare[0..nspare) are free
+    for (int i = 0; i < N; i++) {
+        spare[nspare++] = P.pop[i];
+        spare[nspare++] = P.next[i];
+    }
+    SteadyInflight *fl = malloc((size_t)N * sizeof *fl);
+    SteadyInflight *fresh = malloc((size_t)N * sizeof *fresh);
+    SteadyInflight *landed = malloc((size_t)N * sizeof *landed);
+    int nfl = 0;
+    long births = 0, done = 0;
+
+    // the first population, random
+    for (; births < N && births < total; births++) {
+        Chromosome *c = spare[--nspare];
+        steady_breed(c, births, members, 0, sel, h, seed);
+        fl[nfl].birth = births;
+        fl[nfl++].c = c;
+    }
+    db_insert_births(first, N, fl, nfl, L);
+
+    long nextSave = (long)h->saveEvery * N;
+    int archived = first;         // rows of gens before it are in the archive
+    while (nfl > 0) {
+        // results of in-flight births, oldest in flight first
+        long oldest = fl[0].birth;
+        // every birth of the gens before the oldest in flight has landed
+        if (first + (int)(oldest / N) > archived) {
+            archived = first + (int)(oldest / N);
+            gadb_begin(&g_db);
+            gadb_archive_before(&g_db, archived);
+            gadb_commit(&g_db);
+            db_archive_roll(archived);
+        }
+        int nlanded = 0, nfresh = 0, rc;
+        sqlite3_stmt *st = gadb_stmt(&g_db, GADB_STEADY_POLL);
+        sqlite3_bind_int(st, 1, first + (int)(oldest / N));
+        sqlite3_bind_int(st, 2, first);
+        sqlite3_bind_int(st, 3, N);
+        sqlite3_bind_int64(st, 4, oldest);
+        while ((rc = sqlite3_step(st)) == SQLITE_ROW) {
+            long b = (long)(sqlite3_column_int(st, 0) - first) * N + sqlite3_column_int(st, 1);
+            int k = steady_find(fl, nfl, b);
+            if (k < 0) continue; // taken in by an earlier poll
+            fl[k].c->fitness = (int)(sqlite3_column_double(st, 2) + 0.5);
+            landed[nlanded++] = fl[k];
+            memmove(fl + k, fl + k + 1, (size_t)(nfl - k - 1) * sizeof *fl);
+            nfl--;
+        }
+        if (rc != SQLITE_DONE) die_sqlite("steady poll step failed", rc);
+        sqlite3_reset(st);
+
+        // new samples go to the fitness cache
+        if (g_cache.enabled && nlanded > 0) {
+            gadb_begin(&g_db);
+            for (int j = 0; j < nlanded; j++) {
+                if (landed[j].cached) continue;
+                double mean = cache_add(landed[j].hash, L, landed[j].c->fitness);
+                if (g_cache.refine > 1) landed[j].c->fitness = (int)lround(mean);
+            }
+            gadb_commit(&g_db);
+        }
+
+        for (int j = 0; j < nlanded; j++) {
+            Chromosome *c = landed[j].c;
+            done++;
+
+            // join the population, or replace its worst if better
+            if (m < N) {
+                members[m++] = c;
+            } else {
+                int w = 0;
+                for (int i = 1; i < m; i++) if (members[i]->fitness < members[w]->fitness) w = i;
+                if (c->fitness > members[w]->fitness) {
+                    spare[nspare++] = members[w];
+                    members[w] = c;
+                } else {
+                    spare[nspare++] = c;
+                }
+            }
+
+            // and a child takes its place in the queue
+            if (births < total) {
+                Chromosome *child = spare[--nspare];
+                steady_breed(child, births, members, m, sel, h, seed);
+                fresh[nfresh].birth = births++;
+                fresh[nfresh++].c = child;
+            }
+        }
+
+        if (nfresh > 0) {
+            db_insert_births(first, N, fresh, nfresh, L);
+            memcpy(fl + nfl, fresh, (size_t)nfresh * sizeof *fl); // births only grow, fl stays ordered
+            nfl += nfresh;
+        }
+        if (m == N && done >= nextSave) {
+            char buf[256];
+            h->generation = first + (int)(done / N) - 1;
+            snprintf(buf, sizeof buf, "%s-%d", path, h->generation);
+            savePopulation(&g_ckpt, buf, members, h, seed);
+            nextSave += (long)h->saveEvery * N;
+        }
+        if (nfresh == 0 && nfl > 0) {
+            db_reclaim_expired();
+            gadb_wait_commit(&g_db, &g_watch, poll_ms);
+        }
+    }
+
+    printf("Evaluated %ld individuals\n", done);
+    printf("Population:\n---------------------------------------------------------\n");
+    printPopulation(members, m, L);
+    free(fl);
+    free(fresh);
+    free(landed);
+    free(members);
+    free(spare);
+    populationFree(&P);
+}
+
 int main(int argc, char **argv)
 {
-    srand((unsigned)time(NULL));
+    uint64_t seed = (uint64_t)time(NULL); // every random draw derives from this, see rng.h
+    int seed_set = 0;
 
     // defaults (some of these will be overridden by DB if present)
     char path[100] = "checkpoint";
@@ -714,17 +1239,92 @@ int main(int argc, char **argv)
 
     const char *db_path = "ga.db";
     int use_external_eval = 0;
+    int use_sim = 0;
+    int rules = 0;   // chromosomes are GASmarty rule sets, see below
+    int length_set = 0;
     int poll_ms = 250;
+    const char *fitness_tag = NULL; // names what external evaluators score, for the cache
+    int threads = 0; // LOCAL evaluation threads, 0 = every core
+    int islands = 1, migrate_every = 10, migrants = 2; // island model, see run_islands()
+    int steady = 0;  // no generation barrier, see run_steady()
+    int export_gen = -1; // --export-gen: print that generation and exit
+    Selection sel;   // parent selection, see selection.h
+    selectionDefaults(&sel);
+    SimBatchConfig simcfg;
+    simBatchDefaults(&simcfg);
 
     // minimal flag parsing
     for (int i = 1; i < argc; ++i){
         if (strcmp(argv[i], "--db")==0 && i+1<argc) db_path = argv[++i];
         else if (strcmp(argv[i], "--external")==0) use_external_eval = 1;
         else if (strcmp(argv[i], "--poll-ms")==0 && i+1<argc) poll_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--lease-ms")==0 && i+1<argc) g_lease_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--archive-every")==0 && i+1<argc) g_archive_every = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--export-gen")==0 && i+1<argc) export_gen = atoi(argv[++i]);
         else if (strcmp(argv[i], "--resume")==0 && i+1<argc) resume = atoi(argv[++i]);
         else if (strcmp(argv[i], "--checkpoint")==0 && i+1<argc) strncpy(path, argv[++i], sizeof(path));
+        else if (strcmp(argv[i], "--seed")==0 && i+1<argc) { seed = strtoull(argv[++i], NULL, 10); seed_set = 1; }
+        else if (strcmp(argv[i], "--threads")==0 && i+1<argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--select")==0 && i+1<argc) {
+            int mode = selectionParse(argv[++i]);
+            if (mode < 0) { fprintf(stderr, "unknown --select %s (elite, tournament, rank)\n", argv[i]); return 1; }
+            sel.mode = (SelectMode)mode;
+        }
+        else if (strcmp(argv[i], "--tournament")==0 && i+1<argc) sel.tournament = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rank-pressure")==0 && i+1<argc) sel.pressure = strtod(argv[++i], NULL);
+        else if (strcmp(argv[i], "--steady")==0) steady = 1;
+        else if (strcmp(argv[i], "--no-cache")==0) g_cache.enabled = 0;
+        else if (strcmp(argv[i], "--cache-refine")==0 && i+1<argc) g_cache.refine = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--fitness-tag")==0 && i+1<argc) fitness_tag = argv[++i];
+        else if (strcmp(argv[i], "--population")==0 && i+1<argc) population = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--gene-length")==0 && i+1<argc) {
+            geneLength = atoi(argv[++i]);
+            if (geneLength < 2) { fprintf(stderr, "--gene-length %s: need at least 2\n", argv[i]); return 1; }
+            length_set = 1;
+        }
+        else if (strcmp(argv[i], "--rules")==0) rules = 1;
+        else if (strcmp(argv[i], "--generations")==0 && i+1<argc) generations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--islands")==0 && i+1<argc) islands = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--migrate-every")==0 && i+1<argc) migrate_every = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--migrants")==0 && i+1<argc) migrants = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--sim")==0) use_sim = 1;
+        else if (strcmp(argv[i], "--sim-ticks")==0 && i+1<argc) {
+            simcfg.ticks = atoi(argv[++i]);
+            if (simcfg.ticks < 1) { fprintf(stderr, "--sim-ticks %s: need at least 1\n", argv[i]); return 1; }
+        }
+        else if (strcmp(argv[i], "--sim-episodes")==0 && i+1<argc) {
+            simcfg.episodes = atoi(argv[++i]); // scores are averaged over them
+            if (simcfg.episodes < 1) { fprintf(stderr, "--sim-episodes %s: need at least 1\n", argv[i]); return 1; }
+        }
+        else if (strcmp(argv[i], "--sim-enemies")==0 && i+1<argc) simcfg.enemies = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--sim-threads")==0 && i+1<argc) simcfg.threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--sim-seed")==0 && i+1<argc) simcfg.seed = strtoull(argv[++i], NULL, 10);
         // keep your other positional args if you like
     }
+    if (g_cache.refine < 1) g_cache.refine = 1;
+    // the cache's key: whatever changes the score of a genome.  External
+    // evaluators are not known here, --fitness-tag tells them apart
+    if (use_external_eval)
+        snprintf(g_cache.fn, sizeof g_cache.fn, "external %s", fitness_tag ? fitness_tag : "");
+    else if (use_sim)
+        snprintf(g_cache.fn, sizeof g_cache.fn, "sim ticks=%d episodes=%d enemies=%d seed=%llu kill=%g death=%g",
+                 simcfg.ticks, simcfg.episodes, simcfg.enemies, (unsigned long long)simcfg.seed,
+                 simcfg.killWeight, simcfg.deathWeight);
+    else
+        snprintf(g_cache.fn, sizeof g_cache.fn, "popcount");
+    // --population sizes a new run, a resumed one keeps the database's
+    if (generations < 1) { fprintf(stderr, "--generations %d: need at least 1\n", generations); return 1; }
+    if (population <= elitism) { fprintf(stderr, "--population %d: need more than the %d elites\n", population, elitism); return 1; }
+    selectionClamp(&sel, population);
+    // --sim, and GASmarty evaluating through the coordinator (--external --rules),
+    // play the chromosome as GASmarty's rule set: exactly GA_RULES_BITS genes,
+    // anything else could not be scored
+    if (use_sim) rules = 1;
+    if (rules && length_set && geneLength != GA_RULES_BITS) {
+        fprintf(stderr, "--gene-length %d: GASmarty rule sets (--sim, --rules) have %d genes\n", geneLength, GA_RULES_BITS);
+        return 1;
+    }
+    if (rules) geneLength = GA_RULES_BITS;
 
     Hyper hyperparm = {
         generation, population, geneLength, elitism, generations, saveEvery, mutation
@@ -733,9 +1333,77 @@ int main(int argc, char **argv)
     // Open DB (create if missing) and ensure schema
     db_open(db_path);
     db_init_schema();
+    if (export_gen >= 0){
+        // reads only: no seed stored, nothing rolled or checkpointed
+        int rc = db_export_generation(export_gen);
+        gadb_watch_close(&g_watch);
+        gadb_close(&g_db);
+        return rc;
+    }
+    // --seed picks a new run's seed, a resumed one keeps the database's
+    uint64_t run_seed = db_run_seed(seed);
+    if (seed_set && run_seed != seed)
+        fprintf(stderr, "[resume] %s was started with seed %llu, --seed %llu ignored\n",
+                db_path, (unsigned long long)run_seed, (unsigned long long)seed);
+    seed = run_seed;
+
+    if (islands > 1){
+        if (use_external_eval || db_has_any_rows()){
+            fprintf(stderr, "--islands evaluates in-process and starts a new run: drop --external, use an empty --db\n");
+            db_close();
+            return 1;
+        }
+        if (migrate_every < 1) migrate_every = 1;
+        if (migrants < 0) migrants = 0;
+        if (migrants > population - elitism) migrants = population - elitism > 0 ? population - elitism : 0;
+        printf("Training %d islands using DB='%s' (mode=%s)\n", islands, db_path, use_sim ? "SIM" : "LOCAL");
+        printf("\tGene Length: %d\n", hyperparm.geneLength);
+        printf("\tPopulation: %d per island\n", hyperparm.population);
+        printf("\tElitism: %d\n", hyperparm.elitism);
+        printf("\tGenerations: %d\n", hyperparm.generations);
+        printf("\tMigration: %d every %d generations\n", migrants, migrate_every);
+        printf("\tMutation Rate: %f\n", hyperparm.mutation);
+        printf("\tSeed: %llu\n", (unsigned long long)seed);
+        if (hyperparm.elitism < 3){
+            printf("Elitism of %d is too low (elitism >= 3)\n", hyperparm.elitism);
+            db_close();
+            return 0;
+        }
+        run_islands(islands, &hyperparm, &sel, migrate_every, migrants, seed, use_sim, &simcfg, path);
+        db_close();
+        selectionFree(&sel);
+        printf("Trained %d islands through generation %d\n", islands, hyperparm.generations);
+        return 0;
+    }
+
+    if (checkpointWriterStart(&g_ckpt) != 0)
+        fprintf(stderr, "could not start the checkpoint thread, saving in the loop\n");
+
+    if (steady){
+        if (!use_external_eval || db_has_any_rows()){
+            fprintf(stderr, "--steady needs --external and starts a new run: use an empty --db\n");
+            db_close();
+            return 1;
+        }
+        printf("Steady-state training using DB='%s' (mode=EXTERNAL)\n", db_path);
+        printf("\tGene Length: %d\n", hyperparm.geneLength);
+        printf("\tPopulation: %d\n", hyperparm.population);
+        printf("\tElitism: %d\n", hyperparm.elitism);
+        printf("\tGenerations: %d\n", hyperparm.generations);
+        printf("\tSave Every: %d\n", hyperparm.saveEvery);
+        printf("\tMutation Rate: %f\n", hyperparm.mutation);
+        printf("\tSeed: %llu\n", (unsigned long long)seed);
+        run_steady(&hyperparm, &sel, seed, poll_ms, path);
+        checkpointWriterStop(&g_ckpt);
+        cache_report();
+        db_close();
+        selectionFree(&sel);
+        return 0;
+    }
 
-    Chromosome **pop = NULL;
-    int cur_pop = 0;
+    Population P = {0};
+    if (!use_external_eval && !use_sim && evalPoolStart(&g_eval, threads) != 0)
+        fprintf(stderr, "could not start evaluation threads, evaluating on one core\n");
 
     if (file_exists(db_path) && db_has_any_rows()){
         // ---- Resume from latest generation in DB ----
@@ -744,13 +1412,21 @@ int main(int argc, char **argv)
         int db_pop=0, db_L=0; db_get_shape_for_gen(latest, &db_pop, &db_L);
         if (db_pop <= 0 || db_L <= 0){
             fprintf(stderr, "DB exists but has no valid individuals; seeding anew.\n");
+        } else if (rules && db_L != GA_RULES_BITS){
+            fprintf(stderr, "%s holds chromosomes of %d genes, GASmarty rule sets (--sim, --rules) have %d\n",
+                    db_path, db_L, GA_RULES_BITS);
+            if (g_eval.threads) evalPoolStop(&g_eval);
+            checkpointWriterStop(&g_ckpt);
+            db_close();
+            return 1;
         } else {
             // adopt DB shape and hyper parameters
             hyperparm.generation = latest;
             hyperparm.population = population = db_pop;
             hyperparm.geneLength = geneLength = db_L;
-            ensure_population(&pop, &cur_pop, population, geneLength);
-            db_load_population_for_gen(latest, pop, population, geneLength);
+            selectionClamp(&sel, population);
+            ensure_population(&P, population, geneLength);
+            db_load_population_for_gen(latest, P.pop, population, geneLength);
 
             int total=0, done=0; db_counts_for_gen(latest, &total, &done);
             if (done < total){
@@ -758,10 +1434,12 @@ int main(int argc, char **argv)
                 if (use_external_eval){
                     // wait for external workers to finish it
                     db_wait_for_generation_done(latest, population, poll_ms);
-                    db_load_fitnesses_for_gen(latest, pop, population);
+                    db_load_fitnesses_for_gen(latest, P.pop, population, geneLength);
+                } else if (use_sim){
+                    evaluate_sim(P.pop, population, geneLength, latest, &simcfg);
                 } else {
                     // finish locally
-                    evaluate_sqlite(pop, fitness, population, geneLength, latest);
+                    evaluate_sqlite(P.pop, fitness, population, geneLength, latest);
                 }
             } else {
                 printf("[resume] gen=%d is complete. Continuing.\n", latest);
@@ -770,30 +1448,37 @@ int main(int argc, char **argv)
     }
 
     // If still no population (new DB), seed a fresh one
-    if (!pop){
-        ensure_population(&pop, &cur_pop, population, geneLength);
-        createPopulation(pop, population, geneLength);
+    if (!P.arena){
+        ensure_population(&P, population, geneLength);
+        createPopulation(&P, seed);
         // insert seed generation (hyperparm.generation)
-        db_insert_generation(hyperparm.generation, pop, population, geneLength);
+        db_insert_generation(hyperparm.generation, P.pop, population, geneLength);
         if (use_external_eval){
             db_wait_for_generation_done(hyperparm.generation, population, poll_ms);
-            db_load_fitnesses_for_gen(hyperparm.generation, pop, population);
+            db_load_fitnesses_for_gen(hyperparm.generation, P.pop, population, geneLength);
+        } else if (use_sim){
+            evaluate_sim(P.pop, population, geneLength, hyperparm.generation, &simcfg);
         } else {
-            evaluate_sqlite(pop, fitness, population, geneLength, hyperparm.generation);
+            evaluate_sqlite(P.pop, fitness, population, geneLength, hyperparm.generation);
         }
-        savePopulation(path, pop, &hyperparm);
+        savePopulation(&g_ckpt, path, P.pop, &hyperparm, seed);
     }
 
-    printf("Training using DB='%s' (mode=%s)\n", db_path, use_external_eval ? "EXTERNAL" : "LOCAL");
+    printf("Training using DB='%s' (mode=%s)\n", db_path,
+           use_external_eval ? "EXTERNAL" : (use_sim ? "SIM" : "LOCAL"));
     printf("\tGene Length: %d\n", hyperparm.geneLength);
     printf("\tPopulation: %d\n", hyperparm.population);
     printf("\tElitism: %d\n", hyperparm.elitism);
     printf("\tGenerations: %d\n", hyperparm.generations);
     printf("\tSave Every: %d\n", hyperparm.saveEvery);
     printf("\tMutation Rate: %f\n", hyperparm.mutation);
+    printf("\tSeed: %llu\n", (unsigned long long)seed);
+    printf("\tSelection: %s\n", sel.mode == SELECT_TOURNAMENT ? "tournament" : sel.mode == SELECT_RANK ? "rank" : "elite");
 
     if (hyperparm.elitism < 3){
         printf("Elitism of %d is too low (elitism >= 3)\n", hyperparm.elitism);
+        if (g_eval.threads) evalPoolStop(&g_eval);
+        checkpointWriterStop(&g_ckpt);
         db_close();
         return 0;
     }
@@ -801,31 +1486,39 @@ int main(int argc, char **argv)
     // Start from next generation after whatever we’re at
     int start = hyperparm.generation + 1;
     for (int i = start; i <= hyperparm.generations; i++){
-        reproduce(pop, hyperparm.elitism, hyperparm.mutation, hyperparm.population, hyperparm.geneLength);
+        reproduce(&P, &sel, hyperparm.elitism, hyperparm.mutation, seed, i);
 
         // Insert the new generation
-        db_insert_generation(i, pop, hyperparm.population, hyperparm.geneLength);
+        db_insert_generation(i, P.pop, hyperparm.population, hyperparm.geneLength);
 
         if (use_external_eval){
             db_wait_for_generation_done(i, hyperparm.population, poll_ms);
-            db_load_fitnesses_for_gen(i, pop, hyperparm.population);
+            db_load_fitnesses_for_gen(i, P.pop, hyperparm.population, hyperparm.geneLength);
+        } else if (use_sim){
+            evaluate_sim(P.pop, hyperparm.population, hyperparm.geneLength, i, &simcfg);
         } else {
-            evaluate_sqlite(pop, fitness, hyperparm.population, hyperparm.geneLength, i);
+            evaluate_sqlite(P.pop, fitness, hyperparm.population, hyperparm.geneLength, i);
         }
+        db_archive_roll(i);
 
         if (i % hyperparm.saveEvery == 0){
             char buf[256];
             snprintf(buf, sizeof buf, "%s-%d", path, i);
             hyperparm.generation = i;
-            savePopulation(buf, pop, &hyperparm);
+            savePopulation(&g_ckpt, buf, P.pop, &hyperparm, seed);
         }
     }
 
+    checkpointWriterStop(&g_ckpt);
+    cache_report();
     db_close();
 
     printf("Trained through generation %d\n", hyperparm.generations);
     printf("Population:\n---------------------------------------------------------\n");
-    printPopulation(pop, hyperparm.population, hyperparm.geneLength);
+    printPopulation(P.pop, hyperparm.population, hyperparm.geneLength);
+    if (g_eval.threads) evalPoolStop(&g_eval);
+    selectionFree(&sel);
+    populationFree(&P);
     return 0;
 }
 
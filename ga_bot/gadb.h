@@ -0,0 +1,781 @@
+// SQLite access shared by the trainer and the evaluators.
+//
+// A GaDb is one connection plus every statement either side runs, each
+// prepared the first time it is used and kept until gadb_close(): the hot
+// paths (claims, results, fitness cache, polls) only reset, bind and step.
+// Transactions go through the same prepared BEGIN IMMEDIATE / COMMIT, so a
+// batch of results costs one write lock and one WAL sync instead of one per
+// row.  Evaluators claim several pending rows with one UPDATE ... RETURNING
+// in gadb_claim(), evaluate them locally and store their fitnesses together
+// with gadb_report(): two write locks per K rows instead of two per row.
+//
+// Claims are leases.  A claim records the worker and lease_until, the
+// worker's heartbeat (gadb_heartbeat(), on its own connection) pushes
+// lease_until forward while it evaluates, and the trainer puts rows whose
+// lease ran out back to pending (gadb_reclaim()), so a crashed evaluator
+// costs one lease instead of the run.  A worker that finds nothing pending
+// may also take a duplicate of the oldest claims of other workers
+// (gadb_speculate()); whichever result lands first is kept.
+//
+// Waiting is event driven: every commit appends to the WAL file, so a
+// GaDbWatch (inotify on the database's directory, Linux) wakes the trainer
+// and idle evaluators as soon as anyone commits, and they re-check with a
+// cheap read.  Their poll interval only remains as the fallback, for other
+// systems or a database not in WAL mode.
+//
+// The queue is the individuals table: a row goes from pending (status 0)
+// to claimed (1) to done (2), and every queue statement stays within one
+// partial index (see GADB_SCHEMA), so a claim, a heartbeat or a count costs
+// O(log n) however many generations the database holds.  Generations the
+// trainer is done with move to individuals_archive (gadb_archive_before()),
+// leaving only the live ones in the queue, and from there every so often
+// into generation_archive, one packed BLOB per generation (gapack.h), after
+// which the WAL is checkpointed and rewound (gadb_archive_roll(),
+// gadb_checkpoint()): the database stays the size of the live generations
+// and the WAL the size of what was written since the last roll.
+// gadb_generation_rows() reads any generation back, packed or not (the
+// trainer's --export-gen; archive_test.c checks the round trip).
+//
+// Statements come back from gadb_stmt() reset with no bindings; reset a
+// SELECT again when done with it so it does not hold its read snapshot (and
+// the WAL) while the caller sleeps.  Errors are fatal, like die_sqlite().
+#ifndef GADB_H
+#define GADB_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sqlite3.h>
+#include "chromosome.h"
+#include "gajob.h"
+#include "gapack.h"
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#define GADB_BUSY_MS 5000 // how long a write waits for another's lock
+#define GADB_WAL_LIMIT (4 << 20) // bytes a rewound WAL is cut back to
+
+// now in milliseconds since the epoch, as an SQL expression
+#define GADB_NOW_MS "CAST((julianday('now') - 2440587.5) * 86400000.0 AS INTEGER)"
+
+// columns of individuals; status 0 pending, 1 claimed, 2 done
+#define GADB_INDIVIDUALS_COLUMNS \
+    "  gen INTEGER NOT NULL," \
+    "  idx INTEGER NOT NULL," \
+    "  chromosome BLOB NOT NULL," \
+    "  gene_len INTEGER,"                          /* NULL: one byte per gene */ \
+    "  island INTEGER,"                            /* NULL: single population */ \
+    "  status INTEGER NOT NULL DEFAULT 0," \
+    "  fitness REAL," \
+    "  claimed_ts INTEGER," \
+    "  done_ts INTEGER," \
+    "  worker INTEGER,"                            /* evaluator holding the claim */ \
+    "  lease_until INTEGER,"                       /* ms, see gadb_claim() */ \
+    "  spec INTEGER NOT NULL DEFAULT 0,"           /* duplicates handed out */ \
+    "  PRIMARY KEY(gen, idx)"
+
+#define GADB_SCHEMA \
+    "CREATE TABLE IF NOT EXISTS generations (" \
+    "  gen INTEGER PRIMARY KEY," \
+    "  created_ts INTEGER NOT NULL" \
+    ");" \
+    "CREATE TABLE IF NOT EXISTS individuals (" GADB_INDIVIDUALS_COLUMNS ");" \
+    "CREATE TABLE IF NOT EXISTS individuals_archive (" /* finished generations */ \
+    "  gen INTEGER NOT NULL," \
+    "  idx INTEGER NOT NULL," \
+    "  chromosome BLOB NOT NULL," \
+    "  gene_len INTEGER," \
+    "  island INTEGER," \
+    "  fitness REAL," \
+    "  done_ts INTEGER," \
+    "  PRIMARY KEY(gen, idx)" \
+    ");" \
+    "CREATE TABLE IF NOT EXISTS generation_archive (" /* individuals_archive, packed */ \
+    "  gen INTEGER NOT NULL," \
+    "  first_idx INTEGER NOT NULL,"                /* rows of one gen archived apart */ \
+    "  count INTEGER NOT NULL," \
+    "  raw_bytes INTEGER NOT NULL,"                /* genes and fitnesses unpacked */ \
+    "  packed BLOB NOT NULL,"                      /* see gapack.h */ \
+    "  PRIMARY KEY(gen, first_idx)" \
+    ");" \
+    "CREATE TABLE IF NOT EXISTS fitness_cache ("     /* see FitnessCache in ga.c */ \
+    "  hash INTEGER NOT NULL,"                     /* geneHash() */ \
+    "  gene_len INTEGER NOT NULL," \
+    "  fitness_fn TEXT NOT NULL,"                  /* what scored it: mode and parameters */ \
+    "  count INTEGER NOT NULL," \
+    "  mean REAL NOT NULL," \
+    "  m2 REAL NOT NULL,"                          /* variance = m2 / (count - 1) */ \
+    "  PRIMARY KEY(hash, gene_len, fitness_fn)" \
+    ");" \
+    "CREATE TABLE IF NOT EXISTS run ("              /* one row, written when the run starts */ \
+    "  id INTEGER PRIMARY KEY CHECK (id = 1)," \
+    "  seed INTEGER NOT NULL"                      /* rngStream() seed, a resume keeps it */ \
+    ");"
+
+// One partial index per status, each holding only its rows: claims read the
+// pending ones in (gen, idx) order, heartbeats, reclaims and speculation the
+// claimed ones, and the trainer's counts and polls the done ones without
+// touching the table.  A query uses one of them only when its WHERE repeats
+// the index's status=N literally.
+#define GADB_INDEXES \
+    "DROP INDEX IF EXISTS idx_indiv_status;" \
+    "CREATE INDEX IF NOT EXISTS idx_indiv_pending ON individuals(gen, idx) WHERE status=0;" \
+    "CREATE INDEX IF NOT EXISTS idx_indiv_claimed ON individuals(worker) WHERE status=1;" \
+    "CREATE INDEX IF NOT EXISTS idx_indiv_done ON individuals(gen, idx, fitness) WHERE status=2;"
+
+// databases from before integer statuses, rebuilt with the current columns
+#define GADB_MIGRATE_STATUS \
+    "CREATE TABLE individuals_new (" GADB_INDIVIDUALS_COLUMNS ");" \
+    "INSERT INTO individuals_new(gen, idx, chromosome, gene_len, island, status, fitness, " \
+    "                            claimed_ts, done_ts, worker, lease_until, spec) " \
+    "SELECT gen, idx, chromosome, gene_len, island, " \
+    "       CASE status WHEN 'done' THEN 2 WHEN 'claimed' THEN 1 ELSE 0 END, fitness, " \
+    "       claimed_ts, done_ts, worker, lease_until, spec FROM individuals;" \
+    "DROP TABLE individuals;" \
+    "ALTER TABLE individuals_new RENAME TO individuals;"
+
+typedef enum {
+    GADB_BEGIN,
+    GADB_COMMIT,
+    GADB_ROLLBACK,
+    GADB_DATA_VERSION,
+    // trainer
+    GADB_GEN_INSERT,
+    GADB_INDIV_INSERT,      // pending, or done when ?5 (fitness) is given
+    GADB_ISLAND_INSERT,
+    GADB_FITNESS_UPDATE,
+    GADB_COUNT_DONE,
+    GADB_LOAD_FITNESS,
+    GADB_LOAD_POPULATION,
+    GADB_ANY_ROWS,
+    GADB_LATEST_GEN,
+    GADB_GEN_COUNTS,
+    GADB_GEN_GENE_LEN,
+    GADB_RUN_SEED,
+    GADB_RUN_INSERT,
+    GADB_CACHE_FIND,
+    GADB_CACHE_ADD,
+    GADB_STEADY_POLL,
+    GADB_RECLAIM,
+    GADB_ARCHIVE_COPY,
+    GADB_ARCHIVE_DELETE,
+    GADB_ROLL_SELECT,
+    GADB_ROLL_INSERT,
+    GADB_ROLL_DELETE,
+    GADB_GEN_ROWS,
+    GADB_GEN_PACKED,
+    // evaluators
+    GADB_ANY_PENDING,
+    GADB_CLAIM,
+    GADB_SPECULATE,
+    GADB_HEARTBEAT,
+    GADB_RELEASE,
+    GADB_REPORT,
+    GADB_STMT_COUNT
+} GaDbStmtId;
+
+static const char *const gadb_sql[GADB_STMT_COUNT] = {
+    [GADB_BEGIN] = "BEGIN IMMEDIATE;",
+    [GADB_COMMIT] = "COMMIT;",
+    [GADB_ROLLBACK] = "ROLLBACK;",
+    // changes whenever another connection commits, read without any lock held
+    [GADB_DATA_VERSION] = "PRAGMA data_version;",
+    [GADB_GEN_INSERT] =
+        "INSERT OR IGNORE INTO generations(gen, created_ts) VALUES(?, strftime('%s','now'));",
+    [GADB_INDIV_INSERT] =
+        "INSERT OR REPLACE INTO individuals(gen, idx, chromosome, gene_len, status, fitness, done_ts) "
+        "VALUES(?1, ?2, ?3, ?4, CASE WHEN ?5 IS NULL THEN 0 ELSE 2 END, ?5, "
+        "       CASE WHEN ?5 IS NULL THEN NULL ELSE strftime('%s','now') END);",
+    [GADB_ISLAND_INSERT] =
+        "INSERT OR REPLACE INTO individuals(gen, idx, chromosome, gene_len, island, status, fitness, done_ts) "
+        "VALUES(?, ?, ?, ?, ?, 2, ?, strftime('%s','now'));",
+    [GADB_FITNESS_UPDATE] =
+        "UPDATE individuals SET status=2, fitness=?, done_ts=strftime('%s','now') "
+        "WHERE gen=? AND idx=?;",
+    [GADB_COUNT_DONE] =
+        "SELECT COUNT(*) FROM individuals WHERE gen=? AND status=2;",
+    [GADB_LOAD_FITNESS] =
+        "SELECT idx, fitness FROM individuals WHERE gen=? AND status=2 ORDER BY idx;",
+    [GADB_LOAD_POPULATION] =
+        "SELECT idx, chromosome, fitness, gene_len FROM individuals WHERE gen=? ORDER BY idx;",
+    [GADB_ANY_ROWS] = "SELECT 1 FROM individuals LIMIT 1;",
+    [GADB_LATEST_GEN] = "SELECT MAX(gen) FROM individuals;",
+    [GADB_GEN_COUNTS] =
+        "SELECT COUNT(*), SUM(status=2) FROM individuals WHERE gen=?;",
+    // old rows stored one byte per gene
+    [GADB_GEN_GENE_LEN] =
+        "SELECT COALESCE(gene_len, LENGTH(chromosome)) FROM individuals WHERE gen=? ORDER BY idx LIMIT 1;",
+    [GADB_RUN_SEED] = "SELECT seed FROM run WHERE id=1;",
+    [GADB_RUN_INSERT] = "INSERT OR IGNORE INTO run(id, seed) VALUES(1, ?);",
+    [GADB_CACHE_FIND] =
+        "SELECT count, mean FROM fitness_cache WHERE hash=? AND gene_len=? AND fitness_fn=?;",
+    // Welford: every right-hand side sees the old count and mean
+    [GADB_CACHE_ADD] =
+        "INSERT INTO fitness_cache(hash, gene_len, fitness_fn, count, mean, m2) VALUES(?1, ?2, ?4, 1, ?3, 0) "
+        "ON CONFLICT(hash, gene_len, fitness_fn) DO UPDATE SET "
+        "  count = count + 1,"
+        "  mean = mean + (?3 - mean) / (count + 1),"
+        "  m2 = m2 + (?3 - mean) * (?3 - (mean + (?3 - mean) / (count + 1))) "
+        "RETURNING mean;",
+    [GADB_STEADY_POLL] =
+        "SELECT gen, idx, fitness FROM individuals "
+        "WHERE gen >= ?1 AND status=2 AND (gen - ?2) * ?3 + idx >= ?4;",
+    // expired leases back to pending; claims without one (older evaluators) last ?1 ms
+    [GADB_RECLAIM] =
+        "UPDATE individuals SET status=0, worker=NULL, lease_until=NULL, spec=0 "
+        "WHERE status=1 AND COALESCE(lease_until, claimed_ts * 1000 + ?1) < " GADB_NOW_MS ";",
+    // the done rows of generations before ?1 move to the archive, pending and claimed ones stay
+    [GADB_ARCHIVE_COPY] =
+        "INSERT OR REPLACE INTO individuals_archive(gen, idx, chromosome, gene_len, island, fitness, done_ts) "
+        "SELECT gen, idx, chromosome, gene_len, island, fitness, done_ts FROM individuals "
+        "WHERE gen < ?1 AND status=2;",
+    [GADB_ARCHIVE_DELETE] = "DELETE FROM individuals WHERE gen < ?1 AND status=2;",
+    [GADB_ROLL_SELECT] =
+        "SELECT gen, idx, chromosome, gene_len, island, fitness, done_ts FROM individuals_archive "
+        "WHERE gen < ?1 ORDER BY gen, idx;",
+    [GADB_ROLL_INSERT] =
+        "INSERT OR REPLACE INTO generation_archive(gen, first_idx, count, raw_bytes, packed) "
+        "VALUES(?, ?, ?, ?, ?);",
+    [GADB_ROLL_DELETE] = "DELETE FROM individuals_archive WHERE gen < ?1;",
+    // a generation's rows not packed yet, wherever they are
+    [GADB_GEN_ROWS] =
+        "SELECT idx, chromosome, gene_len, island, fitness, done_ts FROM individuals WHERE gen=?1 "
+        "UNION ALL SELECT idx, chromosome, gene_len, island, fitness, done_ts FROM individuals_archive WHERE gen=?1 "
+        "ORDER BY idx;",
+    [GADB_GEN_PACKED] = "SELECT packed FROM generation_archive WHERE gen=? ORDER BY first_idx;",
+    [GADB_ANY_PENDING] = "SELECT 1 FROM individuals WHERE status=0 LIMIT 1;",
+    // the oldest ?1 pending rows, leased to worker ?2 for ?3 ms and returned by one statement
+    [GADB_CLAIM] =
+        "UPDATE individuals SET status=1, claimed_ts=strftime('%s','now'), "
+        "  worker=?2, lease_until=" GADB_NOW_MS " + ?3, spec=0 "
+        "WHERE rowid IN (SELECT rowid FROM individuals WHERE status=0 "
+        "                ORDER BY gen ASC, idx ASC LIMIT ?1) "
+        "RETURNING gen, idx, chromosome, gene_len;",
+    // duplicates of up to ?1 rows other workers have held for ?3 s or more, each handed out once
+    [GADB_SPECULATE] =
+        "UPDATE individuals SET spec=spec+1 "
+        "WHERE rowid IN (SELECT rowid FROM individuals WHERE status=1 AND spec=0 "
+        "                AND worker IS NOT ?2 AND claimed_ts <= strftime('%s','now') - ?3 "
+        "                ORDER BY claimed_ts ASC, gen ASC, idx ASC LIMIT ?1) "
+        "RETURNING gen, idx, chromosome, gene_len;",
+    [GADB_HEARTBEAT] =
+        "UPDATE individuals SET lease_until=" GADB_NOW_MS " + ?2 "
+        "WHERE worker=?1 AND status=1;",
+    [GADB_RELEASE] =
+        "UPDATE individuals SET status=0, worker=NULL, lease_until=NULL, spec=0 "
+        "WHERE worker=?1 AND status=1;",
+    // the first result for a row wins, whether its lease expired or it was duplicated
+    [GADB_REPORT] =
+        "UPDATE individuals SET status=2, fitness=?, done_ts=strftime('%s','now') "
+        "WHERE gen=? AND idx=? AND status!=2;",
+};
+
+typedef struct {
+    sqlite3 *db;
+    sqlite3_stmt *st[GADB_STMT_COUNT];
+} GaDb;
+
+static inline void gadb_die(GaDb *g, const char *msg, int rc) {
+    fprintf(stderr, "SQLite error: %s: %s (rc=%d)\n", msg, g->db ? sqlite3_errmsg(g->db) : "no connection", rc);
+    exit(1);
+}
+
+// WAL, synchronous=NORMAL, and a busy timeout since trainer and evaluators write at once
+static inline int gadb_open(GaDb *g, const char *path) {
+    memset(g, 0, sizeof *g);
+    int rc = sqlite3_open(path, &g->db);
+    if (rc != SQLITE_OK) return rc;
+    sqlite3_exec(g->db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
+    sqlite3_exec(g->db, "PRAGMA synchronous=NORMAL;", NULL, NULL, NULL);
+    char sql[64];
+    snprintf(sql, sizeof sql, "PRAGMA journal_size_limit=%d;", GADB_WAL_LIMIT);
+    sqlite3_exec(g->db, sql, NULL, NULL, NULL);
+    sqlite3_busy_timeout(g->db, GADB_BUSY_MS);
+    return SQLITE_OK;
+}
+
+static inline void gadb_close(GaDb *g) {
+    for (int i = 0; i < GADB_STMT_COUNT; ++i) {
+        if (g->st[i]) sqlite3_finalize(g->st[i]);
+        g->st[i] = NULL;
+    }
+    if (g->db) sqlite3_close(g->db);
+    g->db = NULL;
+}
+
+// 1 when table has a column name
+static inline int gadb_has_column(GaDb *g, const char *table, const char *name) {
+    sqlite3_stmt *st = NULL;
+    int has = 0;
+    int rc = sqlite3_prepare_v2(g->db, "SELECT 1 FROM pragma_table_info(?) WHERE name=?;", -1, &st, NULL);
+    if (rc != SQLITE_OK) gadb_die(g, "prepare table_info failed", rc);
+    sqlite3_bind_text(st, 1, table, -1, SQLITE_STATIC);
+    sqlite3_bind_text(st, 2, name, -1, SQLITE_STATIC);
+    if (sqlite3_step(st) == SQLITE_ROW) has = 1;
+    sqlite3_finalize(st);
+    return has;
+}
+
+// ALTER TABLE individuals ADD COLUMN, unless it is there already
+static inline void gadb_add_column(GaDb *g, const char *name, const char *type) {
+    if (!gadb_has_column(g, "individuals", name)) {
+        char sql[128];
+        snprintf(sql, sizeof sql, "ALTER TABLE individuals ADD COLUMN %s %s;", name, type);
+        int rc = sqlite3_exec(g->db, sql, NULL, NULL, NULL);
+        if (rc != SQLITE_OK) gadb_die(g, "add column failed", rc);
+    }
+}
+
+// statement id, prepared on first use, reset and without bindings
+static inline sqlite3_stmt *gadb_stmt(GaDb *g, GaDbStmtId id) {
+    sqlite3_stmt *st = g->st[id];
+    if (!st) {
+        int rc = sqlite3_prepare_v3(g->db, gadb_sql[id], -1, SQLITE_PREPARE_PERSISTENT, &st, NULL);
+        if (rc != SQLITE_OK) gadb_die(g, "prepare failed", rc);
+        g->st[id] = st;
+    } else {
+        sqlite3_reset(st);
+        sqlite3_clear_bindings(st);
+    }
+    return st;
+}
+
+// steps a statement that returns no rows and resets it
+static inline void gadb_exec(GaDb *g, sqlite3_stmt *st, const char *what) {
+    int rc = sqlite3_step(st);
+    sqlite3_reset(st);
+    if (rc != SQLITE_DONE) gadb_die(g, what, rc);
+}
+
+static inline void gadb_begin(GaDb *g) {
+    gadb_exec(g, gadb_stmt(g, GADB_BEGIN), "BEGIN failed");
+}
+
+static inline void gadb_commit(GaDb *g) {
+    gadb_exec(g, gadb_stmt(g, GADB_COMMIT), "COMMIT failed");
+}
+
+static inline void gadb_rollback(GaDb *g) {
+    sqlite3_stmt *st = gadb_stmt(g, GADB_ROLLBACK);
+    sqlite3_step(st);
+    sqlite3_reset(st);
+}
+
+// Steps a claiming UPDATE ... RETURNING and unpacks its rows into jobs[0..k).
+// The UPDATE marks them all in its own (autocommit) write transaction,
+// which ends when the statement is reset after the last row.  Returns how
+// many, 0 when there were none or the write lock stayed busy.
+static inline int gadb_take(GaDb *g, sqlite3_stmt *st, GaJob *jobs, int k) {
+    int n = 0, rc;
+    while ((rc = sqlite3_step(st)) == SQLITE_ROW) {
+        if (n == k) continue; // cannot happen, LIMIT k
+        GaJob *j = &jobs[n++];
+        j->gen = sqlite3_column_int(st, 0);
+        j->idx = sqlite3_column_int(st, 1);
+        const void *blob = sqlite3_column_blob(st, 2);
+        int blen = sqlite3_column_bytes(st, 2);
+        // gene_len is NULL for rows written one byte per gene
+        int packed = sqlite3_column_type(st, 3) != SQLITE_NULL;
+        ga_job_unpack(j, packed ? sqlite3_column_int(st, 3) : blen, blob, blen, packed);
+    }
+    sqlite3_reset(st);
+    if (rc == SQLITE_BUSY) return 0; // nothing was claimed, try again later
+    if (rc != SQLITE_DONE) gadb_die(g, "claim failed", rc);
+    return n;
+}
+
+// Leases up to k pending rows, oldest first, to worker for lease_ms
+static inline int gadb_claim(GaDb *g, GaJob *jobs, int k, sqlite3_int64 worker, int lease_ms) {
+    if (k <= 0) return 0;
+    sqlite3_stmt *st = gadb_stmt(g, GADB_CLAIM);
+    sqlite3_bind_int(st, 1, k);
+    sqlite3_bind_int64(st, 2, worker);
+    sqlite3_bind_int(st, 3, lease_ms);
+    return gadb_take(g, st, jobs, k);
+}
+
+// Duplicates of up to k rows other workers have held for after_s seconds,
+// the stragglers at the end of a generation; each row is duplicated once
+static inline int gadb_speculate(GaDb *g, GaJob *jobs, int k, sqlite3_int64 worker, int after_s) {
+    if (k <= 0) return 0;
+    sqlite3_stmt *st = gadb_stmt(g, GADB_SPECULATE);
+    sqlite3_bind_int(st, 1, k);
+    sqlite3_bind_int64(st, 2, worker);
+    sqlite3_bind_int(st, 3, after_s);
+    return gadb_take(g, st, jobs, k);
+}
+
+// extends the leases of everything worker holds to lease_ms from now, 0 or the SQLite error
+static inline int gadb_heartbeat(GaDb *g, sqlite3_int64 worker, int lease_ms) {
+    sqlite3_stmt *st = gadb_stmt(g, GADB_HEARTBEAT);
+    sqlite3_bind_int64(st, 1, worker);
+    sqlite3_bind_int(st, 2, lease_ms);
+    int rc = sqlite3_step(st);
+    sqlite3_reset(st);
+    return rc == SQLITE_DONE ? 0 : rc;
+}
+
+// Puts claims whose lease expired back to pending, returns how many.
+// Claims without a lease expire lease_ms after claimed_ts.
+static inline int gadb_reclaim(GaDb *g, int lease_ms) {
+    sqlite3_stmt *st = gadb_stmt(g, GADB_RECLAIM);
+    sqlite3_bind_int(st, 1, lease_ms);
+    int rc = sqlite3_step(st);
+    sqlite3_reset(st);
+    if (rc == SQLITE_BUSY) return 0; // next time
+    if (rc != SQLITE_DONE) gadb_die(g, "reclaim failed", rc);
+    return sqlite3_changes(g->db);
+}
+
+// 1 when some row waits for an evaluator, a read only
+static inline int gadb_any_pending(GaDb *g) {
+    sqlite3_stmt *st = gadb_stmt(g, GADB_ANY_PENDING);
+    int any = sqlite3_step(st) == SQLITE_ROW;
+    sqlite3_reset(st);
+    return any;
+}
+
+// stores the fitness of row (gen, idx) and marks it done, within the caller's transaction
+static inline void gadb_store_result(GaDb *g, int gen, int idx, double fitness) {
+    sqlite3_stmt *st = gadb_stmt(g, GADB_REPORT);
+    sqlite3_bind_double(st, 1, fitness);
+    sqlite3_bind_int(st, 2, gen);
+    sqlite3_bind_int(st, 3, idx);
+    int rc = sqlite3_step(st);
+    sqlite3_reset(st);
+    if (rc != SQLITE_DONE) { gadb_rollback(g); gadb_die(g, "report failed", rc); }
+}
+
+// stores the fitness of jobs[0..n) and marks them done, one transaction
+static inline void gadb_report(GaDb *g, const GaJob *jobs, int n) {
+    if (n <= 0) return;
+    gadb_begin(g);
+    for (int i = 0; i < n; ++i) gadb_store_result(g, jobs[i].gen, jobs[i].idx, (double)jobs[i].chrom.fitness);
+    gadb_commit(g);
+}
+
+// gives back to pending every row worker still holds, when it shuts down
+static inline void gadb_release(GaDb *g, sqlite3_int64 worker) {
+    sqlite3_stmt *st = gadb_stmt(g, GADB_RELEASE);
+    sqlite3_bind_int64(st, 1, worker);
+    gadb_exec(g, st, "release failed");
+}
+
+// Creates the tables and indexes, or brings those of an older database up to
+// date, in one write transaction: whoever starts first, trainer or evaluator,
+// does it and the others find it done
+static inline void gadb_init_schema(GaDb *g) {
+    gadb_begin(g);
+    int rc = sqlite3_exec(g->db, GADB_SCHEMA, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) { gadb_rollback(g); gadb_die(g, "init schema failed", rc); }
+
+    // DBs from before packed chromosomes have no gene_len, their rows keep NULL
+    gadb_add_column(g, "gene_len", "INTEGER");
+    // nor an island, NULL for rows of a single-population run
+    gadb_add_column(g, "island", "INTEGER");
+    // nor leases
+    gadb_add_column(g, "worker", "INTEGER");
+    gadb_add_column(g, "lease_until", "INTEGER");
+    gadb_add_column(g, "spec", "INTEGER NOT NULL DEFAULT 0");
+    // a fitness cache that does not say what scored its entries cannot be
+    // trusted by any fitness function: start it over
+    if (!gadb_has_column(g, "fitness_cache", "fitness_fn")) {
+        rc = sqlite3_exec(g->db, "DROP TABLE fitness_cache;", NULL, NULL, NULL);
+        if (rc == SQLITE_OK) rc = sqlite3_exec(g->db, GADB_SCHEMA, NULL, NULL, NULL);
+        if (rc != SQLITE_OK) { gadb_rollback(g); gadb_die(g, "fitness cache migration failed", rc); }
+    }
+
+    // nor integer statuses
+    sqlite3_stmt *st = NULL;
+    int text = 0;
+    rc = sqlite3_prepare_v2(g->db,
+        "SELECT 1 FROM pragma_table_info('individuals') WHERE name='status' AND type='TEXT';", -1, &st, NULL);
+    if (rc != SQLITE_OK) gadb_die(g, "prepare table_info failed", rc);
+    if (sqlite3_step(st) == SQLITE_ROW) text = 1;
+    sqlite3_finalize(st);
+    if (text) {
+        rc = sqlite3_exec(g->db, GADB_MIGRATE_STATUS, NULL, NULL, NULL);
+        if (rc != SQLITE_OK) { gadb_rollback(g); gadb_die(g, "status migration failed", rc); }
+    }
+
+    rc = sqlite3_exec(g->db, GADB_INDEXES, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) { gadb_rollback(g); gadb_die(g, "create indexes failed", rc); }
+    gadb_commit(g);
+}
+
+// Moves the done rows of every generation before gen to individuals_archive,
+// within the caller's transaction; returns how many
+static inline int gadb_archive_before(GaDb *g, int gen) {
+    sqlite3_stmt *st = gadb_stmt(g, GADB_ARCHIVE_COPY);
+    sqlite3_bind_int(st, 1, gen);
+    gadb_exec(g, st, "archive copy failed");
+    st = gadb_stmt(g, GADB_ARCHIVE_DELETE);
+    sqlite3_bind_int(st, 1, gen);
+    gadb_exec(g, st, "archive delete failed");
+    return sqlite3_changes(g->db);
+}
+
+// what gadb_archive_roll() packed so far
+typedef struct {
+    long gens;               // BLOBs written
+    long rows;
+    long long raw;           // bytes of genes and fitnesses
+    long long packed;        // bytes of BLOBs
+} GaDbArchived;
+
+// Writes p, the packed rows of gen from first_idx on, to generation_archive
+// after reading it back whole, so a row only leaves individuals_archive in a
+// BLOB that decodes
+static inline void gadb_archive_chunk(GaDb *g, GaPack *p, int gen, int first_idx, GaDbArchived *a) {
+    ga_pack_finish(p);
+    GaPackReader r;
+    GaPackRow row;
+    uint32_t n = 0;
+    int rc = p->len ? ga_pack_open(&r, p->buf, p->len) : -1;
+    if (rc == 0) {
+        while ((rc = ga_pack_next(&r, &row)) == 1) n++;
+        ga_pack_close(&r);
+    }
+    if (rc != 0 || n != p->count) {
+        gadb_rollback(g);
+        fprintf(stderr, "generation %d did not pack, nothing archived\n", gen);
+        exit(1);
+    }
+    sqlite3_stmt *st = gadb_stmt(g, GADB_ROLL_INSERT);
+    sqlite3_bind_int(st, 1, gen);
+    sqlite3_bind_int(st, 2, first_idx);
+    sqlite3_bind_int(st, 3, (int)p->count);
+    sqlite3_bind_int64(st, 4, (sqlite3_int64)p->raw);
+    sqlite3_bind_blob(st, 5, p->buf, (int)p->len, SQLITE_STATIC);
+    int step = sqlite3_step(st);
+    sqlite3_reset(st);
+    if (step != SQLITE_DONE) { gadb_rollback(g); gadb_die(g, "archive insert failed", step); }
+    a->gens++;
+    a->rows += p->count;
+    a->raw += (long long)p->raw;
+    a->packed += (long long)p->len;
+}
+
+// Packs the rows of individuals_archive before gen into generation_archive,
+// one BLOB per generation, and deletes them, in one transaction; adds to *a
+static inline void gadb_archive_roll(GaDb *g, int gen, GaDbArchived *a) {
+    GaPack p = {0};
+    int cur = 0, first = 0, rc;
+    gadb_begin(g);
+    sqlite3_stmt *st = gadb_stmt(g, GADB_ROLL_SELECT);
+    sqlite3_bind_int(st, 1, gen);
+    while ((rc = sqlite3_step(st)) == SQLITE_ROW) {
+        int rgen = sqlite3_column_int(st, 0);
+        GaPackRow row = {
+            .idx = sqlite3_column_int(st, 1),
+            .gene_len = sqlite3_column_type(st, 3) == SQLITE_NULL ? -1 : sqlite3_column_int(st, 3),
+            .island = sqlite3_column_type(st, 4) == SQLITE_NULL ? -1 : sqlite3_column_int(st, 4),
+            .has_fitness = sqlite3_column_type(st, 5) != SQLITE_NULL,
+            .fitness = sqlite3_column_double(st, 5),
+            .has_done_ts = sqlite3_column_type(st, 6) != SQLITE_NULL,
+            .done_ts = sqlite3_column_int64(st, 6),
+        };
+        row.genes = sqlite3_column_blob(st, 2);
+        row.bytes = sqlite3_column_bytes(st, 2);
+        if (p.count > 0 && rgen != cur) gadb_archive_chunk(g, &p, cur, first, a);
+        if (p.count == 0 || rgen != cur) {
+            ga_pack_begin(&p);
+            cur = rgen;
+            first = row.idx;
+        }
+        if (ga_pack_add(&p, &row) != 0) { fprintf(stderr, "out of memory\n"); exit(1); }
+    }
+    sqlite3_reset(st);
+    if (rc != SQLITE_DONE) { gadb_rollback(g); gadb_die(g, "archive select failed", rc); }
+    if (p.count > 0) gadb_archive_chunk(g, &p, cur, first, a);
+    ga_pack_free(&p);
+
+    st = gadb_stmt(g, GADB_ROLL_DELETE);
+    sqlite3_bind_int(st, 1, gen);
+    gadb_exec(g, st, "archive delete failed");
+    gadb_commit(g);
+}
+
+// Calls fn(ctx, row) for every row of generation gen, from the queue and
+// individuals_archive first, then unpacked from generation_archive, each in
+// idx order; row->genes is valid during the call only.  Returns the rows
+// seen, -1 when a packed BLOB does not decode.
+static inline long gadb_generation_rows(GaDb *g, int gen, void (*fn)(void *ctx, const GaPackRow *row), void *ctx) {
+    long n = 0;
+    int rc;
+    sqlite3_stmt *st = gadb_stmt(g, GADB_GEN_ROWS);
+    sqlite3_bind_int(st, 1, gen);
+    while ((rc = sqlite3_step(st)) == SQLITE_ROW) {
+        GaPackRow row = {
+            .idx = sqlite3_column_int(st, 0),
+            .gene_len = sqlite3_column_type(st, 2) == SQLITE_NULL ? -1 : sqlite3_column_int(st, 2),
+            .island = sqlite3_column_type(st, 3) == SQLITE_NULL ? -1 : sqlite3_column_int(st, 3),
+            .has_fitness = sqlite3_column_type(st, 4) != SQLITE_NULL,
+            .fitness = sqlite3_column_double(st, 4),
+            .has_done_ts = sqlite3_column_type(st, 5) != SQLITE_NULL,
+            .done_ts = sqlite3_column_int64(st, 5),
+        };
+        row.genes = sqlite3_column_blob(st, 1);
+        row.bytes = sqlite3_column_bytes(st, 1);
+        fn(ctx, &row);
+        n++;
+    }
+    sqlite3_reset(st);
+    if (rc != SQLITE_DONE) gadb_die(g, "generation rows failed", rc);
+
+    st = gadb_stmt(g, GADB_GEN_PACKED);
+    sqlite3_bind_int(st, 1, gen);
+    while ((rc = sqlite3_step(st)) == SQLITE_ROW) {
+        GaPackReader r;
+        GaPackRow row;
+        int got = ga_pack_open(&r, sqlite3_column_blob(st, 0), (size_t)sqlite3_column_bytes(st, 0));
+        while (got == 0 && (got = ga_pack_next(&r, &row)) == 1) {
+            fn(ctx, &row);
+            n++;
+            got = 0;
+        }
+        ga_pack_close(&r);
+        if (got != 0) {
+            sqlite3_reset(st);
+            return -1;
+        }
+    }
+    sqlite3_reset(st);
+    if (rc != SQLITE_DONE) gadb_die(g, "generation archive read failed", rc);
+    return n;
+}
+
+// Copies the WAL into the database and, waiting at most wait_ms for readers
+// to move on, rewinds it (SQLITE_CHECKPOINT_RESTART: the next commit writes
+// from its start, cutting it back to GADB_WAL_LIMIT) or truncates it to
+// nothing (SQLITE_CHECKPOINT_TRUNCATE).  Truncate only when done writing:
+// a WAL grown again from nothing makes every commit extend the file, which
+// doubled the time of a run truncating every 10 generations.  0, or
+// SQLITE_BUSY when readers stayed; the next call finishes the job.
+static inline int gadb_checkpoint(GaDb *g, int mode, int wait_ms) {
+    sqlite3_busy_timeout(g->db, wait_ms);
+    int rc = sqlite3_wal_checkpoint_v2(g->db, NULL, mode, NULL, NULL);
+    sqlite3_busy_timeout(g->db, GADB_BUSY_MS);
+    if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) return SQLITE_BUSY;
+    if (rc != SQLITE_OK) gadb_die(g, "checkpoint failed", rc);
+    return 0;
+}
+
+// ---------- Change notification ----------
+typedef struct {
+    int fd;                  // inotify descriptor, -1: poll only
+    char wal[256];           // name of the WAL file within its directory
+    sqlite3_int64 version;   // data_version at the last commit seen, see gadb_wait_commit()
+} GaDbWatch;
+
+static inline long gadb_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Watches for commits to the database at path.  The directory is watched
+// rather than the WAL itself, which may not exist yet and is recreated.
+static inline void gadb_watch_open(GaDbWatch *w, const char *path) {
+    w->fd = -1;
+    w->wal[0] = 0;
+    w->version = 0;
+#ifdef __linux__
+    char dir[1024];
+    const char *slash = strrchr(path, '/');
+    if (slash) snprintf(dir, sizeof dir, "%.*s", (int)(slash - path) + 1, path);
+    else snprintf(dir, sizeof dir, ".");
+    snprintf(w->wal, sizeof w->wal, "%s-wal", slash ? slash + 1 : path);
+    w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (w->fd >= 0 && inotify_add_watch(w->fd, dir, IN_MODIFY | IN_CREATE) < 0) {
+        close(w->fd);
+        w->fd = -1;
+    }
+#endif
+}
+
+static inline void gadb_watch_close(GaDbWatch *w) {
+#ifdef __linux__
+    if (w->fd >= 0) close(w->fd);
+#endif
+    w->fd = -1;
+}
+
+// Reads the pending events of w->fd, 1 when one was a commit; other
+// files of the directory do not count.  For callers polling w->fd themselves.
+static inline int gadb_watch_drain(GaDbWatch *w) {
+    int hit = 0;
+#ifdef __linux__
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while (w->fd >= 0 && (len = read(w->fd, buf, sizeof buf)) > 0) {
+        for (char *e = buf; e < buf + len; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)e;
+            if (ev->len && strcmp(ev->name, w->wal) == 0) hit = 1;
+            e += sizeof *ev + ev->len;
+        }
+    }
+#endif
+    return hit;
+}
+
+// Sleeps until someone commits to the database or timeout_ms pass, 1 on a commit
+static inline int gadb_watch_wait(GaDbWatch *w, int timeout_ms) {
+#ifdef __linux__
+    if (w->fd >= 0) {
+        long deadline = gadb_now_ms() + timeout_ms;
+        for (;;) {
+            long left = deadline - gadb_now_ms();
+            if (left < 0) left = 0;
+            struct pollfd p = { w->fd, POLLIN, 0 };
+            if (poll(&p, 1, (int)left) <= 0) return 0;
+            if (gadb_watch_drain(w)) return 1;
+        }
+    }
+#endif
+    struct timespec ts = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+    return 0;
+}
+
+// data_version of g, -1 when it could not be read (SQLITE_BUSY): try again later
+static inline sqlite3_int64 gadb_data_version(GaDb *g) {
+    sqlite3_stmt *st = gadb_stmt(g, GADB_DATA_VERSION);
+    sqlite3_int64 v = sqlite3_step(st) == SQLITE_ROW ? sqlite3_column_int64(st, 0) : -1;
+    sqlite3_reset(st);
+    return v;
+}
+
+// 1 when another connection committed to g since the last call
+static inline int gadb_changed(GaDb *g, GaDbWatch *w) {
+    sqlite3_int64 v = gadb_data_version(g);
+    if (v < 0 || v == w->version) return 0;
+    w->version = v;
+    return 1;
+}
+
+// gadb_watch_wait() for a caller that reads g next: 1 once another
+// connection's commit is visible, 0 after timeout_ms.  A commit's WAL writes
+// wake us before it is published (the wal-index is updated after them, which
+// makes no event), so a wake is checked against data_version a few times
+// over a millisecond or two; a wake that brings nothing (our own commit, a
+// checkpoint) goes back to waiting.  Only reads, no lock is taken.
+static inline int gadb_wait_commit(GaDb *g, GaDbWatch *w, int timeout_ms) {
+    long deadline = gadb_now_ms() + timeout_ms;
+    for (;;) {
+        if (gadb_changed(g, w)) return 1;
+        long left = deadline - gadb_now_ms();
+        if (left <= 0 || !gadb_watch_wait(w, (int)left)) return gadb_changed(g, w);
+        for (long ns = 100000; ns <= 800000; ns *= 2) {
+            if (gadb_changed(g, w)) return 1;
+            struct timespec ts = { 0, ns };
+            nanosleep(&ts, NULL);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,43 @@
+// One chromosome handed to an evaluator, claimed from the database (gadb.h)
+// or from the coordinator (coord.h): where it goes back to, its genes, and
+// after evaluation its fitness.
+#ifndef GAJOB_H
+#define GAJOB_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "chromosome.h"
+
+typedef struct {
+    int gen;
+    int idx;
+    int geneLength;
+    int words;               // capacity of chrom.genes
+    unsigned token;          // the coordinator's handle, echoed in the report
+    Chromosome chrom;        // fitness is what gets reported
+} GaJob;
+
+// Unpacks blen bytes of genes into j, bit-packed (genePack()) or one byte per gene,
+// growing j's buffer as needed
+static inline void ga_job_unpack(GaJob *j, int geneLength, const void *blob, int blen, int packed) {
+    if (GENE_WORDS(geneLength) > j->words) {
+        gene_word_t *genes = realloc(j->chrom.genes, (size_t)GENE_WORDS(geneLength) * sizeof(gene_word_t));
+        if (!genes) { fprintf(stderr, "out of memory\n"); exit(1); }
+        j->chrom.genes = genes;
+        j->words = GENE_WORDS(geneLength);
+    }
+    j->geneLength = geneLength;
+    if (packed) geneUnpack(&j->chrom, geneLength, blob, blen);
+    else geneUnpackBytes(&j->chrom, geneLength, blob, blen);
+    j->chrom.fitness = 0;
+}
+
+static inline void ga_jobs_free(GaJob *jobs, int n) {
+    for (int i = 0; i < n; ++i) {
+        free(jobs[i].chrom.genes);
+        jobs[i].chrom.genes = NULL;
+        jobs[i].words = 0;
+    }
+}
+
+#endif
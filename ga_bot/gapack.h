@@ -0,0 +1,382 @@
+// Packed generations: the rows of a finished generation as one BLOB, for
+// the generation_archive table (see gadb_archive_roll() in gadb.h).
+//
+// Children of one generation share most of their genes with their parents
+// and so with each other, so each row's genes are stored XORed with the
+// closest of the GA_PACK_REFS rows before it and the zero bytes that leaves
+// are run-length coded.  What the row repeats from the one before (the
+// next idx, its gene length and island, its done_ts) is a flag; the rest
+// are LEB128 varints.  No dependency beyond checkpoint.h's CRC.
+//
+// Layout, host byte order like the checkpoints:
+//   GaPackHeader
+//   count rows, each:
+//     byte    flags: ref (0..GA_PACK_REFS) | GA_PACK_NEXT_IDX | GA_PACK_SAME_SHAPE | ...
+//     varint  idx - previous idx - 1 (the first: idx), unless GA_PACK_NEXT_IDX
+//     varint  gene_len + 1 (0: NULL, one byte per gene), bytes of genes and island + 1
+//             (0: NULL), unless GA_PACK_SAME_SHAPE
+//     fitness a varint zigzag(fitness); with GA_PACK_RAW_FITNESS a byte, 0 for NULL or 1
+//             and the double
+//     varint  done_ts: 0 NULL, n >= 1 zigzag(n - 1) from the previous row's, unless GA_PACK_SAME_TS
+//     genes   XORed with the genes ref rows back (ref 0: as they are), as runs: a byte
+//             t < 128 and t + 1 literal bytes, or t >= 128 for t - 127 zero bytes
+#ifndef GAPACK_H
+#define GAPACK_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checkpoint.h"
+
+#define GA_PACK_MAGIC 0x4b504147u /* "GAPK" */
+#define GA_PACK_VERSION 1
+#define GA_PACK_REFS 8            /* rows back a row may be XORed with */
+
+// row flags, above the ref in the low bits
+#define GA_PACK_NEXT_IDX 0x10     /* idx is the previous one + 1 */
+#define GA_PACK_SAME_SHAPE 0x20   /* gene_len, bytes and island as the previous row */
+#define GA_PACK_SAME_TS 0x40      /* done_ts as the previous row, NULL included */
+#define GA_PACK_RAW_FITNESS 0x80  /* fitness NULL or not an integer */
+
+_Static_assert(GA_PACK_REFS < GA_PACK_NEXT_IDX, "the ref fits below the flags");
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t count;          // rows
+    uint32_t crc;            // CRC-32 of the rows that follow
+} GaPackHeader;
+
+typedef struct {
+    int idx;
+    int gene_len;            // -1: NULL
+    int island;              // -1: NULL
+    int has_fitness;
+    double fitness;
+    int has_done_ts;
+    int64_t done_ts;
+    const unsigned char *genes;
+    int bytes;
+} GaPackRow;
+
+// the last GA_PACK_REFS rows' genes, writer and reader keep the same
+typedef struct {
+    unsigned char *genes[GA_PACK_REFS];
+    int bytes[GA_PACK_REFS];
+    int cap[GA_PACK_REFS];
+    int n, next;
+} GaPackRing;
+
+typedef struct {
+    unsigned char *buf;      // header and rows
+    size_t len, cap;
+    uint32_t count;
+    GaPackRow prev;          // fields of the row before, genes aside
+    size_t raw;              // genes and fitness as stored in rows
+    GaPackRing ring;
+    unsigned char *xor;      // scratch
+    int xor_cap;
+} GaPack;
+
+typedef struct {
+    const unsigned char *p, *end;
+    uint32_t left, read;
+    GaPackRow prev;
+    GaPackRing ring;
+    unsigned char *genes;    // the row just read
+    int genes_cap;
+} GaPackReader;
+
+// ---------- Ring ----------
+// genes r rows back (1..ring->n)
+static inline const unsigned char *ga_pack_ring_get(const GaPackRing *ring, int r, int *bytes) {
+    int k = (ring->next - r + GA_PACK_REFS) % GA_PACK_REFS;
+    *bytes = ring->bytes[k];
+    return ring->genes[k];
+}
+
+static inline int ga_pack_ring_push(GaPackRing *ring, const unsigned char *genes, int bytes) {
+    int k = ring->next;
+    if (bytes > ring->cap[k]) {
+        unsigned char *g = realloc(ring->genes[k], (size_t)bytes);
+        if (!g) return -1;
+        ring->genes[k] = g;
+        ring->cap[k] = bytes;
+    }
+    memcpy(ring->genes[k], genes, (size_t)bytes);
+    ring->bytes[k] = bytes;
+    ring->next = (k + 1) % GA_PACK_REFS;
+    if (ring->n < GA_PACK_REFS) ring->n++;
+    return 0;
+}
+
+static inline void ga_pack_ring_free(GaPackRing *ring) {
+    for (int k = 0; k < GA_PACK_REFS; ++k) free(ring->genes[k]);
+    memset(ring, 0, sizeof *ring);
+}
+
+// ---------- Writer ----------
+static inline int ga_pack_reserve(GaPack *p, size_t more) {
+    if (p->len + more <= p->cap) return 0;
+    size_t cap = p->cap ? p->cap : 4096;
+    while (cap < p->len + more) cap *= 2;
+    unsigned char *b = realloc(p->buf, cap);
+    if (!b) return -1;
+    p->buf = b;
+    p->cap = cap;
+    return 0;
+}
+
+static inline void ga_pack_varint(GaPack *p, uint64_t v) {
+    while (v >= 0x80) {
+        p->buf[p->len++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    p->buf[p->len++] = (unsigned char)v;
+}
+
+static inline uint64_t ga_pack_zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+// starts an empty generation in p, keeping its buffers
+static inline void ga_pack_begin(GaPack *p) {
+    p->len = sizeof(GaPackHeader);
+    p->count = 0;
+    memset(&p->prev, 0, sizeof p->prev);
+    p->prev.idx = -1;
+    p->raw = 0;
+    p->ring.n = p->ring.next = 0;
+}
+
+// Appends a row; rows go in increasing idx.  0, or -1 when out of memory.
+static inline int ga_pack_add(GaPack *p, const GaPackRow *r) {
+    if (r->bytes > p->xor_cap) {
+        unsigned char *x = realloc(p->xor, (size_t)r->bytes);
+        if (!x) return -1;
+        p->xor = x;
+        p->xor_cap = r->bytes;
+    }
+    // the closest earlier row of the same size, by nonzero bytes left after the XOR
+    int ref = 0, best = r->bytes;
+    for (int k = 1; k <= p->ring.n && best > 0; ++k) {
+        int bytes, diff = 0;
+        const unsigned char *g = ga_pack_ring_get(&p->ring, k, &bytes);
+        if (bytes != r->bytes) continue;
+        for (int b = 0; b < bytes; ++b) diff += g[b] != r->genes[b];
+        if (diff < best) {
+            best = diff;
+            ref = k;
+        }
+    }
+    const unsigned char *genes = r->genes;
+    if (ref) {
+        int bytes;
+        const unsigned char *g = ga_pack_ring_get(&p->ring, ref, &bytes);
+        for (int b = 0; b < bytes; ++b) p->xor[b] = g[b] ^ r->genes[b];
+        genes = p->xor;
+    }
+
+    int flags = ref;
+    if (r->idx == p->prev.idx + 1) flags |= GA_PACK_NEXT_IDX;
+    if (p->count > 0 && r->gene_len == p->prev.gene_len && r->bytes == p->prev.bytes && r->island == p->prev.island)
+        flags |= GA_PACK_SAME_SHAPE;
+    if (p->count > 0 && r->has_done_ts == p->prev.has_done_ts && (!r->has_done_ts || r->done_ts == p->prev.done_ts))
+        flags |= GA_PACK_SAME_TS;
+    int integral = r->has_fitness && r->fitness > -1e15 && r->fitness < 1e15 && r->fitness == (double)(int64_t)r->fitness;
+    if (!integral) flags |= GA_PACK_RAW_FITNESS;
+
+    // flags, 5 varints of up to 10 bytes, a double, and runs of at most one control byte per literal
+    if (ga_pack_reserve(p, 1 + 5 * 10 + 9 + 2 * (size_t)r->bytes + 1) != 0) return -1;
+    p->buf[p->len++] = (unsigned char)flags;
+    if (!(flags & GA_PACK_NEXT_IDX)) ga_pack_varint(p, (uint64_t)(r->idx - p->prev.idx - 1));
+    if (!(flags & GA_PACK_SAME_SHAPE)) {
+        ga_pack_varint(p, (uint64_t)(r->gene_len + 1));
+        ga_pack_varint(p, (uint64_t)r->bytes);
+        ga_pack_varint(p, (uint64_t)(r->island + 1));
+    }
+    if (integral) {
+        ga_pack_varint(p, ga_pack_zigzag((int64_t)r->fitness));
+    } else {
+        p->buf[p->len++] = (unsigned char)r->has_fitness;
+        if (r->has_fitness) {
+            memcpy(p->buf + p->len, &r->fitness, 8);
+            p->len += 8;
+        }
+    }
+    if (!(flags & GA_PACK_SAME_TS))
+        ga_pack_varint(p, r->has_done_ts ? ga_pack_zigzag(r->done_ts - p->prev.done_ts) + 1 : 0);
+    for (int b = 0; b < r->bytes; ) {
+        int e = b;
+        if (genes[b] == 0) {
+            while (e < r->bytes && genes[e] == 0 && e - b < 128) e++;
+            p->buf[p->len++] = (unsigned char)(127 + (e - b));
+        } else {
+            // a lone zero between literals is cheaper as a literal
+            while (e < r->bytes && e - b < 128 && (genes[e] != 0 || (e + 1 < r->bytes && genes[e + 1] != 0))) e++;
+            p->buf[p->len++] = (unsigned char)(e - b - 1);
+            memcpy(p->buf + p->len, genes + b, (size_t)(e - b));
+            p->len += (size_t)(e - b);
+        }
+        b = e;
+    }
+
+    if (ga_pack_ring_push(&p->ring, r->genes, r->bytes) != 0) return -1;
+    int64_t ts = r->has_done_ts ? r->done_ts : p->prev.done_ts; // deltas skip NULLs
+    p->prev = *r;
+    p->prev.done_ts = ts;
+    p->prev.genes = NULL;
+    p->count++;
+    p->raw += (size_t)r->bytes + sizeof(double);
+    return 0;
+}
+
+// Fills in the header; the packed generation is p->buf[0..p->len)
+static inline void ga_pack_finish(GaPack *p) {
+    if (ga_pack_reserve(p, 0) != 0 || !p->buf) {
+        p->len = 0;
+        return;
+    }
+    GaPackHeader h = { GA_PACK_MAGIC, GA_PACK_VERSION, 0, p->count, 0 };
+    h.crc = checkpointCrc(0, p->buf + sizeof h, p->len - sizeof h);
+    memcpy(p->buf, &h, sizeof h);
+}
+
+static inline void ga_pack_free(GaPack *p) {
+    free(p->buf);
+    free(p->xor);
+    ga_pack_ring_free(&p->ring);
+    memset(p, 0, sizeof *p);
+}
+
+// ---------- Reader ----------
+static inline int ga_pack_get_varint(GaPackReader *r, uint64_t *v) {
+    *v = 0;
+    for (int shift = 0; shift < 64 && r->p < r->end; shift += 7) {
+        unsigned char c = *r->p++;
+        *v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) return 0;
+    }
+    return -1;
+}
+
+static inline int64_t ga_pack_unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// Opens a packed generation, checking its header and CRC.  0, or -1 when it is not one or damaged.
+static inline int ga_pack_open(GaPackReader *r, const void *blob, size_t n) {
+    memset(r, 0, sizeof *r);
+    GaPackHeader h;
+    if (n < sizeof h) return -1;
+    memcpy(&h, blob, sizeof h);
+    if (h.magic != GA_PACK_MAGIC || h.version != GA_PACK_VERSION) return -1;
+    const unsigned char *rows = (const unsigned char *)blob + sizeof h;
+    if (checkpointCrc(0, rows, n - sizeof h) != h.crc) return -1;
+    r->p = rows;
+    r->end = rows + (n - sizeof h);
+    r->left = h.count;
+    r->prev.idx = -1;
+    return 0;
+}
+
+// The next row into *row, its genes valid until the next call.  1, 0 after the last row, -1 when damaged.
+static inline int ga_pack_next(GaPackReader *r, GaPackRow *row) {
+    if (r->left == 0) return 0;
+    uint64_t v;
+    if (r->p >= r->end) return -1;
+    int flags = *r->p++;
+    int ref = flags & 0x0f;
+    if (ref > r->ring.n) return -1;
+    if (flags & GA_PACK_NEXT_IDX) {
+        row->idx = r->prev.idx + 1;
+    } else {
+        if (ga_pack_get_varint(r, &v) != 0 || v > INT32_MAX) return -1;
+        row->idx = r->prev.idx + 1 + (int)v;
+    }
+    if (flags & GA_PACK_SAME_SHAPE) {
+        if (r->read == 0) return -1;
+        row->gene_len = r->prev.gene_len;
+        row->bytes = r->prev.bytes;
+        row->island = r->prev.island;
+    } else {
+        uint64_t len, bytes, island;
+        if (ga_pack_get_varint(r, &len) != 0 || ga_pack_get_varint(r, &bytes) != 0 ||
+            ga_pack_get_varint(r, &island) != 0 || len > INT32_MAX || bytes > INT32_MAX || island > INT32_MAX)
+            return -1;
+        row->gene_len = (int)len - 1;
+        row->bytes = (int)bytes;
+        row->island = (int)island - 1;
+    }
+    if (!(flags & GA_PACK_RAW_FITNESS)) {
+        if (ga_pack_get_varint(r, &v) != 0) return -1;
+        row->has_fitness = 1;
+        row->fitness = (double)ga_pack_unzigzag(v);
+    } else {
+        if (r->p >= r->end) return -1;
+        row->has_fitness = *r->p++;
+        row->fitness = 0;
+        if (row->has_fitness) {
+            if (r->end - r->p < 8) return -1;
+            memcpy(&row->fitness, r->p, 8);
+            r->p += 8;
+        }
+    }
+    if (flags & GA_PACK_SAME_TS) {
+        if (r->read == 0) return -1;
+        row->has_done_ts = r->prev.has_done_ts;
+        row->done_ts = r->prev.has_done_ts ? r->prev.done_ts : 0;
+    } else {
+        if (ga_pack_get_varint(r, &v) != 0) return -1;
+        row->has_done_ts = v != 0;
+        row->done_ts = v ? r->prev.done_ts + ga_pack_unzigzag(v - 1) : 0;
+    }
+
+    // decoded beside the ring: its next slot may hold the reference
+    if (row->bytes > r->genes_cap) {
+        unsigned char *g = realloc(r->genes, (size_t)row->bytes);
+        if (!g) return -1;
+        r->genes = g;
+        r->genes_cap = row->bytes;
+    }
+    unsigned char *genes = r->genes;
+    for (int b = 0; b < row->bytes; ) {
+        if (r->p >= r->end) return -1;
+        int t = *r->p++;
+        int run = t < 128 ? t + 1 : t - 127;
+        if (run > row->bytes - b) return -1;
+        if (t < 128) {
+            if (r->end - r->p < run) return -1;
+            memcpy(genes + b, r->p, (size_t)run);
+            r->p += run;
+        } else {
+            memset(genes + b, 0, (size_t)run);
+        }
+        b += run;
+    }
+    if (ref) {
+        int bytes;
+        const unsigned char *g = ga_pack_ring_get(&r->ring, ref, &bytes);
+        if (bytes != row->bytes) return -1;
+        for (int b = 0; b < bytes; ++b) genes[b] ^= g[b];
+    }
+    if (ga_pack_ring_push(&r->ring, genes, row->bytes) != 0) return -1;
+
+    row->genes = genes;
+    int64_t ts = row->has_done_ts ? row->done_ts : r->prev.done_ts;
+    r->prev = *row;
+    r->prev.done_ts = ts;
+    r->left--;
+    r->read++;
+    return 1;
+}
+
+static inline void ga_pack_close(GaPackReader *r) {
+    ga_pack_ring_free(&r->ring);
+    free(r->genes);
+    r->genes = NULL;
+    r->genes_cap = 0;
+}
+
+#endif
@@ -156,6 +156,7 @@
 	extern int wallFeeler(int dist, int angle); // Returns if there is a wall or not at the Specified Angle within the Specified Distance of the ship -JRA
 	extern int wallFeelerRad(int dist, double a); // Returns if there is a wall or not at the Specified Angle within the Specified Distance of the ship -JRA
 	extern int wallBetween(int x1, int y1, int x2, int y2); // Returns if there is a wall or not between two Specified Points -JRA
+	extern int wallSweep(int dist, int startDeg, int stepDeg, int count, int out[], int *minIdx, int *maxIdx) __attribute__((weak)); // Fills out[i] with wallFeeler(dist, startDeg + i*stepDeg) in one call and reports the closest and furthest index, only in libcAI_sim so use sweepWalls() from wallSweep.h
 // Shot functions -JNE
 	extern int shotAlert(int idx); // Returns a Danger Rating of a shot -JRA
 	extern int shotX(int idx); // Returns the X coordinate of a shot -JRA
@@ -0,0 +1,9 @@
+// Extras only provided by the headless simulator (sim/libcAI_sim.so).
+// Everything in cAI.h is implemented by both libraries.
+#ifndef CAI_SIM_H
+#define CAI_SIM_H
+	extern long simTick(void); // Frames simulated so far
+	extern int simDeaths(void); // Times our ship has died
+	extern int simKills(void); // Enemy ships our shots destroyed
+	extern void simQuit(void); // Ends the run after the current frame
+#endif
@@ -0,0 +1,359 @@
+// Binary GA checkpoint: a fixed header (hyperparameters, generation, seed),
+// the fitness array and the packed gene words, so a checkpoint loads with
+// one mmap and no parsing.  A CRC-32 over the whole file (its own field
+// taken as 0) catches torn or corrupted files.
+//
+// Layout, little-endian, every section 8-byte aligned:
+//   CheckpointHeader
+//   int32_t fitness[population]           at fitnessOffset
+//   gene_word_t genes[population][words]  at genesOffset
+//
+// The seed is the whole RNG state: every draw comes from a stream keyed by
+// (seed, generation, individual), see rng.h, so a resumed run continues
+// exactly where the saved one would have.
+//
+// Files are written to "<path>.tmp" and renamed over path once complete,
+// so a reader sees the old checkpoint or the new one, never half of one.
+// CheckpointWriter does the CRC, write and rename on its own thread; the
+// training loop only pays for copying the population into a buffer.
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chromosome.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define CHECKPOINT_MAGIC 0x41475058u /* "XPGA" */
+#define CHECKPOINT_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;    /* sizeof(CheckpointHeader) */
+    uint32_t crc;           /* CRC-32 of the file with this field 0 */
+    int32_t generation;     /* last generation evaluated */
+    int32_t population;
+    int32_t geneLength;
+    int32_t elitism;
+    int32_t generations;    /* generations the run was set to */
+    int32_t saveEvery;
+    double mutation;
+    uint64_t seed;          /* the experiment seed, i.e. the RNG state */
+    uint32_t words;         /* gene words per individual */
+    uint32_t fitnessOffset; /* from the start of the file */
+    uint64_t genesOffset;
+    uint64_t fileSize;
+} CheckpointHeader;
+
+_Static_assert(sizeof(CheckpointHeader) == 80, "checkpoint header layout");
+
+enum {
+    CHECKPOINT_OK = 0,
+    CHECKPOINT_ERR_IO = -1,      /* missing or unreadable */
+    CHECKPOINT_ERR_FORMAT = -2,  /* not a binary checkpoint, e.g. a text one */
+    CHECKPOINT_ERR_CORRUPT = -3  /* bad version, size or CRC */
+};
+
+/* ---- CRC-32 (IEEE, reflected) ---- */
+
+static uint32_t checkpointCrcTable[256];
+static pthread_once_t checkpointCrcOnce = PTHREAD_ONCE_INIT;
+
+static inline void checkpointCrcInit(void)
+{
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        checkpointCrcTable[i] = c;
+    }
+}
+
+static inline uint32_t checkpointCrc(uint32_t crc, const void *data, size_t n)
+{
+    const unsigned char *p = data;
+    pthread_once(&checkpointCrcOnce, checkpointCrcInit);
+    crc = ~crc;
+    while (n--) crc = checkpointCrcTable[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+/* CRC of a whole image, its crc field counted as 0 */
+static inline uint32_t checkpointImageCrc(const unsigned char *image, size_t size)
+{
+    static const uint32_t zero = 0;
+    size_t at = offsetof(CheckpointHeader, crc);
+    uint32_t crc = checkpointCrc(0, image, at);
+    crc = checkpointCrc(crc, &zero, sizeof zero);
+    return checkpointCrc(crc, image + at + sizeof zero, size - at - sizeof zero);
+}
+
+/* ---- building and writing ---- */
+
+static inline size_t checkpointAlign8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+/* file size for population individuals of geneLength genes */
+static inline size_t checkpointSize(int population, int geneLength)
+{
+    size_t fit = checkpointAlign8(sizeof(CheckpointHeader) + (size_t)population * sizeof(int32_t));
+    return fit + (size_t)population * GENE_WORDS(geneLength) * sizeof(gene_word_t);
+}
+
+/* Lays out *h (hyperparameters filled in by the caller) and pop into image,
+   checkpointSize() bytes.  The CRC is left for checkpointWriteImage(). */
+static inline void checkpointBuild(unsigned char *image, const CheckpointHeader *h, Chromosome **pop)
+{
+    CheckpointHeader hd = *h;
+    int words = GENE_WORDS(hd.geneLength);
+    hd.magic = CHECKPOINT_MAGIC;
+    hd.version = CHECKPOINT_VERSION;
+    hd.headerSize = sizeof hd;
+    hd.crc = 0;
+    hd.words = (uint32_t)words;
+    hd.fitnessOffset = sizeof hd;
+    hd.genesOffset = checkpointAlign8(sizeof hd + (size_t)hd.population * sizeof(int32_t));
+    hd.fileSize = checkpointSize(hd.population, hd.geneLength);
+    memcpy(image, &hd, sizeof hd);
+
+    int32_t *fit = (int32_t *)(image + hd.fitnessOffset);
+    gene_word_t *genes = (gene_word_t *)(image + hd.genesOffset);
+    memset(image + hd.fitnessOffset, 0, hd.genesOffset - hd.fitnessOffset);
+    for (int i = 0; i < hd.population; ++i) {
+        fit[i] = pop[i]->fitness;
+        memcpy(genes + (size_t)i * words, pop[i]->genes, (size_t)words * sizeof(gene_word_t));
+    }
+}
+
+/* Stamps the CRC into image and writes it to path through "<path>.tmp" and a rename.
+   Returns 0, or -1 with errno set. */
+static inline int checkpointWriteImage(const char *path, unsigned char *image, size_t size)
+{
+    uint32_t crc = checkpointImageCrc(image, size);
+    memcpy(image + offsetof(CheckpointHeader, crc), &crc, sizeof crc);
+
+    char tmp[4096];
+    if (snprintf(tmp, sizeof tmp, "%s.tmp", path) >= (int)sizeof tmp) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return -1;
+    int ok = fwrite(image, 1, size, f) == size && fflush(f) == 0;
+#if defined(_WIN32) || defined(_WIN64)
+    ok = ok && _commit(_fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (ok) remove(path); /* rename() does not replace on Windows */
+#else
+    ok = ok && fsync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+#endif
+    if (!ok || rename(tmp, path) != 0) {
+        int e = errno;
+        remove(tmp);
+        errno = e;
+        return -1;
+    }
+    return 0;
+}
+
+/* synchronous save of pop with the hyperparameters in *h */
+static inline int checkpointSave(const char *path, const CheckpointHeader *h, Chromosome **pop)
+{
+    size_t size = checkpointSize(h->population, h->geneLength);
+    unsigned char *image = malloc(size);
+    if (!image) return -1;
+    checkpointBuild(image, h, pop);
+    int rc = checkpointWriteImage(path, image, size);
+    free(image);
+    return rc;
+}
+
+/* ---- background writer ---- */
+
+typedef struct {
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int started;
+    int busy;      /* an image is waiting or being written */
+    int quit;
+    int failed;    /* writes that failed so far */
+    char path[4096];
+    unsigned char *image;
+    size_t size, capacity;
+} CheckpointWriter;
+
+static inline void *checkpointWriterRun(void *arg)
+{
+    CheckpointWriter *w = arg;
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->busy && !w->quit) pthread_cond_wait(&w->cond, &w->lock);
+        if (!w->busy) break;
+        pthread_mutex_unlock(&w->lock);
+        int rc = checkpointWriteImage(w->path, w->image, w->size);
+        if (rc != 0) fprintf(stderr, "checkpoint %s: %s\n", w->path, strerror(errno));
+        pthread_mutex_lock(&w->lock);
+        if (rc != 0) w->failed++;
+        w->busy = 0;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+/* Returns 0, or -1 when no thread could be started; checkpointWriterSave()
+   then writes synchronously. */
+static inline int checkpointWriterStart(CheckpointWriter *w)
+{
+    memset(w, 0, sizeof *w);
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    w->started = pthread_create(&w->tid, NULL, checkpointWriterRun, w) == 0;
+    return w->started ? 0 : -1;
+}
+
+/* Snapshots pop into the writer's buffer and returns; the file is written
+   in the background.  Waits only while the previous checkpoint is still
+   being written.  Returns 0, or -1 when out of memory or the path is too long. */
+static inline int checkpointWriterSave(CheckpointWriter *w, const char *path, const CheckpointHeader *h,
+                                       Chromosome **pop)
+{
+    size_t size = checkpointSize(h->population, h->geneLength);
+    if (strlen(path) >= sizeof w->path) return -1;
+    pthread_mutex_lock(&w->lock);
+    while (w->busy) pthread_cond_wait(&w->cond, &w->lock);
+    pthread_mutex_unlock(&w->lock);
+
+    if (size > w->capacity) {
+        unsigned char *image = realloc(w->image, size);
+        if (!image) return -1;
+        w->image = image;
+        w->capacity = size;
+    }
+    checkpointBuild(w->image, h, pop);
+    w->size = size;
+    strcpy(w->path, path);
+    if (!w->started) return checkpointWriteImage(w->path, w->image, w->size);
+
+    pthread_mutex_lock(&w->lock);
+    w->busy = 1;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    return 0;
+}
+
+/* finishes the pending write, stops the thread.  Returns the number of failed writes. */
+static inline int checkpointWriterStop(CheckpointWriter *w)
+{
+    if (w->started) {
+        pthread_mutex_lock(&w->lock);
+        w->quit = 1;
+        pthread_cond_signal(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+        pthread_join(w->tid, NULL);
+    }
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+    free(w->image);
+    int failed = w->failed;
+    memset(w, 0, sizeof *w);
+    return failed;
+}
+
+/* ---- loading ---- */
+
+typedef struct {
+    const CheckpointHeader *h;
+    const int32_t *fitness;
+    const gene_word_t *genes; /* h->words per individual */
+    void *base;
+    size_t size;
+} Checkpoint;
+
+static inline void checkpointClose(Checkpoint *ck)
+{
+    if (ck->base) {
+#if defined(_WIN32) || defined(_WIN64)
+        free(ck->base);
+#else
+        munmap(ck->base, ck->size);
+#endif
+    }
+    memset(ck, 0, sizeof *ck);
+}
+
+/* Maps path read-only and checks it.  Returns CHECKPOINT_OK, or one of
+   CHECKPOINT_ERR_* (ERR_FORMAT for a file that is not a binary checkpoint). */
+static inline int checkpointOpen(const char *path, Checkpoint *ck)
+{
+    memset(ck, 0, sizeof *ck);
+#if defined(_WIN32) || defined(_WIN64)
+    FILE *f = fopen(path, "rb");
+    if (!f) return CHECKPOINT_ERR_IO;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (len < 0) { fclose(f); return CHECKPOINT_ERR_IO; }
+    ck->size = (size_t)len;
+    ck->base = malloc(ck->size ? ck->size : 1);
+    if (!ck->base || fread(ck->base, 1, ck->size, f) != ck->size) {
+        fclose(f);
+        checkpointClose(ck);
+        return CHECKPOINT_ERR_IO;
+    }
+    fclose(f);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return CHECKPOINT_ERR_IO;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return CHECKPOINT_ERR_IO; }
+    ck->size = (size_t)st.st_size;
+    if (ck->size < sizeof(CheckpointHeader)) { close(fd); return CHECKPOINT_ERR_FORMAT; }
+    void *base = mmap(NULL, ck->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return CHECKPOINT_ERR_IO;
+    ck->base = base;
+#endif
+    if (ck->size < sizeof(CheckpointHeader)) { checkpointClose(ck); return CHECKPOINT_ERR_FORMAT; }
+    const CheckpointHeader *h = ck->base;
+    if (h->magic != CHECKPOINT_MAGIC) { checkpointClose(ck); return CHECKPOINT_ERR_FORMAT; }
+    int ok = h->version == CHECKPOINT_VERSION && h->headerSize == sizeof *h && h->fileSize == ck->size
+          && h->population > 0 && h->geneLength > 0 && h->words == (uint32_t)GENE_WORDS(h->geneLength)
+          && h->fileSize == checkpointSize(h->population, h->geneLength)
+          && h->fitnessOffset == sizeof *h
+          && h->genesOffset == checkpointAlign8(sizeof *h + (size_t)h->population * sizeof(int32_t));
+    if (!ok || checkpointImageCrc(ck->base, ck->size) != h->crc) {
+        checkpointClose(ck);
+        return CHECKPOINT_ERR_CORRUPT;
+    }
+    ck->h = h;
+    ck->fitness = (const int32_t *)((const unsigned char *)ck->base + h->fitnessOffset);
+    ck->genes = (const gene_word_t *)((const unsigned char *)ck->base + h->genesOffset);
+    return CHECKPOINT_OK;
+}
+
+/* copies individual i of an open checkpoint into c */
+static inline void checkpointGet(const Checkpoint *ck, int i, Chromosome *c)
+{
+    memcpy(c->genes, ck->genes + (size_t)i * ck->h->words, (size_t)ck->h->words * sizeof(gene_word_t));
+    c->fitness = ck->fitness[i];
+}
+
+#endif
@@ -0,0 +1,113 @@
+// Chromosome layout shared by the GA trainer, the evaluators and the bots
+// that decode it.
+#ifndef CHROMOSOME_H
+#define CHROMOSOME_H
+
+#include <stdint.h>
+#include <string.h>
+
+/* genes are packed 64 to a word: gene i is bit (i % 64) of genes[i / 64].
+   Bits past the gene length in the last word are kept 0. */
+typedef uint64_t gene_word_t;
+
+#define GENE_WORD_BITS 64
+#define GENE_WORDS(L) (((L) + GENE_WORD_BITS - 1) / GENE_WORD_BITS)
+#define GENE_BYTES(L) (((L) + 7) / 8) /* packed BLOB size */
+
+typedef struct {
+    gene_word_t *genes;
+    int fitness;
+} Chromosome;
+
+static inline int geneGet(const Chromosome *c, int i)
+{
+    return (int)((c->genes[i / GENE_WORD_BITS] >> (i % GENE_WORD_BITS)) & 1);
+}
+
+static inline void geneSet(Chromosome *c, int i, int bit)
+{
+    gene_word_t m = (gene_word_t)1 << (i % GENE_WORD_BITS);
+    if (bit) c->genes[i / GENE_WORD_BITS] |= m;
+    else c->genes[i / GENE_WORD_BITS] &= ~m;
+}
+
+/* valid bits of the last word */
+static inline gene_word_t geneTailMask(int L)
+{
+    int r = L % GENE_WORD_BITS;
+    return r ? ((gene_word_t)1 << r) - 1 : ~(gene_word_t)0;
+}
+
+/* bits [from, to) of a word, to <= 64 */
+static inline gene_word_t geneRangeMask(int from, int to)
+{
+    gene_word_t hi = to >= GENE_WORD_BITS ? ~(gene_word_t)0 : ((gene_word_t)1 << to) - 1;
+    return hi & ~(((gene_word_t)1 << from) - 1);
+}
+
+/* number of set genes */
+static inline int genePopcount(const Chromosome *c, int L)
+{
+    int n = GENE_WORDS(L), sum = 0;
+    for (int w = 0; w < n - 1; ++w) sum += __builtin_popcountll(c->genes[w]);
+    if (n > 0) sum += __builtin_popcountll(c->genes[n - 1] & geneTailMask(L));
+    return sum;
+}
+
+/* dst genes [from, to) = src genes [from, to), whole words in the middle */
+static inline void geneCopyRange(Chromosome *dst, const Chromosome *src, int from, int to)
+{
+    if (from >= to) return;
+    int w0 = from / GENE_WORD_BITS, w1 = (to - 1) / GENE_WORD_BITS;
+    if (w0 == w1) {
+        gene_word_t m = geneRangeMask(from % GENE_WORD_BITS, (to - 1) % GENE_WORD_BITS + 1);
+        dst->genes[w0] = (dst->genes[w0] & ~m) | (src->genes[w0] & m);
+        return;
+    }
+    gene_word_t m0 = geneRangeMask(from % GENE_WORD_BITS, GENE_WORD_BITS);
+    gene_word_t m1 = geneRangeMask(0, (to - 1) % GENE_WORD_BITS + 1);
+    dst->genes[w0] = (dst->genes[w0] & ~m0) | (src->genes[w0] & m0);
+    if (w1 > w0 + 1) memcpy(dst->genes + w0 + 1, src->genes + w0 + 1, (size_t)(w1 - w0 - 1) * sizeof(gene_word_t));
+    dst->genes[w1] = (dst->genes[w1] & ~m1) | (src->genes[w1] & m1);
+}
+
+/* 64-bit hash of the genes, the same on any host, e.g. to key a fitness
+   cache.  The length is mixed in so a genome and its zero-extension differ. */
+static inline uint64_t geneHash(const Chromosome *c, int L)
+{
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ (uint64_t)L;
+    for (int w = 0; w < GENE_WORDS(L); ++w) {
+        h = (h ^ c->genes[w]) * 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 31;
+    }
+    /* splitmix64 finaliser */
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+/* Packed BLOB: gene i is bit (i % 8) of byte i / 8, the same on any host. */
+static inline void genePack(const Chromosome *c, int L, unsigned char *out)
+{
+    for (int b = 0; b < GENE_BYTES(L); ++b)
+        out[b] = (unsigned char)(c->genes[b / 8] >> (8 * (b % 8)));
+}
+
+/* from a packed BLOB of len bytes, missing genes are 0 */
+static inline void geneUnpack(Chromosome *c, int L, const unsigned char *in, int len)
+{
+    memset(c->genes, 0, (size_t)GENE_WORDS(L) * sizeof(gene_word_t));
+    for (int b = 0; b < GENE_BYTES(L) && b < len; ++b)
+        c->genes[b / 8] |= (gene_word_t)in[b] << (8 * (b % 8));
+    if (L > 0) c->genes[GENE_WORDS(L) - 1] &= geneTailMask(L);
+}
+
+/* from an old one-byte-per-gene BLOB (gene_len NULL in the DB) */
+static inline void geneUnpackBytes(Chromosome *c, int L, const unsigned char *in, int len)
+{
+    memset(c->genes, 0, (size_t)GENE_WORDS(L) * sizeof(gene_word_t));
+    for (int i = 0; i < L && i < len; ++i)
+        if (in[i]) c->genes[i / GENE_WORD_BITS] |= (gene_word_t)1 << (i % GENE_WORD_BITS);
+}
+
+#endif
@@ -0,0 +1,148 @@
+// Precomputed wall proximity for a map.  sim/mkdistfield turns a .xp map into
+// a small file that holds, for every DIST_FIELD_SUB x DIST_FIELD_SUB cell of a
+// block, which wall block is nearest (as an offset from the cell's own block).
+// The file is mmapped read-only, and the closest wall is then one cell lookup
+// plus a clamp to that block's square, instead of a 360 feeler sweep.
+// Coordinates are the server's: pixels, y up, outside the map counts as wall.
+#ifndef DISTFIELD_H
+#define DISTFIELD_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DIST_FIELD_MAGIC "XPDF"
+#define DIST_FIELD_VERSION 1
+#define DIST_FIELD_SUB 5     // cells per block side, 7 pixel cells with 35 pixel blocks
+#define DIST_FIELD_NONE -128 // cell offset when no wall is within 127 blocks
+
+typedef struct
+{
+  char magic[4];
+  int32_t version;
+  int32_t w, h;  // map size in blocks
+  int32_t sub;   // cells per block side
+  int32_t block; // pixels per block side
+} DistFieldHeader;
+
+// cells follow the header: (h*sub) rows of (w*sub) cells, row 0 at the bottom,
+// each cell two signed bytes (dx, dy) from the cell's block to the nearest wall block
+
+typedef struct
+{
+  const DistFieldHeader *hdr;
+  const int8_t *cells;
+  size_t size; // bytes mapped, 0 = not loaded
+  double cellPx;
+} DistField;
+
+static inline int distFieldMap(DistField *df, const char *path)
+{
+  memset(df, 0, sizeof *df);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(DistFieldHeader))
+  {
+    close(fd);
+    return -1;
+  }
+  void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return -1;
+  const DistFieldHeader *h = p;
+  size_t cells = (size_t)h->w * h->sub * h->h * h->sub;
+  if (memcmp(h->magic, DIST_FIELD_MAGIC, 4) != 0 || h->version != DIST_FIELD_VERSION || h->w <= 0 || h->h <= 0 ||
+      h->sub <= 0 || h->block <= 0 || (size_t)st.st_size < sizeof *h + 2 * cells)
+  {
+    munmap(p, (size_t)st.st_size);
+    return -1;
+  }
+  df->hdr = h;
+  df->cells = (const int8_t *)(h + 1);
+  df->size = (size_t)st.st_size;
+  df->cellPx = (double)h->block / h->sub;
+  return 0;
+}
+
+static inline void distFieldUnmap(DistField *df)
+{
+  if (df->size)
+    munmap((void *)df->hdr, df->size);
+  memset(df, 0, sizeof *df);
+}
+
+// Takes "-distfield file" out of the command line (the live client would
+// reject it) and maps the file.  Returns 0 when a field was loaded.
+static inline int distFieldArgs(DistField *df, int *argc, char *argv[])
+{
+  int found = -1;
+  memset(df, 0, sizeof *df);
+  for (int i = 1; i + 1 < *argc; i++)
+  {
+    if (strcmp(argv[i], "-distfield") != 0)
+      continue;
+    found = distFieldMap(df, argv[i + 1]);
+    for (int j = i; j + 2 <= *argc; j++)
+      argv[j] = argv[j + 2];
+    *argc -= 2;
+    break;
+  }
+  return found;
+}
+
+// Distance in pixels from (x, y) to the nearest wall, at most dist.
+// angleDeg gets the world direction of that wall in whole degrees, 0 when
+// nothing is within dist or (x, y) is inside a wall.  The nearest block of a
+// cell is only exact at its centre, so the four cells around (x, y) are asked
+// and the closest of their blocks wins.
+static inline int distFieldClosest(const DistField *df, double x, double y, int dist, int *angleDeg)
+{
+  const DistFieldHeader *h = df->hdr;
+  int cw = h->w * h->sub, ch = h->h * h->sub;
+  double B = h->block;
+  if (angleDeg)
+    *angleDeg = 0;
+  if (x < 0.0 || y < 0.0 || x >= h->w * B || y >= h->h * B)
+    return 0;
+  int cx0 = (int)floor(x / df->cellPx - 0.5), cy0 = (int)floor(y / df->cellPx - 0.5);
+  double best = INFINITY, bestX = x, bestY = y;
+  for (int cy = cy0; cy <= cy0 + 1; cy++)
+  {
+    for (int cx = cx0; cx <= cx0 + 1; cx++)
+    {
+      if (cx < 0 || cy < 0 || cx >= cw || cy >= ch)
+        continue;
+      const int8_t *c = df->cells + 2 * ((size_t)cy * cw + cx);
+      if (c[0] == DIST_FIELD_NONE)
+        continue;
+      int bx = cx / h->sub + c[0], by = cy / h->sub + c[1];
+      // nearest point of that block's square
+      double px = fmin(fmax(x, bx * B), (bx + 1) * B);
+      double py = fmin(fmax(y, by * B), (by + 1) * B);
+      double d = (px - x) * (px - x) + (py - y) * (py - y);
+      if (d < best)
+      {
+        best = d;
+        bestX = px;
+        bestY = py;
+      }
+    }
+  }
+  if (best >= (double)dist * dist)
+    return dist;
+  if (angleDeg && best > 0.0)
+  {
+    int a = (int)lround(atan2(bestY - y, bestX - x) * 180.0 / M_PI);
+    *angleDeg = a < 0 ? a + 360 : a % 360;
+  }
+  return (int)sqrt(best);
+}
+
+#endif
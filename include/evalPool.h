@@ -0,0 +1,142 @@
+// Parallel fitness evaluation for the GA trainers.  The worker threads are
+// started once and sleep between generations; each evalPoolRun() hands them
+// the population, and every thread (the caller included) keeps claiming the
+// next chunk of individuals from a shared atomic index until none are left,
+// so a slow individual only holds up its own chunk.  Fitness values go to a
+// result buffer indexed like the population and are copied into the
+// Chromosomes once all threads are done, so callers can then persist the
+// whole generation in one go.
+#ifndef EVALPOOL_H
+#define EVALPOOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "chromosome.h"
+
+#define EVAL_POOL_CHUNKS_PER_THREAD 8 /* chunks per thread and generation, for load balance */
+
+typedef int (*EvalFitFunc)(const Chromosome *, int);
+
+typedef struct {
+    int threads; /* including the caller */
+    pthread_t *tid;
+    pthread_mutex_t lock;
+    pthread_cond_t start, done;
+    unsigned long epoch; /* bumped for every run */
+    int active;          /* workers still on the current run */
+    int quit;
+    /* current run */
+    Chromosome **pop;
+    int size, geneLength, chunk;
+    EvalFitFunc fit;
+    atomic_int next;
+    int *results;
+    int capacity;
+} EvalPool;
+
+static inline void evalPoolDrain(EvalPool *p)
+{
+    for (;;) {
+        int lo = atomic_fetch_add(&p->next, p->chunk);
+        if (lo >= p->size) return;
+        int hi = lo + p->chunk < p->size ? lo + p->chunk : p->size;
+        for (int i = lo; i < hi; ++i) p->results[i] = p->fit(p->pop[i], p->geneLength);
+    }
+}
+
+static inline void *evalPoolWorker(void *arg)
+{
+    EvalPool *p = arg;
+    unsigned long seen = 0;
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (!p->quit && p->epoch == seen) pthread_cond_wait(&p->start, &p->lock);
+        if (p->quit) break;
+        seen = p->epoch;
+        pthread_mutex_unlock(&p->lock);
+        evalPoolDrain(p);
+        pthread_mutex_lock(&p->lock);
+        if (--p->active == 0) pthread_cond_signal(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+/* threads <= 0 uses every online core.  Returns 0, or -1 when no worker could be started
+   (the pool then evaluates on the calling thread only). */
+static inline int evalPoolStart(EvalPool *p, int threads)
+{
+    memset(p, 0, sizeof *p);
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->start, NULL);
+    pthread_cond_init(&p->done, NULL);
+    p->threads = 1;
+    if (threads > 1) p->tid = malloc((size_t)(threads - 1) * sizeof(pthread_t));
+    for (int t = 0; p->tid && t < threads - 1; ++t) {
+        if (pthread_create(&p->tid[t], NULL, evalPoolWorker, p) != 0) break;
+        p->threads++;
+    }
+    return threads > 1 && p->threads == 1 ? -1 : 0;
+}
+
+static inline void evalPoolStop(EvalPool *p)
+{
+    pthread_mutex_lock(&p->lock);
+    p->quit = 1;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+    for (int t = 0; t < p->threads - 1; ++t) pthread_join(p->tid[t], NULL);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->start);
+    pthread_cond_destroy(&p->done);
+    free(p->tid);
+    free(p->results);
+    memset(p, 0, sizeof *p);
+}
+
+/* pop[i]->fitness = fit(pop[i], geneLength) for all size individuals, on all threads.
+   A pool that was never started evaluates on the calling thread.
+   Returns 0, or -1 when the result buffer could not be allocated. */
+static inline int evalPoolRun(EvalPool *p, Chromosome **pop, int size, int geneLength, EvalFitFunc fit)
+{
+    if (size <= 0) return 0;
+    if (p->threads <= 1) {
+        for (int i = 0; i < size; ++i) pop[i]->fitness = fit(pop[i], geneLength);
+        return 0;
+    }
+    if (size > p->capacity) {
+        int *r = realloc(p->results, (size_t)size * sizeof(int));
+        if (!r) return -1;
+        p->results = r;
+        p->capacity = size;
+    }
+    int chunk = size / (p->threads * EVAL_POOL_CHUNKS_PER_THREAD);
+    p->pop = pop;
+    p->size = size;
+    p->geneLength = geneLength;
+    p->fit = fit;
+    p->chunk = chunk > 0 ? chunk : 1;
+    atomic_store(&p->next, 0);
+
+    pthread_mutex_lock(&p->lock);
+    p->active = p->threads - 1;
+    p->epoch++;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+
+    evalPoolDrain(p);
+
+    pthread_mutex_lock(&p->lock);
+    while (p->active > 0) pthread_cond_wait(&p->done, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+
+    for (int i = 0; i < size; ++i) pop[i]->fitness = p->results[i];
+    return 0;
+}
+
+#endif
@@ -0,0 +1,226 @@
+// Rule set evolved by the GA.  Shared by GASmarty (live game) and the batched
+// simulator (sim/simBatch.c) so both decode a chromosome the same way.
+#ifndef GARULES_H
+#define GARULES_H
+
+#include <stdint.h>
+#include "chromosome.h"
+
+typedef struct
+{
+  int aimDir;
+  double frontWall;
+  double wall5;
+  double backWall;
+  double wall7;
+  double heading;
+  double tracking;
+  double trackWall;
+  double closest;
+  int closestAngle;
+  double furthest;
+  int furthestAngle;
+  int shotDanger;
+  int speed;
+  int headingTrackingDiff;
+  int headingAimingDiff;
+} State;
+
+typedef struct
+{
+  int priority;
+  int result;
+} Inference;
+
+// chromosome structure:
+//  all parameters are between 0 and 255, so we use 8 bits per number
+#define GA_PARAM_BITS 8
+
+static inline uint8_t paramFromChromosome(const Chromosome *chrom, int offset, int length)
+{
+  if (!chrom || !chrom->genes || length <= 0 || length > 8)
+    return 0;
+  // the genes of one parameter sit in one word, or straddle two
+  int w = offset / GENE_WORD_BITS, s = offset % GENE_WORD_BITS;
+  gene_word_t bits = chrom->genes[w] >> s;
+  if (s + length > GENE_WORD_BITS)
+    bits |= chrom->genes[w + 1] << (GENE_WORD_BITS - s);
+  // first gene is the most significant bit
+  uint8_t value = 0;
+  for (int i = 0; i < length; i++)
+    value = (value << 1) | ((bits >> i) & 1);
+  return value;
+}
+// General helper to read N consecutive parameters starting at parameter index start
+static inline void readNParams(const Chromosome *chrom, int start, int N, uint8_t *out)
+{
+  for (int i = 0; i < N; ++i)
+    out[i] = paramFromChromosome(chrom, (start + i) * GA_PARAM_BITS, GA_PARAM_BITS);
+}
+
+// rp are propulsion rules, output 0 for nothing, 1 for thruster
+// tr are turning rules, output 0 for nothing, 1 for turnRight, -1 for turnLeft, 2 for turn to aimdir
+
+#define R1 5 // number of parameters in this rule
+static inline Inference rp1(const State *state, const Chromosome *chromosome)
+{
+  uint8_t p[R1];
+  readNParams(chromosome, 0, R1, p);
+  int value = state->shotDanger > p[1] && state->shotDanger < p[2] && state->frontWall > p[3] && state->trackWall > p[4] ? 1 : 0;
+  return (Inference){p[0], value};
+}
+#define R2 4
+static inline Inference rp2(const State *state, const Chromosome *chromosome)
+{
+  uint8_t p[R2];
+  readNParams(chromosome, R1, R2, p);
+  int value = (state->furthestAngle == p[1]) && state->speed < p[2] && state->frontWall > p[3] ? 1 : 0;
+  return (Inference){p[0], value};
+}
+#define R3 5
+static inline Inference rp3(const State *state, const Chromosome *chromosome)
+{
+  uint8_t p[R3];
+  readNParams(chromosome, R1 + R2, R3, p);
+  int value = (state->headingTrackingDiff > p[1] && state->headingTrackingDiff < p[2] && state->trackWall < p[3] && state->frontWall > p[4]) ? 1 : 0;
+  return (Inference){p[0], value};
+}
+#define R4 3
+static inline Inference rp4(const State *state, const Chromosome *chromosome)
+{
+  uint8_t p[R4];
+  readNParams(chromosome, R1 + R2 + R3, R4, p);
+  int value = (state->backWall < p[1] && state->frontWall > p[2]) ? 1 : 0;
+  return (Inference){p[0], value};
+}
+#define R5 5
+static inline Inference rp5(const State *state, const Chromosome *chromosome)
+{
+  uint8_t p[R5];
+  readNParams(chromosome, R1 + R2 + R3 + R4, R5, p);
+  int value = (state->headingTrackingDiff > p[1] && state->headingTrackingDiff < p[2] && state->trackWall < p[3] && state->frontWall > p[4]) ? 1 : 0;
+  return (Inference){p[0], value};
+}
+#define R6 4
+static inline Inference rp6(const State *state, const Chromosome *chromosome)
+{
+  uint8_t p[R6];
+  readNParams(chromosome, R1 + R2 + R3 + R4 + R5, R6, p);
+  int value = ((state->wall5 < p[1] || state->wall7 < p[2]) && state->frontWall > p[3]) ? 1 : 0;
+  return (Inference){p[0], value};
+}
+#define R7 3
+static inline Inference tr1(const State *state, const Chromosome *chromosome)
+{
+  uint8_t p[R7];
+  readNParams(chromosome, R1 + R2 + R3 + R4 + R5 + R6, R7, p);
+  int value = 0;
+  if (state->speed > p[1] && state->headingTrackingDiff < 180 - p[2])
+  {
+    value = -1;
+  }
+  else if (state->speed > p[1] && state->headingTrackingDiff > 180 + p[2])
+  {
+    value = 1;
+  }
+  return (Inference){p[0], value};
+}
+#define R8 4
+static inline Inference tr2(const State *state, const Chromosome *chromosome)
+{
+  uint8_t p[R8];
+  readNParams(chromosome, R1 + R2 + R3 + R4 + R5 + R6 + R7, R8, p);
+  int value = 0;
+  if (state->closest > p[1] && state->aimDir > p[2] && state->headingAimingDiff < 180 && state->headingAimingDiff > p[3])
+  {
+    value = 1;
+  }
+  else if (state->closest > p[1] && state->aimDir > p[2] && state->headingAimingDiff > 180 && state->headingAimingDiff < 360 - p[3])
+  {
+    value = -1;
+  }
+  return (Inference){p[0], value};
+}
+#define R9 4
+static inline Inference tr3(const State *state, const Chromosome *chromosome)
+{
+  uint8_t p[R9];
+  readNParams(chromosome, R1 + R2 + R3 + R4 + R5 + R6 + R7 + R8, R9, p);
+  int value = (state->closest > p[1] && state->aimDir > p[2]) ? 2 : 0;
+  return (Inference){p[0], value};
+}
+#define R10 4
+static inline Inference tr4(const State *state, const Chromosome *chromosome)
+{
+  uint8_t p[R10];
+  readNParams(chromosome, R1 + R2 + R3 + R4 + R5 + R6 + R7 + R8 + R9, R10, p);
+  int value = 0;
+  if (state->speed > p[1] && state->closest < p[2] && state->closestAngle > p[3] && state->closestAngle <= 180)
+  {
+    value = 1;
+  }
+  // if the ship is already facing the furthest area, then turn away from nearby geometries
+  else if (state->speed > p[1] && state->closest < p[2] && state->closestAngle < 360 - p[3] && state->closestAngle > 180)
+  {
+    value = -1;
+  }
+  return (Inference){p[0], value};
+}
+#define R11 4
+static inline Inference tr5(const State *state, const Chromosome *chromosome)
+{
+  uint8_t p[R11];
+  readNParams(chromosome, R1 + R2 + R3 + R4 + R5 + R6 + R7 + R8 + R9 + R10, R11, p);
+  int value = 0;
+  if ((state->furthestAngle > p[1] && state->furthestAngle <= 180))
+  {
+    value = -1;
+  }
+  // Always try to face the furthest area
+  else if ((state->furthestAngle < 360 - p[1] && state->furthestAngle > 180))
+  {
+    value = 1;
+  }
+  return (Inference){p[0], value};
+}
+
+// total chromosome length in bits
+#define GA_RULES_BITS ((R1 + R2 + R3 + R4 + R5 + R6 + R7 + R8 + R9 + R10 + R11) * GA_PARAM_BITS)
+
+// Highest-priority rule wins in each group.
+// turnDir: turn right = 1, turn left = -1, turn to aimdir = 2
+static inline void gaRulesDecide(const State *s, const Chromosome *chromosome, int *shouldThrust, int *turnDir)
+{
+  static Inference (*const thrusterRules[])(const State *, const Chromosome *) = {
+      rp1, rp2, rp3, rp4, rp5, rp6,
+  };
+  static Inference (*const turnRules[])(const State *, const Chromosome *) = {
+      tr1, tr2, tr3, tr4, tr5,
+      // add more here
+  };
+
+  *shouldThrust = 0;
+  *turnDir = 0;
+  int prioThrust = 0;
+  for (unsigned i = 0; i < sizeof(thrusterRules) / sizeof(thrusterRules[0]); i++)
+  {
+    Inference inf = thrusterRules[i](s, chromosome);
+    if (prioThrust < inf.priority)
+    {
+      prioThrust = inf.priority;
+      *shouldThrust = inf.result;
+    }
+  }
+  int prioTurn = 0;
+  for (unsigned i = 0; i < sizeof(turnRules) / sizeof(turnRules[0]); i++)
+  {
+    Inference inf = turnRules[i](s, chromosome);
+    if (prioTurn < inf.priority)
+    {
+      prioTurn = inf.priority;
+      *turnDir = inf.result;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,41 @@
+// Bit-flip mutation for packed chromosomes.  Instead of one random draw per
+// gene, the distance to the next flipped gene is drawn from the geometric
+// distribution of a per-gene flip probability mr, so a call costs one draw
+// per flip (about mr * L) rather than L.
+#ifndef GENEMUTATE_H
+#define GENEMUTATE_H
+
+#include <math.h>
+#include "chromosome.h"
+#include "rng.h"
+
+/* genes skipped before the next flip: floor(log(U) / log(1 - mr)), U in (0, 1] */
+static inline double geneMutateGap(Rng *r, double invLogKeep)
+{
+    double u = 1.0 - rngDouble(r);
+    return floor(log(u) * invLogKeep);
+}
+
+/* flips each of the L genes independently with probability mr, returns the number flipped */
+static inline int geneMutate(Chromosome *c, int L, double mr, Rng *r)
+{
+    if (mr <= 0.0 || L <= 0) return 0;
+    if (mr >= 1.0) {
+        int n = GENE_WORDS(L);
+        for (int w = 0; w < n; ++w) c->genes[w] = ~c->genes[w];
+        c->genes[n - 1] &= geneTailMask(L);
+        return L;
+    }
+    double invLogKeep = 1.0 / log1p(-mr);
+    int flips = 0;
+    double pos = geneMutateGap(r, invLogKeep);
+    while (pos < L) {
+        int i = (int)pos;
+        c->genes[i / GENE_WORD_BITS] ^= (gene_word_t)1 << (i % GENE_WORD_BITS);
+        ++flips;
+        pos += 1.0 + geneMutateGap(r, invLogKeep);
+    }
+    return flips;
+}
+
+#endif
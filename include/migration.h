@@ -0,0 +1,81 @@
+// Migrant queue between two GA islands: a single-producer single-consumer
+// ring of Chromosome copies.  The sending island pushes its best individuals
+// every few generations and the receiving one takes whatever has arrived
+// when it next looks, so islands never wait for each other.  Head and tail
+// are the only shared state, each written by one side only (release) and
+// read by the other (acquire), on their own cache lines.
+#ifndef MIGRATION_H
+#define MIGRATION_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chromosome.h"
+
+typedef struct {
+    alignas(64) atomic_uint head; /* next slot to write, producer only */
+    alignas(64) atomic_uint tail; /* next slot to read, consumer only */
+    alignas(64) unsigned capacity; /* slots, a power of two */
+    int words;                     /* gene words per slot */
+    gene_word_t *genes;
+    int *fitness;
+} MigrationRing;
+
+/* room for at least slots migrants of geneLength genes.  Returns 0, or -1 when out of memory. */
+static inline int migrationRingInit(MigrationRing *r, int slots, int geneLength)
+{
+    unsigned cap = 1;
+    while (cap < (unsigned)(slots > 0 ? slots : 1)) cap <<= 1;
+    memset(r, 0, sizeof *r);
+    r->capacity = cap;
+    r->words = GENE_WORDS(geneLength);
+    r->genes = calloc((size_t)cap * r->words, sizeof(gene_word_t));
+    r->fitness = calloc(cap, sizeof(int));
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    if (!r->genes || !r->fitness) {
+        free(r->genes);
+        free(r->fitness);
+        r->genes = NULL;
+        r->fitness = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static inline void migrationRingFree(MigrationRing *r)
+{
+    free(r->genes);
+    free(r->fitness);
+    r->genes = NULL;
+    r->fitness = NULL;
+}
+
+/* producer: queues a copy of c, returns -1 (and drops it) when the ring is full */
+static inline int migrationPush(MigrationRing *r, const Chromosome *c)
+{
+    unsigned head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head - tail == r->capacity) return -1;
+    unsigned s = head & (r->capacity - 1);
+    memcpy(r->genes + (size_t)s * r->words, c->genes, (size_t)r->words * sizeof(gene_word_t));
+    r->fitness[s] = c->fitness;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    return 0;
+}
+
+/* consumer: moves the oldest migrant into c, returns -1 when none is waiting */
+static inline int migrationPop(MigrationRing *r, Chromosome *c)
+{
+    unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (head == tail) return -1;
+    unsigned s = tail & (r->capacity - 1);
+    memcpy(c->genes, r->genes + (size_t)s * r->words, (size_t)r->words * sizeof(gene_word_t));
+    c->fitness = r->fitness[s];
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+#endif
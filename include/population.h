@@ -0,0 +1,93 @@
+// A GA population in one allocation: two generations (the current one and
+// the one being bred) of Chromosome headers and gene words, so reproduction
+// writes into the other buffer and a generation change is a pointer swap
+// instead of per-individual malloc/free.
+//
+// pop[] is the current generation in whatever order selectionElites() left it;
+// next[] is the other buffer in slot order, so after populationSwap() the
+// current generation sits linearly in memory again.
+#ifndef POPULATION_H
+#define POPULATION_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "chromosome.h"
+
+#define POPULATION_ALIGN 64
+
+typedef struct {
+    int size;          /* individuals per generation */
+    int geneLength;
+    int words;         /* gene words per individual, the stride of genes */
+    void *arena;       /* the one allocation, NULL when empty */
+    Chromosome **pop;  /* current generation */
+    Chromosome **next; /* generation being bred, slot order */
+    Chromosome *slots[2];
+    int cur;           /* which of slots[] pop points into */
+} Population;
+
+static inline void populationFree(Population *p)
+{
+    free(p->arena);
+    memset(p, 0, sizeof *p);
+}
+
+static inline void populationOrder(Population *p)
+{
+    Chromosome **order[2] = {p->pop, p->next};
+    for (int b = 0; b < 2; ++b) {
+        Chromosome *s = p->slots[p->cur ^ b];
+        for (int i = 0; i < p->size; ++i) order[b][i] = &s[i];
+    }
+}
+
+/* (Re)shapes p for size individuals of geneLength genes, all genes 0.
+   Keeps the arena when the shape is unchanged.  Returns 0, or -1 when out of memory. */
+static inline int populationInit(Population *p, int size, int geneLength)
+{
+    if (size <= 0 || geneLength <= 0) return -1;
+    int words = GENE_WORDS(geneLength);
+    /* stride rounded up to a cache line so individuals do not share lines */
+    int stride = (words + POPULATION_ALIGN / 8 - 1) / (POPULATION_ALIGN / 8) * (POPULATION_ALIGN / 8);
+    size_t geneBytes = (size_t)2 * size * stride * sizeof(gene_word_t);
+    size_t headBytes = (size_t)2 * size * sizeof(Chromosome);
+    size_t ptrBytes = (size_t)2 * size * sizeof(Chromosome *);
+    size_t total = geneBytes + headBytes + ptrBytes;
+    total = (total + POPULATION_ALIGN - 1) / POPULATION_ALIGN * POPULATION_ALIGN;
+
+    if (p->arena && p->size == size && p->geneLength == geneLength) {
+        memset(p->arena, 0, geneBytes + headBytes);
+    } else {
+        void *arena = aligned_alloc(POPULATION_ALIGN, total);
+        if (!arena) return -1;
+        free(p->arena);
+        memset(arena, 0, total);
+        p->arena = arena;
+    }
+    p->size = size;
+    p->geneLength = geneLength;
+    p->words = stride;
+    p->cur = 0;
+
+    gene_word_t *genes = p->arena;
+    Chromosome *heads = (Chromosome *)((char *)p->arena + geneBytes);
+    Chromosome **ptrs = (Chromosome **)((char *)heads + headBytes);
+    for (int b = 0; b < 2; ++b) {
+        p->slots[b] = heads + (size_t)b * size;
+        for (int i = 0; i < size; ++i)
+            p->slots[b][i].genes = genes + ((size_t)b * size + i) * stride;
+    }
+    p->pop = ptrs;
+    p->next = ptrs + size;
+    populationOrder(p);
+    return 0;
+}
+
+/* next[] becomes the current generation */
+static inline void populationSwap(Population *p)
+{
+    p->cur ^= 1;
+    populationOrder(p);
+}
+
+#endif
@@ -0,0 +1,426 @@
+// Precomputed wall feelers for a map.  sim/mkrayatlas casts, from a grid of
+// sample points (RAY_ATLAS_SUB per block side), one ray per whole degree and
+// stores the length.  The file is mmapped read-only and a feeler from any
+// position is interpolated from the four samples around it, so a sweep costs
+// a few table reads per ray instead of a walk to the wall.
+// Each sample's reading is first moved along the ray to the query position
+// (a sample ahead of the ship sees the wall that much closer), then the four
+// are weighted bilinearly.  That is exact while all four rays end on the same
+// wall line; when they do not (a pillar's edge, a corner) the ray is walked
+// through the block grid the file also keeps.  So is every ray from a cell
+// that touches a wall block or has a sample inside or behind a wall: the
+// samples left can interpolate straight past the corner next to the ship.
+// The AVX2 path does 8 rays per iteration and is picked at run time, the
+// scalar one gives the same results.
+// Coordinates are the server's: pixels, y up, outside the map is wall.
+#ifndef RAYATLAS_H
+#define RAYATLAS_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RAY_ATLAS_X86 1
+#endif
+
+#define RAY_ATLAS_MAGIC "XPRA"
+#define RAY_ATLAS_VERSION 1
+#define RAY_ATLAS_SUB 2      // samples per block side
+#define RAY_ATLAS_ANGLES 360 // one ray per whole degree, like wallFeeler
+#define RAY_ATLAS_SCALE 8    // stored lengths are in 1/8 pixel
+#define RAY_ATLAS_EDGE 0.5f  // hit points further off one wall line than this are on different walls
+
+typedef struct
+{
+  char magic[4];
+  int32_t version;
+  int32_t w, h;    // map size in blocks
+  int32_t sub;     // samples per block side, the grid is (w*sub+1) x (h*sub+1)
+  int32_t block;   // pixels per block side
+  int32_t maxDist; // longest ray cast, readings are capped to it
+  int32_t angles;  // RAY_ATLAS_ANGLES
+} RayAtlasHeader;
+
+// the header is followed by the map's blocks (w*h bytes, row 0 at the
+// bottom, 1 = wall, padded to a multiple of 4), then for each sample, row 0
+// at the bottom, angles uint16 readings in 1/RAY_ATLAS_SCALE pixels (0 =
+// sample inside a wall), then two bytes of padding so a 32-bit gather of the
+// last reading stays in the file
+
+typedef struct
+{
+  const RayAtlasHeader *hdr;
+  const uint8_t *blocks;
+  const uint16_t *len;
+  size_t size; // bytes mapped, 0 = not loaded
+  float samplePx;
+} RayAtlas;
+
+#define RAY_ATLAS_BLOCKS_SIZE(w, h) (((size_t)(w) * (h) + 3) & ~(size_t)3)
+
+static float rayAtlasCos[RAY_ATLAS_ANGLES], rayAtlasSin[RAY_ATLAS_ANGLES];
+static double rayAtlasCosD[RAY_ATLAS_ANGLES], rayAtlasSinD[RAY_ATLAS_ANGLES]; // for the block walk
+
+static inline void rayAtlasTable(void)
+{
+  static int ready = 0;
+  if (ready)
+    return;
+  for (int k = 0; k < RAY_ATLAS_ANGLES; k++)
+  {
+    rayAtlasCosD[k] = cos(k * M_PI / 180.0);
+    rayAtlasSinD[k] = sin(k * M_PI / 180.0);
+    rayAtlasCos[k] = (float)rayAtlasCosD[k];
+    rayAtlasSin[k] = (float)rayAtlasSinD[k];
+  }
+  ready = 1;
+}
+
+static inline int rayAtlasAngle(int a)
+{
+  return a >= 0 && a < RAY_ATLAS_ANGLES ? a : (a % RAY_ATLAS_ANGLES + RAY_ATLAS_ANGLES) % RAY_ATLAS_ANGLES;
+}
+
+static inline int rayAtlasMap(RayAtlas *ra, const char *path)
+{
+  memset(ra, 0, sizeof *ra);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RayAtlasHeader))
+  {
+    close(fd);
+    return -1;
+  }
+  void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return -1;
+  const RayAtlasHeader *h = p;
+  size_t n = (size_t)(h->w * h->sub + 1) * (h->h * h->sub + 1) * RAY_ATLAS_ANGLES;
+  if (memcmp(h->magic, RAY_ATLAS_MAGIC, 4) != 0 || h->version != RAY_ATLAS_VERSION || h->w <= 0 || h->h <= 0 ||
+      h->sub <= 0 || h->block <= 0 || h->maxDist <= 0 || h->angles != RAY_ATLAS_ANGLES ||
+      (size_t)st.st_size < sizeof *h + RAY_ATLAS_BLOCKS_SIZE(h->w, h->h) + 2 * n + 2)
+  {
+    munmap(p, (size_t)st.st_size);
+    return -1;
+  }
+  rayAtlasTable();
+  ra->hdr = h;
+  ra->blocks = (const uint8_t *)(h + 1);
+  ra->len = (const uint16_t *)(ra->blocks + RAY_ATLAS_BLOCKS_SIZE(h->w, h->h));
+  ra->size = (size_t)st.st_size;
+  ra->samplePx = (float)h->block / h->sub;
+  return 0;
+}
+
+static inline void rayAtlasUnmap(RayAtlas *ra)
+{
+  if (ra->size)
+    munmap((void *)ra->hdr, ra->size);
+  memset(ra, 0, sizeof *ra);
+}
+
+// Takes "-rayatlas file" out of the command line (the live client would
+// reject it) and maps the file.  Returns 0 when an atlas was loaded.
+static inline int rayAtlasArgs(RayAtlas *ra, int *argc, char *argv[])
+{
+  int found = -1;
+  memset(ra, 0, sizeof *ra);
+  for (int i = 1; i + 1 < *argc; i++)
+  {
+    if (strcmp(argv[i], "-rayatlas") != 0)
+      continue;
+    found = rayAtlasMap(ra, argv[i + 1]);
+    for (int j = i; j + 2 <= *argc; j++)
+      argv[j] = argv[j + 2];
+    *argc -= 2;
+    break;
+  }
+  return found;
+}
+
+// The four samples around a position, shared by every ray of one call.
+typedef struct
+{
+  int base[4];    // index of each sample's angle 0 reading
+  float w[4];     // bilinear weight, 0 for samples inside a wall
+  float ox[4], oy[4]; // sample minus query position
+  double x, y;    // query position
+  float lim;      // min(dist, maxDist)
+  int capRaw;     // stored reading of a ray that hit nothing
+  int walk;       // 1: next to a wall, every ray is walked
+} RayAtlasCell;
+
+// Returns 0 when the position is inside a wall or off the map.
+static inline int rayAtlasCell(const RayAtlas *ra, double x, double y, int dist, RayAtlasCell *c)
+{
+  const RayAtlasHeader *h = ra->hdr;
+  int gw = h->w * h->sub, gh = h->h * h->sub;
+  float fx = (float)(x / ra->samplePx), fy = (float)(y / ra->samplePx);
+  if (!(fx >= 0.0f && fy >= 0.0f && fx <= gw && fy <= gh))
+    return 0;
+  int i = (int)fx, j = (int)fy;
+  if (i >= gw)
+    i = gw - 1;
+  if (j >= gh)
+    j = gh - 1;
+  float tx = fx - i, ty = fy - j, total = 0.0f;
+  // a wall block touching the cell, off the map included
+  const double B = h->block;
+  int bx0 = (int)floor((i * ra->samplePx - 1.0) / B), bx1 = (int)floor(((i + 1) * ra->samplePx + 1.0) / B);
+  int by0 = (int)floor((j * ra->samplePx - 1.0) / B), by1 = (int)floor(((j + 1) * ra->samplePx + 1.0) / B);
+  c->walk = 0;
+  for (int by = by0; by <= by1; by++)
+    for (int bx = bx0; bx <= bx1; bx++)
+      if (bx < 0 || by < 0 || bx >= h->w || by >= h->h || ra->blocks[by * h->w + bx])
+        c->walk = 1;
+  for (int k = 0; k < 4; k++)
+  {
+    int si = i + (k & 1), sj = j + (k >> 1);
+    c->base[k] = (sj * (gw + 1) + si) * RAY_ATLAS_ANGLES;
+    c->ox[k] = (float)(si * ra->samplePx - x);
+    c->oy[k] = (float)(sj * ra->samplePx - y);
+    c->w[k] = ((k & 1) ? tx : 1.0f - tx) * ((k >> 1) ? ty : 1.0f - ty);
+    // a sample that cannot see the ship (inside a wall, or behind one) says
+    // nothing about what the ship sees
+    float back = sqrtf(c->ox[k] * c->ox[k] + c->oy[k] * c->oy[k]);
+    int toShip = (int)lroundf(atan2f(-c->oy[k], -c->ox[k]) * (float)(180.0 / M_PI));
+    toShip = (toShip % RAY_ATLAS_ANGLES + RAY_ATLAS_ANGLES) % RAY_ATLAS_ANGLES;
+    if (ra->len[c->base[k]] == 0 || ra->len[c->base[k] + toShip] * (1.0f / RAY_ATLAS_SCALE) < back - 1.0f)
+    {
+      c->w[k] = 0.0f;
+      c->walk = 1;
+    }
+    total += c->w[k];
+  }
+  if (total <= 0.0f)
+    return 0;
+  for (int k = 0; k < 4; k++)
+    c->w[k] /= total;
+  c->x = x;
+  c->y = y;
+  c->lim = (float)(dist < h->maxDist ? dist : h->maxDist);
+  c->capRaw = h->maxDist * RAY_ATLAS_SCALE;
+  return 1;
+}
+
+// Samples that disagree straddle a depth edge (the side of a pillar, a
+// corner) and interpolating between them is meaningless, so such rays are
+// walked block by block through the map kept in the file.
+static inline float rayAtlasCast(const RayAtlas *ra, const RayAtlasCell *c, double cs, double sn)
+{
+  const double B = ra->hdr->block;
+  double x = c->x, y = c->y;
+  int bx = (int)floor(x / B), by = (int)floor(y / B);
+  if (bx < 0 || by < 0 || bx >= ra->hdr->w || by >= ra->hdr->h || ra->blocks[by * ra->hdr->w + bx])
+    return 0.0f;
+  int stepX = cs > 0 ? 1 : (cs < 0 ? -1 : 0);
+  int stepY = sn > 0 ? 1 : (sn < 0 ? -1 : 0);
+  double tMaxX = stepX > 0 ? ((bx + 1) * B - x) / cs : stepX < 0 ? (bx * B - x) / cs : INFINITY;
+  double tMaxY = stepY > 0 ? ((by + 1) * B - y) / sn : stepY < 0 ? (by * B - y) / sn : INFINITY;
+  double tDeltaX = stepX ? B / fabs(cs) : INFINITY;
+  double tDeltaY = stepY ? B / fabs(sn) : INFINITY;
+  for (;;)
+  {
+    double t;
+    if (tMaxX < tMaxY)
+    {
+      t = tMaxX;
+      tMaxX += tDeltaX;
+      bx += stepX;
+    }
+    else
+    {
+      t = tMaxY;
+      tMaxY += tDeltaY;
+      by += stepY;
+    }
+    if (t > c->lim)
+      return c->lim;
+    if (bx < 0 || by < 0 || bx >= ra->hdr->w || by >= ra->hdr->h || ra->blocks[by * ra->hdr->w + bx])
+      return (float)t;
+  }
+}
+
+static inline int rayAtlasRay(const RayAtlas *ra, const RayAtlasCell *c, int a)
+{
+  if (c->walk)
+    return (int)rayAtlasCast(ra, c, rayAtlasCosD[a], rayAtlasSinD[a]);
+  float cs = rayAtlasCos[a], sn = rayAtlasSin[a], d = 0.0f;
+  float xLo = INFINITY, xHi = -INFINITY, yLo = INFINITY, yHi = -INFINITY;
+  int far = 0, near = 0;
+  for (int k = 0; k < 4; k++)
+  {
+    int raw = ra->len[c->base[k] + a];
+    float len = raw * (1.0f / RAY_ATLAS_SCALE);
+    float v = len + c->ox[k] * cs + c->oy[k] * sn;
+    d += c->w[k] * v;
+    if (c->w[k] <= 0.0f)
+      continue;
+    // nothing within the feeler, or nothing within the whole cast
+    if (v >= c->lim || raw == c->capRaw)
+    {
+      far++;
+      continue;
+    }
+    near++;
+    // where this sample's ray ended, relative to the ship
+    float hx = c->ox[k] + len * cs, hy = c->oy[k] + len * sn;
+    xLo = hx < xLo ? hx : xLo;
+    xHi = hx > xHi ? hx : xHi;
+    yLo = hy < yLo ? hy : yLo;
+    yHi = hy > yHi ? hy : yHi;
+  }
+  if (near && (far || (xHi - xLo > RAY_ATLAS_EDGE && yHi - yLo > RAY_ATLAS_EDGE)))
+    return (int)rayAtlasCast(ra, c, rayAtlasCosD[a], rayAtlasSinD[a]);
+  d = d < 0.0f ? 0.0f : d > c->lim ? c->lim : d;
+  return (int)d;
+}
+
+#ifdef RAY_ATLAS_X86
+// angles already reduced to [0, 360), count a multiple of 8
+__attribute__((target("avx2"))) static inline void rayAtlasRaysAVX2(const RayAtlas *ra, const RayAtlasCell *c,
+                                                                   const int *angles, int count, int *out)
+{
+  const __m256i mask = _mm256_set1_epi32(0xffff), iota = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256 scale = _mm256_set1_ps(1.0f / RAY_ATLAS_SCALE), zero = _mm256_setzero_ps();
+  const __m256 lim = _mm256_set1_ps(c->lim), edge = _mm256_set1_ps(RAY_ATLAS_EDGE);
+  const __m256 inf = _mm256_set1_ps(INFINITY), ninf = _mm256_set1_ps(-INFINITY);
+  const __m256i cap = _mm256_set1_epi32(c->capRaw);
+  if (c->walk)
+  {
+    for (int n = 0; n < count; n++)
+      out[n] = -1;
+    return;
+  }
+  for (int n = 0; n < count; n += 8)
+  {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(angles + n));
+    // a sweep's angles are mostly consecutive, then plain loads do instead of gathers
+    int run = angles[n + 7] - angles[n] == 7 &&
+              _mm256_movemask_epi8(_mm256_cmpeq_epi32(a, _mm256_add_epi32(_mm256_set1_epi32(angles[n]), iota))) == -1;
+    __m256 cs = run ? _mm256_loadu_ps(rayAtlasCos + angles[n]) : _mm256_i32gather_ps(rayAtlasCos, a, 4);
+    __m256 sn = run ? _mm256_loadu_ps(rayAtlasSin + angles[n]) : _mm256_i32gather_ps(rayAtlasSin, a, 4);
+    __m256 d = zero, far = zero, near = zero;
+    __m256 xLo = inf, xHi = ninf, yLo = inf, yHi = ninf;
+    for (int k = 0; k < 4; k++)
+    {
+      __m256i raw;
+      if (run)
+        raw = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(ra->len + c->base[k] + angles[n])));
+      else
+        raw = _mm256_and_si256(
+            _mm256_i32gather_epi32((const int *)ra->len, _mm256_add_epi32(a, _mm256_set1_epi32(c->base[k])), 2), mask);
+      __m256 len = _mm256_mul_ps(_mm256_cvtepi32_ps(raw), scale);
+      __m256 ox = _mm256_set1_ps(c->ox[k]), oy = _mm256_set1_ps(c->oy[k]);
+      __m256 v = _mm256_add_ps(len, _mm256_mul_ps(ox, cs));
+      v = _mm256_add_ps(v, _mm256_mul_ps(oy, sn));
+      d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(c->w[k]), v));
+      if (c->w[k] <= 0.0f)
+        continue;
+      __m256 isFar = _mm256_or_ps(_mm256_cmp_ps(v, lim, _CMP_GE_OQ), _mm256_castsi256_ps(_mm256_cmpeq_epi32(raw, cap)));
+      far = _mm256_or_ps(far, isFar);
+      near = _mm256_or_ps(near, _mm256_andnot_ps(isFar, _mm256_castsi256_ps(_mm256_set1_epi32(-1))));
+      __m256 hx = _mm256_add_ps(ox, _mm256_mul_ps(len, cs)), hy = _mm256_add_ps(oy, _mm256_mul_ps(len, sn));
+      xLo = _mm256_min_ps(xLo, _mm256_blendv_ps(hx, inf, isFar));
+      xHi = _mm256_max_ps(xHi, _mm256_blendv_ps(hx, ninf, isFar));
+      yLo = _mm256_min_ps(yLo, _mm256_blendv_ps(hy, inf, isFar));
+      yHi = _mm256_max_ps(yHi, _mm256_blendv_ps(hy, ninf, isFar));
+    }
+    __m256 apart = _mm256_and_ps(_mm256_cmp_ps(_mm256_sub_ps(xHi, xLo), edge, _CMP_GT_OQ),
+                                 _mm256_cmp_ps(_mm256_sub_ps(yHi, yLo), edge, _CMP_GT_OQ));
+    // edge rays come back as -1 and are cast by the caller: the block walk
+    // is plain SSE code and calling it from here would pay for every switch
+    __m256 isEdge = _mm256_and_ps(near, _mm256_or_ps(far, apart));
+    d = _mm256_blendv_ps(_mm256_min_ps(_mm256_max_ps(d, zero), lim), _mm256_set1_ps(-1.0f), isEdge);
+    _mm256_storeu_si256((__m256i *)(out + n), _mm256_cvttps_epi32(d));
+  }
+}
+#endif
+
+// out[i] = wall distance at angles[i] degrees from (x, y), at most dist (and
+// at most the atlas' maxDist), 0 inside a wall.
+static inline void rayAtlasFeelers(const RayAtlas *ra, double x, double y, int dist, const int *angles, int count,
+                                   int *out)
+{
+  RayAtlasCell c;
+  if (!rayAtlasCell(ra, x, y, dist, &c))
+  {
+    for (int i = 0; i < count; i++)
+      out[i] = 0;
+    return;
+  }
+  int done = 0;
+#ifdef RAY_ATLAS_X86
+  static int avx2 = -1;
+  if (avx2 < 0)
+    avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+  if (avx2 && !c.walk)
+  {
+    int red[64];
+    while (count - done >= 8)
+    {
+      int n = count - done < 64 ? (count - done) & ~7 : 64;
+      for (int i = 0; i < n; i++)
+        red[i] = rayAtlasAngle(angles[done + i]);
+      rayAtlasRaysAVX2(ra, &c, red, n, out + done);
+      for (int i = 0; i < n; i++)
+        if (out[done + i] < 0)
+          out[done + i] = (int)rayAtlasCast(ra, &c, rayAtlasCosD[red[i]], rayAtlasSinD[red[i]]);
+      done += n;
+    }
+  }
+#endif
+  for (; done < count; done++)
+    out[done] = rayAtlasRay(ra, &c, rayAtlasAngle(angles[done]));
+}
+
+static inline int rayAtlasFeeler(const RayAtlas *ra, double x, double y, int dist, int angleDeg)
+{
+  int d;
+  rayAtlasFeelers(ra, x, y, dist, &angleDeg, 1, &d);
+  return d;
+}
+
+// Same contract as sweepWalls() in wallSweep.h: out[i] is the feeler at
+// startDeg + i*stepDeg, ties go to the lowest index.
+static inline int rayAtlasSweep(const RayAtlas *ra, double x, double y, int dist, int startDeg, int stepDeg, int count,
+                                int out[], int *minIdx, int *maxIdx)
+{
+  int angles[64];
+  int a = rayAtlasAngle(startDeg), step = rayAtlasAngle(stepDeg);
+  for (int done = 0; done < count; done += 64)
+  {
+    int n = count - done < 64 ? count - done : 64;
+    for (int i = 0; i < n; i++)
+    {
+      angles[i] = a;
+      a += step;
+      if (a >= RAY_ATLAS_ANGLES)
+        a -= RAY_ATLAS_ANGLES;
+    }
+    rayAtlasFeelers(ra, x, y, dist, angles, n, out + done);
+  }
+  int lo = 0, hi = 0;
+  for (int i = 1; i < count; i++)
+  {
+    if (out[i] < out[lo])
+      lo = i;
+    if (out[i] > out[hi])
+      hi = i;
+  }
+  if (minIdx)
+    *minIdx = lo;
+  if (maxIdx)
+    *maxIdx = hi;
+  return count;
+}
+
+#endif
@@ -0,0 +1,117 @@
+// xoshiro256** random numbers with explicit state, so every thread (or
+// every island, individual ...) can own a generator instead of sharing the
+// global rand() state.  Seeds go through splitmix64 so nearby seeds still
+// give unrelated streams.
+//
+// For reproducible runs, work is not handed one shared generator: each
+// piece gets its own stream from rngStream(seed, stream, a, b), e.g.
+// (experiment seed, "reproduce", generation, individual).  A stream does
+// not depend on which thread runs it or in what order, so the results
+// are the same at any thread count.
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+static inline uint64_t rngSplitMix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline void rngSeed(Rng *r, uint64_t seed)
+{
+    for (int i = 0; i < 4; ++i) r->s[i] = rngSplitMix64(&seed);
+}
+
+/* splitmix64 finaliser of one value */
+static inline uint64_t rngMix(uint64_t x)
+{
+    return rngSplitMix64(&x);
+}
+
+/* the generator for key (seed, stream, a, b), built directly from the key */
+static inline void rngStream(Rng *r, uint64_t seed, uint64_t stream, uint64_t a, uint64_t b)
+{
+    uint64_t k = rngMix(seed);
+    k = rngMix(k ^ stream);
+    k = rngMix(k ^ a);
+    k = rngMix(k ^ b);
+    rngSeed(r, k);
+}
+
+static inline uint64_t rngRotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rngNext(Rng *r)
+{
+    uint64_t *s = r->s;
+    uint64_t result = rngRotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rngRotl(s[3], 45);
+    return result;
+}
+
+/* uniform in [0, 1) with 53 random bits */
+static inline double rngDouble(Rng *r)
+{
+    return (double)(rngNext(r) >> 11) * 0x1.0p-53;
+}
+
+/* uniform in [0, n), n > 0 */
+static inline uint32_t rngBelow(Rng *r, uint32_t n)
+{
+    return (uint32_t)(((rngNext(r) >> 32) * (uint64_t)n) >> 32);
+}
+
+/* advances r by 2^128 draws: rngJump'ing copies of one generator gives
+   non-overlapping sequences, e.g. one per thread */
+static inline void rngJump(Rng *r)
+{
+    static const uint64_t JUMP[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                    0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+    uint64_t t[4] = {0, 0, 0, 0};
+    for (int i = 0; i < 4; ++i) {
+        for (int b = 0; b < 64; ++b) {
+            if (JUMP[i] & ((uint64_t)1 << b))
+                for (int k = 0; k < 4; ++k) t[k] ^= r->s[k];
+            rngNext(r);
+        }
+    }
+    memcpy(r->s, t, sizeof t);
+}
+
+/* Takes "-rngseed S" out of a bot's command line (the live client would
+   reject it) and seeds r with it, or with the clock when it is not given.
+   Returns the seed so it can be printed and the run repeated. */
+static inline uint64_t rngSeedArgs(Rng *r, int *argc, char *argv[])
+{
+    uint64_t seed = (uint64_t)time(NULL);
+    for (int i = 1; i + 1 < *argc; i++) {
+        if (strcmp(argv[i], "-rngseed") != 0) continue;
+        seed = strtoull(argv[i + 1], NULL, 10);
+        for (int j = i; j + 2 <= *argc; j++) argv[j] = argv[j + 2];
+        *argc -= 2;
+        break;
+    }
+    rngSeed(r, seed);
+    return seed;
+}
+
+#endif
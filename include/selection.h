@@ -0,0 +1,259 @@
+// Selection on a compact (fitness, index) key array instead of sorting the
+// Chromosome pointers.  Reproduction only needs the elites in order, so
+// selectionElites() finds the best k with introselect (quickselect that
+// falls back to a bounded heap when partitions go bad), sorts just those k
+// and leaves the rest of the population in place: O(n + k log k) per
+// generation instead of a full qsort with an indirect comparator.
+//
+// Parents are drawn from the same keys: uniformly among the elites (the
+// classic behaviour), by k-way tournament, or by linear rank.  Rank
+// selection uses the fact that a binary tournament whose better entrant
+// wins with probability p gives the same distribution as linear ranking
+// with pressure 2p, so it needs no ranks and no sort either.
+//
+// Keys order by fitness, ties by index, so every result is deterministic.
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "chromosome.h"
+#include "rng.h"
+
+typedef enum {
+    SELECT_ELITE,      /* uniform among the elites */
+    SELECT_TOURNAMENT, /* best of tournament individuals of the whole population */
+    SELECT_RANK        /* linear ranking, see above */
+} SelectMode;
+
+typedef struct {
+    int fitness;
+    int index;
+} SelKey;
+
+typedef struct {
+    SelKey *keys;      /* keys[i] belongs to pop[i] after selectionElites() */
+    Chromosome **tmp;
+    int size, capacity;
+    SelectMode mode;
+    int tournament;    /* entrants per tournament, >= 2 */
+    double pressure;   /* rank selection pressure in [1, 2] */
+} Selection;
+
+/* "elite", "tournament" or "rank"; -1 when unknown */
+static inline int selectionParse(const char *s)
+{
+    if (strcmp(s, "elite") == 0) return SELECT_ELITE;
+    if (strcmp(s, "tournament") == 0) return SELECT_TOURNAMENT;
+    if (strcmp(s, "rank") == 0) return SELECT_RANK;
+    return -1;
+}
+
+static inline void selectionDefaults(Selection *s)
+{
+    memset(s, 0, sizeof *s);
+    s->mode = SELECT_ELITE;
+    s->tournament = 2;
+    s->pressure = 1.8;
+}
+
+/* tournament in [2, population], pressure in [1, 2]: a larger tournament only
+   ever picks the best, a pressure outside favours the worst */
+static inline void selectionClamp(Selection *s, int population)
+{
+    if (s->tournament > population) s->tournament = population;
+    if (s->tournament < 2) s->tournament = 2;
+    if (!(s->pressure >= 1.0)) s->pressure = 1.0;
+    if (s->pressure > 2.0) s->pressure = 2.0;
+}
+
+static inline void selectionFree(Selection *s)
+{
+    free(s->keys);
+    free(s->tmp);
+    s->keys = NULL;
+    s->tmp = NULL;
+    s->size = s->capacity = 0;
+}
+
+/* key and pointer buffers for n individuals, returns 0 or -1 when out of memory */
+static inline int selectionReserve(Selection *s, int n)
+{
+    if (n <= s->capacity) return 0;
+    SelKey *keys = realloc(s->keys, (size_t)n * sizeof *keys);
+    if (!keys) return -1;
+    s->keys = keys;
+    Chromosome **tmp = realloc(s->tmp, (size_t)n * sizeof *tmp);
+    if (!tmp) return -1;
+    s->tmp = tmp;
+    s->capacity = n;
+    return 0;
+}
+
+/* a ranks before b */
+static inline int selKeyBefore(SelKey a, SelKey b)
+{
+    return a.fitness > b.fitness || (a.fitness == b.fitness && a.index < b.index);
+}
+
+static inline void selKeySwap(SelKey *k, int i, int j)
+{
+    SelKey t = k[i];
+    k[i] = k[j];
+    k[j] = t;
+}
+
+/* max-heap on "ranks after", so k[0] is the worst of the heap */
+static inline void selHeapDown(SelKey *k, int n, int i)
+{
+    for (;;) {
+        int l = 2 * i + 1, w = i;
+        if (l < n && selKeyBefore(k[w], k[l])) w = l;
+        if (l + 1 < n && selKeyBefore(k[w], k[l + 1])) w = l + 1;
+        if (w == i) return;
+        selKeySwap(k, i, w);
+        i = w;
+    }
+}
+
+/* moves the best m of k[0..n) to k[0..m), unordered: keep the m best in a heap */
+static inline void selHeapSelect(SelKey *k, int n, int m)
+{
+    for (int i = m / 2 - 1; i >= 0; --i) selHeapDown(k, m, i);
+    for (int i = m; i < n; ++i) {
+        if (selKeyBefore(k[i], k[0])) {
+            selKeySwap(k, 0, i);
+            selHeapDown(k, m, 0);
+        }
+    }
+}
+
+/* moves the best m of k[0..n) to k[0..m), unordered */
+static inline void selIntroselect(SelKey *k, int n, int m)
+{
+    int lo = 0, hi = n; /* the boundary m lies in [lo, hi) */
+    int depth = 0;
+    for (int t = n; t > 1; t >>= 1) depth += 2;
+    while (hi - lo > 16) {
+        if (depth-- == 0) {
+            selHeapSelect(k + lo, hi - lo, m - lo);
+            return;
+        }
+        /* median of three as pivot, Lomuto partition, better keys first */
+        int mid = lo + (hi - lo) / 2;
+        if (selKeyBefore(k[mid], k[lo])) selKeySwap(k, mid, lo);
+        if (selKeyBefore(k[hi - 1], k[lo])) selKeySwap(k, hi - 1, lo);
+        if (selKeyBefore(k[hi - 1], k[mid])) selKeySwap(k, hi - 1, mid);
+        selKeySwap(k, mid, hi - 1);
+        SelKey pivot = k[hi - 1];
+        int p = lo;
+        for (int i = lo; i < hi - 1; ++i)
+            if (selKeyBefore(k[i], pivot)) selKeySwap(k, i, p++);
+        selKeySwap(k, p, hi - 1);
+        if (p == m || p + 1 == m) return;
+        if (p > m) hi = p;
+        else lo = p + 1;
+    }
+    /* insertion sort of the last small range */
+    for (int i = lo + 1; i < hi; ++i) {
+        SelKey x = k[i];
+        int j = i;
+        for (; j > lo && selKeyBefore(x, k[j - 1]); --j) k[j] = k[j - 1];
+        k[j] = x;
+    }
+}
+
+static inline int selKeyCompare(const void *a, const void *b)
+{
+    return selKeyBefore(*(const SelKey *)a, *(const SelKey *)b) ? -1
+         : selKeyBefore(*(const SelKey *)b, *(const SelKey *)a) ? 1 : 0;
+}
+
+/* Reorders pop so pop[0..k) are its best k individuals, best first, and
+   the others follow in their previous order.  Afterwards keys[i] is
+   (pop[i]->fitness, i) for the parent draws.  Returns 0, or -1 when out of memory. */
+static inline int selectionElites(Selection *s, Chromosome **pop, int n, int k)
+{
+    if (n <= 0) return 0;
+    if (selectionReserve(s, n) != 0) return -1;
+    s->size = n;
+    if (k > n) k = n;
+    if (k < 0) k = 0;
+    SelKey *keys = s->keys;
+    for (int i = 0; i < n; ++i) {
+        keys[i].fitness = pop[i]->fitness;
+        keys[i].index = i;
+    }
+    if (k > 0) {
+        if (k < n) selIntroselect(keys, n, k);
+        qsort(keys, (size_t)k, sizeof *keys, selKeyCompare);
+
+        /* keys are a total order, so exactly the k best rank no later than keys[k - 1] */
+        SelKey last = keys[k - 1];
+        for (int j = 0; j < k; ++j) s->tmp[j] = pop[keys[j].index];
+        int r = k;
+        for (int i = 0; i < n; ++i) {
+            SelKey x = {pop[i]->fitness, i};
+            if (selKeyBefore(last, x)) s->tmp[r++] = pop[i];
+        }
+        memcpy(pop, s->tmp, (size_t)n * sizeof *pop);
+    }
+    for (int i = 0; i < n; ++i) {
+        keys[i].fitness = pop[i]->fitness;
+        keys[i].index = i;
+    }
+    return 0;
+}
+
+/* Finds the m worst of pop[0..n) without reordering pop: their indices end up in
+   s->keys[n - m .. n).index, unordered.  Returns m (clamped to n), or -1 when out of memory.
+   The keys no longer match pop afterwards, selectionElites() rebuilds them. */
+static inline int selectionWorst(Selection *s, Chromosome **pop, int n, int m)
+{
+    if (m > n) m = n;
+    if (m <= 0) return 0;
+    if (selectionReserve(s, n) != 0) return -1;
+    for (int i = 0; i < n; ++i) {
+        s->keys[i].fitness = pop[i]->fitness;
+        s->keys[i].index = i;
+    }
+    if (m < n) selIntroselect(s->keys, n, n - m);
+    return m;
+}
+
+/* best of s->tournament uniform draws from the whole population */
+static inline int selectionTournament(const Selection *s, Rng *r)
+{
+    SelKey best = s->keys[rngBelow(r, (uint32_t)s->size)];
+    for (int t = 1; t < s->tournament; ++t) {
+        SelKey x = s->keys[rngBelow(r, (uint32_t)s->size)];
+        if (selKeyBefore(x, best)) best = x;
+    }
+    return best.index;
+}
+
+/* linear ranking with pressure s->pressure: a binary tournament the better entrant wins
+   with probability pressure / 2 */
+static inline int selectionRank(const Selection *s, Rng *r)
+{
+    SelKey a = s->keys[rngBelow(r, (uint32_t)s->size)];
+    SelKey b = s->keys[rngBelow(r, (uint32_t)s->size)];
+    if (selKeyBefore(b, a)) {
+        SelKey t = a;
+        a = b;
+        b = t;
+    }
+    return rngDouble(r) < s->pressure * 0.5 ? a.index : b.index;
+}
+
+/* one parent index by s->mode; elites is how many of pop[] selectionElites() ranked */
+static inline int selectionDraw(const Selection *s, int elites, Rng *r)
+{
+    switch (s->mode) {
+    case SELECT_TOURNAMENT: return selectionTournament(s, r);
+    case SELECT_RANK: return selectionRank(s, r);
+    default: return (int)rngBelow(r, (uint32_t)elites);
+    }
+}
+
+#endif
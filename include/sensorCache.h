@@ -0,0 +1,229 @@
+// Frame-to-frame wall sweep cache.  The ship only moves a few pixels per
+// frame, so instead of 360 fresh feelers the previous frame's hit points
+// (kept per world angle) are re-projected to the new position:
+//  - neighbouring hits on the same wall are joined into segments and every
+//    angle they now cover gets the exact distance to that segment
+//  - a clear ray only needs the few pixels it gained checked with wallBetween
+//  - angles nothing lands on (newly uncovered space) and angles at a depth
+//    edge, where a corner could be missed, are cast with wallFeeler
+// Turning costs nothing since the cache is indexed by world angle.  A full
+// sweep is redone every SENSOR_CACHE_REFRESH frames and after a jump (death,
+// respawn, map wrap) so re-projection error cannot build up.
+#ifndef SENSORCACHE_H
+#define SENSORCACHE_H
+
+#include <math.h>
+#include <stddef.h>
+#include "cAI.h"
+#include "wallSweep.h"
+
+#define SENSOR_CACHE_REFRESH 48 // frames between full sweeps
+#define SENSOR_CACHE_JUMP 64    // pixels moved in one frame that force a full sweep
+#define SENSOR_CACHE_JOIN 0.05  // hits closer than this * distance are taken to be on the same wall
+
+typedef struct
+{
+  int dist;                    // feeler length the cache holds, 0 = empty
+  double x, y;                 // ship position the readings were taken from
+  int age;                     // frames since the last full sweep
+  int world[360];              // wall distance per world angle, dist = nothing in range
+  double hitX[360], hitY[360]; // world point each reading ends at
+  int recast;                  // feelers cast on the last update
+  int probed;                  // clear rays extended with wallBetween on the last update
+} SensorCache;
+
+static double sensorCos[360], sensorSin[360];
+
+static inline void sensorCacheTable(void)
+{
+  static int ready = 0;
+  if (ready)
+    return;
+  for (int k = 0; k < 360; k++)
+  {
+    sensorCos[k] = cos(k * M_PI / 180.0);
+    sensorSin[k] = sin(k * M_PI / 180.0);
+  }
+  ready = 1;
+}
+
+static inline void sensorCacheStore(SensorCache *c, int b, double d)
+{
+  c->world[b] = (int)d; // the point keeps the fraction, truncating it every frame would drift
+  c->hitX[b] = c->x + d * sensorCos[b];
+  c->hitY[b] = c->y + d * sensorSin[b];
+}
+
+static inline void sensorCacheFull(SensorCache *c, int dist, double x, double y)
+{
+  int d[360];
+  sweepWalls(dist, 0, 1, 360, d, NULL, NULL);
+  c->dist = dist;
+  c->x = x;
+  c->y = y;
+  c->age = 0;
+  for (int b = 0; b < 360; b++)
+    sensorCacheStore(c, b, d[b]);
+  c->recast = 360;
+  c->probed = 0;
+}
+
+// Bring the cache to the ship's current position.
+static inline void sensorCacheUpdate(SensorCache *c, int dist)
+{
+  sensorCacheTable();
+  double x = selfX(), y = selfY();
+  double dx = x - c->x, dy = y - c->y;
+  if (c->dist != dist || ++c->age >= SENSOR_CACHE_REFRESH || dx * dx + dy * dy > SENSOR_CACHE_JUMP * SENSOR_CACHE_JUMP)
+  {
+    sensorCacheFull(c, dist, x, y);
+    return;
+  }
+  c->recast = c->probed = 0;
+  if (dx == 0.0 && dy == 0.0)
+    return;
+
+  // where every old reading is seen from here
+  double ang[360], r[360];
+  for (int k = 0; k < 360; k++)
+  {
+    double vx = c->hitX[k] - x, vy = c->hitY[k] - y;
+    r[k] = sqrt(vx * vx + vy * vy);
+    ang[k] = atan2(vy, vx) * 180.0 / M_PI;
+  }
+
+  // nearest wall per angle, and how far each angle is known to be clear
+  double wallAt[360], clearTo[360];
+  unsigned char edge[360];
+  for (int b = 0; b < 360; b++)
+  {
+    wallAt[b] = INFINITY;
+    clearTo[b] = -1.0;
+    edge[b] = 0;
+  }
+  for (int k = 0; k < 360; k++)
+  {
+    int k2 = k + 1 < 360 ? k + 1 : 0;
+    int wall = c->world[k] < dist, wall2 = c->world[k2] < dist;
+    double span = ang[k2] - ang[k];
+    span -= 360.0 * floor((span + 180.0) / 360.0);
+    // only pairs on the same surface say anything about the angles between
+    // them; around a depth edge (corner, wall next to open space) the angles
+    // are left for a fresh feeler
+    int joined = wall == wall2 && fabs(span) <= 10.0;
+    if (joined && wall)
+    {
+      double jx = c->hitX[k2] - c->hitX[k], jy = c->hitY[k2] - c->hitY[k];
+      joined = sqrt(jx * jx + jy * jy) <= SENSOR_CACHE_JOIN * fmin(r[k], r[k2]) + 2.0;
+    }
+    double lo = span >= 0.0 ? ang[k] : ang[k] + span, hi = lo + fabs(span);
+    if (!joined)
+    {
+      if (fabs(span) > 10.0)
+        lo = hi = ang[k];
+      for (int i = (int)floor(lo); i <= (int)ceil(hi); i++)
+        edge[(i % 360 + 360) % 360] = 1;
+      continue;
+    }
+    for (int i = (int)ceil(lo); i <= (int)floor(hi); i++)
+    {
+      int b = (i % 360 + 360) % 360;
+      if (!wall)
+      {
+        double reach = fmin(r[k], r[k2]);
+        if (reach > clearTo[b])
+          clearTo[b] = reach;
+        continue;
+      }
+      // distance along ray b to the wall segment between the two hits
+      double ax = c->hitX[k] - x, ay = c->hitY[k] - y;
+      double ex = c->hitX[k2] - c->hitX[k], ey = c->hitY[k2] - c->hitY[k];
+      double den = sensorCos[b] * ey - sensorSin[b] * ex;
+      if (den == 0.0)
+        continue;
+      double t = (ax * ey - ay * ex) / den;
+      double s = (ax * sensorSin[b] - ay * sensorCos[b]) / den;
+      if (t > 0.0 && s >= -0.01 && s <= 1.01 && t < wallAt[b])
+        wallAt[b] = t;
+    }
+  }
+
+  c->x = x;
+  c->y = y;
+  for (int b = 0; b < 360; b++)
+  {
+    if (edge[b])
+    {
+      sensorCacheStore(c, b, wallFeeler(dist, b));
+      c->recast++;
+    }
+    else if (wallAt[b] < dist)
+    {
+      sensorCacheStore(c, b, wallAt[b]);
+    }
+    else if (clearTo[b] >= 0.0)
+    {
+      // a block cannot sit between two clear rays without crossing one of
+      // them, so only the stretch past the old end needs checking
+      double reach = clearTo[b];
+      int hit = -1;
+      if (reach < dist)
+      {
+        hit = wallBetween((int)lround(x + reach * sensorCos[b]), (int)lround(y + reach * sensorSin[b]),
+                          (int)lround(x + dist * sensorCos[b]), (int)lround(y + dist * sensorSin[b]));
+        c->probed++;
+      }
+      sensorCacheStore(c, b, hit < 0 ? dist : reach + hit);
+    }
+    else
+    {
+      sensorCacheStore(c, b, wallFeeler(dist, b));
+      c->recast++;
+    }
+  }
+}
+
+// Same contract as sweepWalls(dist, headingDeg, 1, 360, ...): out[i] is the
+// wall distance at headingDeg + i, ties go to the lowest index.
+static inline int sensorCacheSweep(SensorCache *c, int dist, int headingDeg, int out[360], int *minIdx, int *maxIdx)
+{
+  sensorCacheUpdate(c, dist);
+  int h = (headingDeg % 360 + 360) % 360;
+  int lo = 0, hi = 0;
+  for (int i = 0; i < 360; i++)
+  {
+    out[i] = c->world[(h + i) % 360];
+    if (out[i] < out[lo])
+      lo = i;
+    if (out[i] > out[hi])
+      hi = i;
+  }
+  if (minIdx)
+    *minIdx = lo;
+  if (maxIdx)
+    *maxIdx = hi;
+  return 360;
+}
+
+// Closest and furthest wall in world angles.
+static inline void sensorCacheExtremes(const SensorCache *c, int *closest, int *closestDeg, int *furthest, int *furthestDeg)
+{
+  int lo = 0, hi = 0;
+  for (int k = 1; k < 360; k++)
+  {
+    if (c->world[k] < c->world[lo])
+      lo = k;
+    if (c->world[k] > c->world[hi])
+      hi = k;
+  }
+  if (closest)
+    *closest = c->world[lo];
+  if (closestDeg)
+    *closestDeg = lo;
+  if (furthest)
+    *furthest = c->world[hi];
+  if (furthestDeg)
+    *furthestDeg = hi;
+}
+
+#endif
@@ -0,0 +1,224 @@
+// Everything a controller looks at in one tick, captured once at the top of
+// AI_loop instead of calling into libcAI.so wherever a value is needed.
+// The wall sweep is relative to the heading (walls[i] is the feeler at
+// heading + i), and trackWall and the closest/furthest readings are taken
+// from it rather than cast again.  Frames are plain data, so they can be
+// written to a log with sensorFrameWrite() and fed back to a controller, or
+// filled in bulk by something other than the client.
+#ifndef SENSORFRAME_H
+#define SENSORFRAME_H
+
+#include <stdio.h>
+#include <string.h>
+#include "cAI.h"
+#include "wallSweep.h"
+
+#define SENSOR_FRAME_ENEMIES 4 // nearest enemies kept
+#define SENSOR_FRAME_SHOTS 8   // nearest shots kept
+#define SENSOR_FRAME_MAGIC "XPSF"
+#define SENSOR_FRAME_VERSION 1
+
+typedef struct
+{
+  int x, y;
+  double distance;
+  double speed;
+  double trackingDeg;
+  double headingDeg;
+  int aimDir; // aimdir() for this enemy, -1 when it cannot be hit
+  int reload;
+  int shield;
+  int team;
+} SensorEnemy;
+
+typedef struct
+{
+  int x, y;
+  int dist;
+  int vel;
+  int velDir;
+  int alert; // shotAlert(), -1 when the shot is no danger
+} SensorShot;
+
+typedef struct __attribute__((aligned(64)))
+{
+  long frame; // frames captured so far
+  // self
+  int alive;
+  int x, y;
+  int velX, velY;
+  int speed;
+  double headingDeg;
+  double trackingDeg;
+  int headingTrackingDiff; // (heading + 360 - tracking) % 360
+  int reload;
+  int shield;
+  int team;
+  // HUD
+  int lives;
+  double score;
+  double turnSpeed;
+  double power;
+  // enemies and shots, nearest first
+  int aimDir;              // aimdir(0)
+  int headingAimingDiff;   // (heading + 360 - aimDir) % 360
+  int shotDanger;          // shotAlert(0)
+  int enemyCount;
+  int shotCount;
+  SensorEnemy enemy[SENSOR_FRAME_ENEMIES];
+  SensorShot shot[SENSOR_FRAME_SHOTS];
+  // walls, from the sweep
+  int wallDist;            // feeler length of the sweep
+  int trackWall;           // feeler along the tracking direction
+  int closest, closestAngle;
+  int furthest, furthestAngle;
+  int walls[360];
+} SensorFrame;
+
+// Self, HUD, enemy and shot fields; the walls are left to the caller.
+static inline void sensorFrameCaptureState(SensorFrame *f)
+{
+  long frame = f->frame;
+  memset(f, 0, sizeof *f);
+  f->frame = frame + 1;
+
+  f->alive = selfAlive();
+  f->x = selfX();
+  f->y = selfY();
+  f->velX = selfVelX();
+  f->velY = selfVelY();
+  f->speed = selfSpeed();
+  f->headingDeg = selfHeadingDeg();
+  f->trackingDeg = selfTrackingDeg();
+  f->headingTrackingDiff = (int)(f->headingDeg + 360 - f->trackingDeg) % 360;
+  f->reload = selfReload();
+  f->shield = selfShield();
+  f->team = selfTeam();
+  f->lives = selfLives();
+  f->score = selfScore();
+  f->turnSpeed = getTurnSpeed();
+  f->power = getPower();
+
+  f->aimDir = aimdir(0);
+  f->headingAimingDiff = (int)(f->headingDeg + 360 - f->aimDir) % 360;
+  f->shotDanger = shotAlert(0);
+  for (int i = 0; i < SENSOR_FRAME_ENEMIES; i++)
+  {
+    double d = enemyDistance(i);
+    if (d < 0)
+      break;
+    SensorEnemy *e = &f->enemy[f->enemyCount++];
+    e->x = screenEnemyX(i);
+    e->y = screenEnemyY(i);
+    e->distance = d;
+    e->speed = enemySpeed(i);
+    e->trackingDeg = enemyTrackingDeg(i);
+    e->headingDeg = enemyHeadingDeg(i);
+    e->aimDir = i == 0 ? f->aimDir : aimdir(i);
+    e->reload = enemyReload(i);
+    e->shield = enemyShield(i);
+    e->team = enemyTeam(i);
+  }
+  for (int i = 0; i < SENSOR_FRAME_SHOTS; i++)
+  {
+    int d = shotDist(i);
+    if (d < 0)
+      break;
+    SensorShot *s = &f->shot[f->shotCount++];
+    s->x = shotX(i);
+    s->y = shotY(i);
+    s->dist = d;
+    s->vel = shotVel(i);
+    s->velDir = shotVelDir(i);
+    s->alert = i == 0 ? f->shotDanger : shotAlert(i);
+  }
+}
+
+// Derives trackWall and the closest/furthest readings once f->walls holds a
+// sweep of length dist starting at the heading.  Ties go to the lowest index,
+// like sweepWalls().
+static inline void sensorFrameWalls(SensorFrame *f, int dist)
+{
+  int lo = 0, hi = 0;
+  for (int i = 1; i < 360; i++)
+  {
+    if (f->walls[i] < f->walls[lo])
+      lo = i;
+    if (f->walls[i] > f->walls[hi])
+      hi = i;
+  }
+  f->wallDist = dist;
+  f->closest = f->walls[lo];
+  f->closestAngle = lo;
+  f->furthest = f->walls[hi];
+  f->furthestAngle = hi;
+  f->trackWall = f->walls[(((int)f->trackingDeg - (int)f->headingDeg) % 360 + 360) % 360];
+}
+
+// A feeler of length dist <= wallDist at heading + rel, from the sweep.
+static inline int sensorFrameFeeler(const SensorFrame *f, int dist, int rel)
+{
+  int d = f->walls[(rel % 360 + 360) % 360];
+  return d < dist ? d : dist;
+}
+
+// Full capture with the walls from sweepWalls().
+static inline void sensorFrameCapture(SensorFrame *f, int wallDist)
+{
+  sensorFrameCaptureState(f);
+  sweepWalls(wallDist, (int)f->headingDeg, 1, 360, f->walls, NULL, NULL);
+  sensorFrameWalls(f, wallDist);
+}
+
+// Frame logs: a small header, then the frames as they are in memory, so a
+// log only reads back into a build with the same SensorFrame layout.
+typedef struct
+{
+  char magic[4];
+  int version;
+  int frameSize;
+} SensorFrameLogHeader;
+
+static inline int sensorFrameWrite(FILE *log, const SensorFrame *f)
+{
+  if (ftell(log) == 0)
+  {
+    SensorFrameLogHeader h = {SENSOR_FRAME_MAGIC, SENSOR_FRAME_VERSION, (int)sizeof(SensorFrame)};
+    if (fwrite(&h, sizeof h, 1, log) != 1)
+      return -1;
+  }
+  return fwrite(f, sizeof *f, 1, log) == 1 ? 0 : -1;
+}
+
+// Returns 0 for a frame, -1 at the end of the log or when it was written
+// with another layout.
+static inline int sensorFrameRead(FILE *log, SensorFrame *f)
+{
+  if (ftell(log) == 0)
+  {
+    SensorFrameLogHeader h;
+    if (fread(&h, sizeof h, 1, log) != 1 || memcmp(h.magic, SENSOR_FRAME_MAGIC, 4) != 0 ||
+        h.version != SENSOR_FRAME_VERSION || h.frameSize != (int)sizeof(SensorFrame))
+      return -1;
+  }
+  return fread(f, sizeof *f, 1, log) == 1 ? 0 : -1;
+}
+
+// Takes "-framelog file" out of the command line and opens the file for
+// appending frames; NULL when there is none.
+static inline FILE *sensorFrameLogArgs(int *argc, char *argv[])
+{
+  for (int i = 1; i + 1 < *argc; i++)
+  {
+    if (strcmp(argv[i], "-framelog") != 0)
+      continue;
+    FILE *log = fopen(argv[i + 1], "wb");
+    for (int j = i; j + 2 <= *argc; j++)
+      argv[j] = argv[j + 2];
+    *argc -= 2;
+    return log;
+  }
+  return NULL;
+}
+
+#endif
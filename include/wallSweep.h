@@ -0,0 +1,30 @@
+// One call for a fan of wall feelers.  libcAI_sim.so exports wallSweep();
+// the stock libcAI.so does not, so against it sweepWalls() falls back to one
+// wallFeeler() per angle.  Ties go to the lowest index, like the loops it
+// replaces.
+#ifndef WALLSWEEP_H
+#define WALLSWEEP_H
+
+#include "cAI.h"
+
+static inline int sweepWalls(int dist, int startDeg, int stepDeg, int count, int out[], int *minIdx, int *maxIdx)
+{
+  if (wallSweep)
+    return wallSweep(dist, startDeg, stepDeg, count, out, minIdx, maxIdx);
+  int lo = 0, hi = 0;
+  for (int i = 0; i < count; i++)
+  {
+    out[i] = wallFeeler(dist, startDeg + i * stepDeg);
+    if (out[i] < out[lo])
+      lo = i;
+    if (out[i] > out[hi])
+      hi = i;
+  }
+  if (minIdx)
+    *minIdx = lo;
+  if (maxIdx)
+    *maxIdx = hi;
+  return count;
+}
+
+#endif
@@ -0,0 +1,3 @@
+#!/bin/bash
+
+gcc -I../include mlpPilot.c ../sim/libcAI_sim.so -Wl,-rpath,'$ORIGIN/../sim' -lm -o MLPSim -D PLAYER
@@ -5,9 +5,17 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
+#include "rng.h"
 
 #if defined(PLAYER) || defined(RECORDER)
 #include "cAI.h"
+#include "wallSweep.h"
+#include "rayAtlas.h"
+#include "sensorFrame.h"
+
+RayAtlas mapAtlas;  // loaded from -rayatlas, empty otherwise
+SensorFrame frame;  // this tick's snapshot, see sensorFrame.h
+FILE *frameLog;     // -framelog file, NULL when not logging
 #endif
 typedef struct Layer
 {
@@ -34,10 +42,12 @@ typedef struct MLP
 
 double sigmoid(double x) { return 1.0f / (1.0f + exp(-x)); }
 
+Rng mlpRng; // weight initialisation, seeded in main
+
 // returns a random double between min and max
 double frand(double min, double max)
 {
-  return fmax(fmin((max - min) * (double)rand() / ((double)RAND_MAX) + min, max),
+  return fmax(fmin((max - min) * rngDouble(&mlpRng) + min, max),
               min);
 }
 int frandArray(int size, double min, double max, double **out)
@@ -428,18 +438,22 @@ int mlpLoad(MLP *out, const char *path)
 #define TURNDEBUG(x)
 #endif
 #if defined(PLAYER) || defined(RECORDER)
-float ruleBasedBotThrust(int shotDanger, int headingTrackingDiff, int furthest_angle, int trackWall, int heading)
+float ruleBasedBotThrust(const SensorFrame *f)
 {
-  double frontWall = wallFeeler(500, heading);
-  double wall5 = wallFeeler(500, heading + 150);
-  double backWall = wallFeeler(500, heading + 180);
-  double wall7 = wallFeeler(500, heading + 210);
+  int shotDanger = f->shotDanger;
+  int headingTrackingDiff = f->headingTrackingDiff;
+  int furthest_angle = f->furthestAngle;
+  int trackWall = f->trackWall;
+  double frontWall = f->walls[0];
+  double wall5 = f->walls[150];
+  double backWall = f->walls[180];
+  double wall7 = f->walls[210];
   if (shotDanger > 0 && shotDanger < 200 && frontWall > 200 && trackWall > 80)
   {
     THRUSTDEBUG(AR(printf("avoiding shot: %d\n", shotDanger)));
     return 1;
   }
-  else if ((furthest_angle == 0) && selfSpeed() < 6 && frontWall > 200)
+  else if ((furthest_angle == 0) && f->speed < 6 && frontWall > 200)
   {
     THRUSTDEBUG(AR(printf("propulsion\n")));
     return 1;
@@ -468,7 +482,7 @@ float ruleBasedBotThrust(int shotDanger, int headingTrackingDiff, int furthest_a
   {
     THRUSTDEBUG(AR(printf("thrusters type 5\n")));
     return 1;
-  } else if (selfSpeed() < 1)
+  } else if (f->speed < 1)
   {
     THRUSTDEBUG(AR(printf("thrusters type 6\n")));
     return 1;
@@ -492,23 +506,27 @@ float ruleBasedBotTurnAim(int aimDir, int headingAimingDiff, float turn)
   else
     return 0.5f;
 }
-float ruleBasedBotTurnNav(int headingTrackingDiff, int headingAimingDiff, int aimDir, int heading, int closest, int closest_angle, int furthest_angle)
+float ruleBasedBotTurnNav(const SensorFrame *f)
 {
-  if (selfSpeed() > 9 && headingTrackingDiff < 175)
+  int headingTrackingDiff = f->headingTrackingDiff;
+  int closest = f->closest;
+  int closest_angle = f->closestAngle;
+  int furthest_angle = f->furthestAngle;
+  if (f->speed > 9 && headingTrackingDiff < 175)
   {
     return 0;
   }
   // Speed too fast, turn to face against tracking direction
-  else if (selfSpeed() > 9 && headingTrackingDiff > 185)
+  else if (f->speed > 9 && headingTrackingDiff > 185)
   {
     return 1;
   }
-  else if (selfSpeed() > 1 && closest < 100 && closest_angle > 2 && closest_angle <= 180)
+  else if (f->speed > 1 && closest < 100 && closest_angle > 2 && closest_angle <= 180)
   {
     return 1;
   }
   // if the ship is already facing the furthest area, then turn away from nearby geometries
-  else if (selfSpeed() > 1 && closest < 100 && closest_angle < 358 && closest_angle > 180)
+  else if (f->speed > 1 && closest < 100 && closest_angle < 358 && closest_angle > 180)
   {
     return 0;
   }
@@ -541,7 +559,6 @@ FILE *replay;
 #if defined(PLAYER) || defined(RECORDER)
 int AI_loop()
 {
-  srand((unsigned int)time(NULL));
   static int life = 0;
   static int update = 0;
   if (!selfAlive())
@@ -567,55 +584,41 @@ int AI_loop()
 
   setTurnSpeedDeg(20);
 
-  int aimDir = aimdir(0);
-  int shotDanger = shotAlert(0);
-  double heading = selfHeadingDeg();
-  double tracking = selfTrackingDeg();
-  double trackWall = wallFeeler(500, tracking);
-
-  double furthest = 0.0;
-  int furthest_angle = 0;
-  double closest = 600.0;
-  int closest_angle = 0;
-  for (int i = 0; i < 360; i++)
-  {
-    double dist = wallFeeler(500, heading + i);
-    if (dist > furthest)
-    {
-      furthest = dist;
-      furthest_angle = i;
-    }
-    if (dist < closest)
-    {
-      closest = dist;
-      closest_angle = i;
-    }
-  }
+  sensorFrameCaptureState(&frame);
+  // walls[i] is the feeler at heading + i
+  if (mapAtlas.size)
+    rayAtlasSweep(&mapAtlas, frame.x, frame.y, 500, (int)frame.headingDeg, 1, 360, frame.walls, NULL, NULL);
+  else
+    sweepWalls(500, (int)frame.headingDeg, 1, 360, frame.walls, NULL, NULL);
+  sensorFrameWalls(&frame, 500);
+  if (frameLog)
+    sensorFrameWrite(frameLog, &frame);
+  int aimDir = frame.aimDir;
+  double closest = frame.closest;
   // NN inputs
   // clockwise rotation around the ship
   double *inputs = calloc(INPUTSIZE, sizeof(double));
 
-  int headingAimingDiff = ((int)(heading + 360 - aimDir) % 360);
-  int headingTrackingDiff = ((int)(heading + 360 - tracking) % 360);
-  inputs[0] = fmin(selfSpeed() / 10.0f, 1.0f);
-  inputs[1] = headingTrackingDiff / 360.0f;
+  int headingAimingDiff = frame.headingAimingDiff;
+  inputs[0] = fmin(frame.speed / 10.0f, 1.0f);
+  inputs[1] = frame.headingTrackingDiff / 360.0f;
   inputs[2] = headingAimingDiff / 360.0f;
-  inputs[3] = fmin((double)shotAlert(0) / 100.0f, 1.0f);
-  inputs[4] = trackWall / 500.0f;
+  inputs[3] = fmin((double)frame.shotDanger / 100.0f, 1.0f);
+  inputs[4] = frame.trackWall / 500.0f;
   inputs[5] = closest / 500.0f;
-  inputs[6] = closest_angle / 360.0f;
-  inputs[7] = furthest / 500.0f;
-  inputs[8] = furthest_angle / 360.0f;
+  inputs[6] = frame.closestAngle / 360.0f;
+  inputs[7] = frame.furthest / 500.0f;
+  inputs[8] = frame.furthestAngle / 360.0f;
   for (int i = 9; i < 21; i++)
   {
-    inputs[i] = wallFeeler(500, heading + (i-9) * 30) / 500.0f; // normalize
+    inputs[i] = frame.walls[(i-9) * 30] / 500.0f; // normalize
   }
 
-  double navigationGoal = ruleBasedBotTurnNav(headingTrackingDiff, headingAimingDiff, aimDir, heading, closest, closest_angle, furthest_angle);
+  double navigationGoal = ruleBasedBotTurnNav(&frame);
   double aimGoal = ruleBasedBotTurnAim(aimDir, headingAimingDiff, navigationGoal);
   //Is this better or no?
   double finalTurnGoal = (aimGoal + navigationGoal) / 2; // average the aim goal with navigation goal 
-  int thrustGoal = ruleBasedBotThrust(shotDanger, headingTrackingDiff, furthest_angle, trackWall, heading);
+  int thrustGoal = ruleBasedBotThrust(&frame);
 
   float turnDir = 0;
   double turnRB = 0.0f;
@@ -626,7 +629,7 @@ int AI_loop()
   else
     turnRB = navigationGoal;
 
-  double backWall = wallFeeler(30, heading + 180);
+  double backWall = sensorFrameFeeler(&frame, 30, 180);
   if ((headingAimingDiff < 20 || headingAimingDiff > 340) && backWall > 20 && aimDir > 0)
   {
     fireShot(1);
@@ -692,11 +695,22 @@ int main(int argc, char *argv[])
   // [21, 21, 1] lr 0.7 epoch 200 decay 0.99 acc 0.82
 
   int nodes[NODESSIZE] = {INPUTSIZE, 21, OUTPUTSIZE};
+#ifdef TRAINER
+  // the initial weights come from argv[4], 0 unless given, so a training run can be repeated
+  rngSeed(&mlpRng, argc > 4 ? strtoull(argv[4], NULL, 10) : 0);
+#else
+  rngSeed(&mlpRng, (uint64_t)time(NULL));
+#endif
 
   createMLP(nodes, NODESSIZE, &network);
   char modelNameBuffer[200];
   const char* modelPath = "model-lr%f-decay%f-epoch%d.save";
   const char *replayPath = "replay.txt";
+#if defined(PLAYER) || defined(RECORDER)
+  // optional: -rayatlas map.ra, written by sim/mkrayatlas
+  rayAtlasArgs(&mapAtlas, &argc, argv);
+  frameLog = sensorFrameLogArgs(&argc, argv);
+#endif
 #ifdef PLAYER
   mlpLoad(network, "model.save");
   return start(argc, argv);
@@ -709,10 +723,9 @@ int main(int argc, char *argv[])
 #endif
 #ifdef TRAINER
   if (argc < 2) {
-        printf("Usage: %s lr epoch decay\n", argv[0]);
+        printf("Usage: %s lr epoch decay [seed]\n", argv[0]);
         return 1;
     }
-  srand(0);
   const char *replayPaths[] = {
       "replay_clean.txt",
       "replay2_clean.txt",
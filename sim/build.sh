@@ -0,0 +1,5 @@
+#!/bin/bash
+
+gcc -O2 -fPIC -shared -I../include sim.c cAI_sim.c -lm -o libcAI_sim.so
+gcc -O2 -I../include sim.c distField.c mkdistfield.c -lm -o mkdistfield
+gcc -O2 -I../include sim.c rayAtlas.c mkrayatlas.c -lm -o mkrayatlas
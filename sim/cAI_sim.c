@@ -0,0 +1,441 @@
+// libcAI_sim: the cAI.h interface implemented on top of the in-process world
+// in sim.c, so any bot can be relinked against it and run headless.
+// Build: ./build.sh
+// Usage: ./Smarty -ticks 20000 -seed 3 [-map file.xp] [-enemies 2] [-quiet]
+//   Unknown options (-name, -join, ...) are ignored so the usual run.sh
+//   arguments keep working.
+#include "cAI.h"
+#include "cAI_sim.h"
+#include "sim.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#define RAD(x) ((x) * M_PI / 180.0)
+#define DEG(x) ((x) * 180.0 / M_PI)
+
+extern int AI_loop();
+
+static SimWorld world;
+static int quit = 0;
+static int lockId = -1;
+
+// per-frame buffers, rebuilt before every AI_loop call
+static int enemyIdx[SIM_MAX_SHIPS];   // ship indices sorted by distance
+static double enemyDist[SIM_MAX_SHIPS];
+static int enemyCount = 0;
+typedef struct {
+    int shot;                  // index into world.shots
+    int alert;
+    double dist;
+} ShotInfo;
+static ShotInfo shotBuf[SIM_MAX_SHOTS];
+static int shotCount = 0;
+
+static SimShip *self(void) { return &world.ships[0]; }
+
+static double distTo(const SimShip *s, double x, double y)
+{
+    return sqrt((x - s->x) * (x - s->x) + (y - s->y) * (y - s->y));
+}
+
+static int cmpEnemy(const void *a, const void *b)
+{
+    double da = enemyDist[*(const int *)a], db = enemyDist[*(const int *)b];
+    return da < db ? -1 : da > db;
+}
+
+static int cmpShot(const void *a, const void *b)
+{
+    const ShotInfo *A = a, *B = b;
+    if (A->alert != B->alert) return A->alert < B->alert ? -1 : 1;
+    return A->dist < B->dist ? -1 : A->dist > B->dist;
+}
+
+static void buildBuffers(void)
+{
+    SimShip *me = self();
+    enemyCount = 0;
+    for (int i = 1; i < world.shipCount; i++) {
+        SimShip *o = &world.ships[i];
+        if (!o->alive) continue;
+        if (fabs(o->x - me->x) > SIM_SCREEN_W / 2 || fabs(o->y - me->y) > SIM_SCREEN_H / 2) continue;
+        enemyDist[i] = distTo(me, o->x, o->y);
+        enemyIdx[enemyCount++] = i;
+    }
+    qsort(enemyIdx, (size_t)enemyCount, sizeof(int), cmpEnemy);
+
+    shotCount = 0;
+    for (int i = 0; i < world.shotCount; i++) {
+        const SimShot *sh = &world.shots[i];
+        if (sh->owner == 0) continue;
+        if (fabs(sh->x - me->x) > SIM_SCREEN_W / 2 || fabs(sh->y - me->y) > SIM_SCREEN_H / 2) continue;
+        ShotInfo *si = &shotBuf[shotCount++];
+        si->shot = i;
+        si->alert = simShotAlert(sh->x - me->x, sh->y - me->y, sh->vx - me->vx, sh->vy - me->vy);
+        si->dist = distTo(me, sh->x, sh->y);
+        if (si->alert < 0) si->alert = 30000; // receding shots sort last
+    }
+    qsort(shotBuf, (size_t)shotCount, sizeof(ShotInfo), cmpShot);
+}
+
+static SimShip *enemyAt(int idx)
+{
+    if (idx < 0 || idx >= enemyCount) return NULL;
+    return &world.ships[enemyIdx[idx]];
+}
+
+static SimShip *enemyById(int id)
+{
+    for (int i = 1; i < world.shipCount; i++)
+        if (world.ships[i].id == id) return &world.ships[i];
+    return NULL;
+}
+
+static const SimShot *shotAt(int idx)
+{
+    if (idx < 0 || idx >= shotCount) return NULL;
+    return &world.shots[shotBuf[idx].shot];
+}
+
+static double headingTo(const SimShip *from, double x, double y)
+{
+    return simWrapDeg(DEG(atan2(y - from->y, x - from->x)));
+}
+
+static double speedOf(const SimShip *s) { return sqrt(s->vx * s->vx + s->vy * s->vy); }
+
+static void usage(void)
+{
+    printf("sim options: -ticks N -seed S -map file.xp -enemies N -quiet\n");
+}
+
+int start(int argc, char *argv[])
+{
+    long ticks = SIM_FPS * 60 * 5;
+    unsigned long long seed = 1;
+    int enemies = 1;
+    int quiet = 0;
+    const char *mapPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-ticks") == 0 && i + 1 < argc) ticks = atol(argv[++i]);
+        else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-map") == 0 && i + 1 < argc) mapPath = argv[++i];
+        else if (strcmp(argv[i], "-enemies") == 0 && i + 1 < argc) enemies = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-quiet") == 0) quiet = 1;
+        else if (strcmp(argv[i], "-simhelp") == 0) { usage(); return 0; }
+    }
+
+    memset(&world, 0, sizeof world);
+    if (mapPath && simMapLoad(&world.map, mapPath) != 0) {
+        fprintf(stderr, "[sim] could not load map %s\n", mapPath);
+        return 1;
+    }
+    simWorldInit(&world, enemies, seed);
+    quit = 0;
+    lockId = -1;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    while (!quit && world.tick < ticks) {
+        buildBuffers();
+        AI_loop();
+        simWorldStep(&world);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    if (!quiet) {
+        printf("[sim] ticks=%ld deaths=%d kills=%d score=%.1f wall=%.3fs (%.0f ticks/s, %.0fx realtime)\n",
+               world.tick, self()->deaths, self()->kills, self()->score, secs,
+               secs > 0 ? world.tick / secs : 0.0, secs > 0 ? world.tick / (secs * SIM_FPS) : 0.0);
+    }
+    simWorldFree(&world);
+    return 0;
+}
+
+void headlessMode() {}
+
+// ---------- sim extras ----------
+long simTick(void) { return world.tick; }
+int simDeaths(void) { return self()->deaths; }
+int simKills(void) { return self()->kills; }
+void simQuit(void) { quit = 1; }
+
+// ---------- movement ----------
+void turnLeft(int flag) { self()->turningLeft = flag ? 1 : 0; }
+void turnRight(int flag) { self()->turningRight = flag ? 1 : 0; }
+void turn(int deg)
+{
+    self()->turnRequest = deg;
+    self()->hasTurnRequest = 1;
+}
+void turnToDeg(int deg)
+{
+    self()->turnRequest = simWrapDeg(deg - self()->heading + 180.0) - 180.0;
+    self()->hasTurnRequest = 1;
+}
+void thrust(int flag) { self()->thrusting = flag ? 1 : 0; }
+void setTurnSpeed(double s) { self()->turnSpeed = fmin(fmax(s, 4.0), 64.0); }
+void setTurnSpeedDeg(int s) { setTurnSpeed(s * 128.0 / 360.0); }
+void setPower(double s) { self()->power = fmin(fmax(s, 5.0), 55.0); }
+void fasterTurnrate() { setTurnSpeed(self()->turnSpeed + 1.0); }
+void slowerTurnrate() { setTurnSpeed(self()->turnSpeed - 1.0); }
+void morePower() { setPower(self()->power + 1.0); }
+void lessPower() { setPower(self()->power - 1.0); }
+
+// ---------- shooting ----------
+void fireShot() { self()->fire = 1; }
+// the remaining weapons and items are not modelled
+void fireMissile() {}
+void fireTorpedo() {}
+void fireHeat() {}
+void dropMine() {}
+void detachMine() {}
+void detonateMines() {}
+void fireLaser() {}
+void tankDetach() {}
+void cloak() {}
+void ecm() {}
+void transporter() {}
+void tractorBeam(int flag) { (void)flag; }
+void pressorBeam(int flag) { (void)flag; }
+void phasing() {}
+void shield() { self()->shield = !self()->shield; }
+void emergencyShield() {}
+void hyperjump() {}
+void nextTank() {}
+void prevTank() {}
+void toggleAutopilot() {}
+void emergencyThrust() {}
+void deflector() {}
+void selectItem() {}
+void loseItem() {}
+
+// ---------- locks ----------
+void lockNext()
+{
+    if (enemyCount == 0) { lockId = -1; return; }
+    int cur = -1;
+    for (int i = 0; i < enemyCount; i++)
+        if (world.ships[enemyIdx[i]].id == lockId) cur = i;
+    lockId = world.ships[enemyIdx[(cur + 1) % enemyCount]].id;
+}
+void lockPrev()
+{
+    if (enemyCount == 0) { lockId = -1; return; }
+    int cur = 0;
+    for (int i = 0; i < enemyCount; i++)
+        if (world.ships[enemyIdx[i]].id == lockId) cur = i;
+    lockId = world.ships[enemyIdx[(cur + enemyCount - 1) % enemyCount]].id;
+}
+void lockClose() { lockId = enemyCount ? world.ships[enemyIdx[0]].id : -1; }
+void lockNextClose() { lockNext(); }
+void loadLock1() {}
+void loadLock2() {}
+void loadLock3() {}
+void loadLock4() {}
+
+// ---------- modifiers, map features and other keys ----------
+void toggleNuclear() {}
+void togglePower() {}
+void toggleVelocity() {}
+void toggleCluster() {}
+void toggleMini() {}
+void toggleSpread() {}
+void toggleLaser() {}
+void toggleImplosion() {}
+void toggleUserName() {}
+void loadModifiers1() {}
+void loadModifiers2() {}
+void loadModifiers3() {}
+void loadModifiers4() {}
+void clearModifiers() {}
+void connector(int flag) { (void)flag; }
+void dropBall() {}
+void refuel(int flag) { (void)flag; }
+void keyHome() {}
+void selfDestruct()
+{
+    if (!self()->alive) return;
+    self()->alive = 0;
+    self()->deadTicks = SIM_RESPAWN;
+    self()->deaths++;
+}
+void pauseAI() {}
+void swapSettings() {}
+void quitAI() { quit = 1; }
+void talkKey() {}
+void toggleCompass() {}
+void toggleShowMessage() {}
+void toggleShowItems() {}
+void repair() {}
+void reprogram() {}
+void talk(char *talk_str) { (void)talk_str; }
+char *scanMsg(int id) { (void)id; return ""; }
+char *scanGameMsg(int id) { (void)id; return ""; }
+
+// ---------- self ----------
+int selfX() { return (int)self()->x; }
+int selfY() { return (int)self()->y; }
+int selfRadarX() { return (int)(self()->x * 256.0 / (world.map.w * SIM_BLOCK_SZ)); }
+int selfRadarY() { return (int)(self()->y * 256.0 / (world.map.h * SIM_BLOCK_SZ)); }
+int selfVelX() { return (int)self()->vx; }
+int selfVelY() { return (int)self()->vy; }
+int selfSpeed() { return (int)speedOf(self()); }
+double lockHeadingDeg()
+{
+    SimShip *o = lockId >= 0 ? enemyById(lockId) : NULL;
+    return o ? headingTo(self(), o->x, o->y) : -1.0;
+}
+double lockHeadingRad()
+{
+    double d = lockHeadingDeg();
+    return d < 0 ? -1.0 : RAD(d);
+}
+short selfLockDist()
+{
+    SimShip *o = lockId >= 0 ? enemyById(lockId) : NULL;
+    return o ? (short)fmin(distTo(self(), o->x, o->y), 32767) : -1;
+}
+int selfReload() { return self()->reload; }
+int selfID() { return self()->id; }
+int selfAlive() { return self()->alive; }
+int selfTeam() { return self()->team; }
+int selfLives() { return 0; }
+double selfTrackingRad()
+{
+    return speedOf(self()) > 0.0 ? RAD(simWrapDeg(DEG(atan2(self()->vy, self()->vx)))) : 0.0;
+}
+double selfTrackingDeg()
+{
+    return speedOf(self()) > 0.0 ? simWrapDeg(DEG(atan2(self()->vy, self()->vx))) : 0.0;
+}
+double selfHeadingDeg() { return self()->heading; }
+double selfHeadingRad() { return RAD(self()->heading); }
+char *hud(int i) { (void)i; return ""; }
+char *hudScore(int i) { (void)i; return ""; }
+double hudTimeLeft(int i) { (void)i; return 0.0; }
+double getTurnSpeed() { return self()->turnSpeed; }
+double getPower() { return self()->power; }
+int selfShield() { return self()->shield; }
+char *selfName() { return self()->name; }
+double selfScore() { return self()->score; }
+
+// ---------- closest ----------
+int closestRadarX()
+{
+    SimShip *o = enemyAt(0);
+    return o ? (int)(o->x * 256.0 / (world.map.w * SIM_BLOCK_SZ)) : -1;
+}
+int closestRadarY()
+{
+    SimShip *o = enemyAt(0);
+    return o ? (int)(o->y * 256.0 / (world.map.h * SIM_BLOCK_SZ)) : -1;
+}
+int closestItemX() { return -1; }
+int closestItemY() { return -1; }
+int closestShipId()
+{
+    SimShip *o = enemyAt(0);
+    return o ? o->id : -1;
+}
+
+// ---------- by id ----------
+double enemySpeedId(int id) { SimShip *o = enemyById(id); return o ? speedOf(o) : -1.0; }
+double enemyTrackingRadId(int id) { SimShip *o = enemyById(id); return o ? atan2(o->vy, o->vx) : -1.0; }
+double enemyTrackingDegId(int id) { SimShip *o = enemyById(id); return o ? simWrapDeg(DEG(atan2(o->vy, o->vx))) : -1.0; }
+int enemyReloadId(int id) { SimShip *o = enemyById(id); return o ? o->reload : -1; }
+// there is no screen in the simulator, screen coordinates are world pixels
+int screenEnemyXId(int id) { SimShip *o = enemyById(id); return o ? (int)o->x : -1; }
+int screenEnemyYId(int id) { SimShip *o = enemyById(id); return o ? (int)o->y : -1; }
+double enemyHeadingDegId(int id) { SimShip *o = enemyById(id); return o ? o->heading : -1.0; }
+double enemyHeadingRadId(int id) { SimShip *o = enemyById(id); return o ? RAD(o->heading) : -1.0; }
+int enemyShieldId(int id) { SimShip *o = enemyById(id); return o ? o->shield : -1; }
+int enemyLivesId(int id) { SimShip *o = enemyById(id); return o ? 0 : -1; }
+char *enemyNameId(int id) { SimShip *o = enemyById(id); return o ? o->name : ""; }
+double enemyScoreId(int id) { SimShip *o = enemyById(id); return o ? o->score : -1.0; }
+int enemyTeamId(int id) { SimShip *o = enemyById(id); return o ? o->team : -1; }
+double enemyDistanceId(int id) { SimShip *o = enemyById(id); return o ? distTo(self(), o->x, o->y) : -1.0; }
+
+// ---------- by screen index ----------
+double enemyDistance(int idx) { SimShip *o = enemyAt(idx); return o ? distTo(self(), o->x, o->y) : -1.0; }
+double enemySpeed(int idx) { SimShip *o = enemyAt(idx); return o ? speedOf(o) : -1.0; }
+int enemyReload(int idx) { SimShip *o = enemyAt(idx); return o ? o->reload : -1; }
+double enemyTrackingRad(int idx) { SimShip *o = enemyAt(idx); return o ? atan2(o->vy, o->vx) : -1.0; }
+double enemyTrackingDeg(int idx) { SimShip *o = enemyAt(idx); return o ? simWrapDeg(DEG(atan2(o->vy, o->vx))) : -1.0; }
+int screenEnemyX(int idx) { SimShip *o = enemyAt(idx); return o ? (int)o->x : -1; }
+int screenEnemyY(int idx) { SimShip *o = enemyAt(idx); return o ? (int)o->y : -1; }
+double enemyHeadingDeg(int idx) { SimShip *o = enemyAt(idx); return o ? o->heading : -1.0; }
+double enemyHeadingRad(int idx) { SimShip *o = enemyAt(idx); return o ? RAD(o->heading) : -1.0; }
+int enemyShield(int idx) { SimShip *o = enemyAt(idx); return o ? o->shield : -1; }
+int enemyLives(int idx) { SimShip *o = enemyAt(idx); return o ? 0 : -1; }
+int enemyTeam(int idx) { SimShip *o = enemyAt(idx); return o ? o->team : -1; }
+char *enemyName(int idx) { SimShip *o = enemyAt(idx); return o ? o->name : ""; }
+double enemyScore(int idx) { SimShip *o = enemyAt(idx); return o ? o->score : -1.0; }
+
+// ---------- math and walls ----------
+double degToRad(int deg) { return RAD((double)deg); }
+int radToDeg(double rad) { return (int)DEG(rad); }
+int angleDiff(int angle1, int angle2)
+{
+    int difference = angle2 - angle1;
+    while (difference < -180) difference += 360;
+    while (difference > 180) difference -= 360;
+    return difference;
+}
+int angleAdd(int angle1, int angle2) { return ((angle1 + angle2) % 360 + 360) % 360; }
+
+// same contract as the client: distance to the wall, or dist when there is none
+int wallFeelerRad(int dist, double a)
+{
+    double t = simRayCast(&world.map, self()->x, self()->y, cos(a), sin(a), dist);
+    return t < 0.0 ? dist : (int)t;
+}
+int wallFeeler(int dist, int angle)
+{
+    int d;
+    simWallSweep(&world.map, self()->x, self()->y, dist, angle, 0, 1, &d, NULL, NULL);
+    return d;
+}
+int wallSweep(int dist, int startDeg, int stepDeg, int count, int out[], int *minIdx, int *maxIdx)
+{
+    if (!out) return 0;
+    return simWallSweep(&world.map, self()->x, self()->y, dist, startDeg, stepDeg, count, out, minIdx, maxIdx);
+}
+int wallBetween(int x1, int y1, int x2, int y2) { return simWallBetween(&world.map, x1, y1, x2, y2); }
+
+// ---------- shots ----------
+int shotAlert(int idx)
+{
+    if (idx < 0 || idx >= shotCount || shotBuf[idx].alert == 30000) return -1;
+    return shotBuf[idx].alert;
+}
+int shotX(int idx) { const SimShot *s = shotAt(idx); return s ? (int)s->x : -1; }
+int shotY(int idx) { const SimShot *s = shotAt(idx); return s ? (int)s->y : -1; }
+int shotDist(int idx) { return idx >= 0 && idx < shotCount ? (int)shotBuf[idx].dist : -1; }
+int shotVel(int idx) { const SimShot *s = shotAt(idx); return s ? (int)sqrt(s->vx * s->vx + s->vy * s->vy) : -1; }
+int shotVelDir(int idx) { const SimShot *s = shotAt(idx); return s ? (int)simWrapDeg(DEG(atan2(s->vy, s->vx))) : -1; }
+
+// Direction to fire so a shot leaving our ship meets enemy idx, -1 if it
+// cannot be reached.
+int aimdir(int idx)
+{
+    SimShip *o = enemyAt(idx), *me = self();
+    if (!o) return -1;
+    return simLeadAngle(o->x - me->x, o->y - me->y, o->vx - me->vx, o->vy - me->vy);
+}
+
+// ---------- capture the flag ----------
+int ballX() { return -1; }
+int ballY() { return -1; }
+int connectorX0() { return -1; }
+int connectorX1() { return -1; }
+int connectorY0() { return -1; }
+int connectorY1() { return -1; }
@@ -0,0 +1,114 @@
+// Builds the wall proximity field read by include/distField.h.
+// Distance to a block's square splits into a horizontal and a vertical part,
+// so the nearest wall is found in two passes: per block column the nearest
+// wall row for every cell row, then per cell a walk outwards over columns
+// that stops once the horizontal gap alone is worse than the best so far.
+#include "sim.h"
+#include "distField.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// gap between coordinate c and block b along one axis
+static double blockGap(double c, int b)
+{
+    double g = fabs(c - (b + 0.5) * SIM_BLOCK_SZ) - 0.5 * SIM_BLOCK_SZ;
+    return g > 0.0 ? g : 0.0;
+}
+
+int simDistFieldBuild(const SimMap *map, int sub, int8_t *cells)
+{
+    if (sub <= 0) return -1;
+    const int W = map->w, H = map->h;
+    const int cw = W * sub, ch = H * sub;
+    const int cols = W + 2;                  // columns -1..W, the outside is solid
+    const double cell = (double)SIM_BLOCK_SZ / sub;
+
+    // pass 1: nearest wall row of every column, per cell row
+    int *row = malloc((size_t)cols * ch * sizeof *row);
+    double *gap = malloc((size_t)cols * ch * sizeof *gap);
+    int *down = malloc((size_t)H * sizeof *down), *up = malloc((size_t)H * sizeof *up);
+    if (!row || !gap || !down || !up) {
+        free(row); free(gap); free(down); free(up);
+        return -1;
+    }
+    for (int c = 0; c < cols; c++) {
+        int bx = c - 1;
+        for (int by = 0, last = -1; by < H; by++) {
+            if (simMapWall(map, bx, by)) last = by;
+            down[by] = last;
+        }
+        for (int by = H - 1, last = H; by >= 0; by--) {
+            if (simMapWall(map, bx, by)) last = by;
+            up[by] = last;
+        }
+        for (int cy = 0; cy < ch; cy++) {
+            double y = (cy + 0.5) * cell;
+            int by = cy / sub;
+            double gd = blockGap(y, down[by]), gu = blockGap(y, up[by]);
+            row[c * ch + cy] = gd <= gu ? down[by] : up[by];
+            gap[c * ch + cy] = gd <= gu ? gd : gu;
+        }
+    }
+
+    // pass 2: best column per cell, walking out from the cell's own block
+    for (int cy = 0; cy < ch; cy++) {
+        int by = cy / sub;
+        for (int cx = 0; cx < cw; cx++) {
+            double x = (cx + 0.5) * cell;
+            int bx = cx / sub;
+            double best = INFINITY;
+            int bestC = -1;
+            for (int side = 0; side < 2; side++) {
+                int step = side ? 1 : -1;
+                for (int c = bx + 1 + (side ? 1 : 0); c >= 0 && c < cols; c += step) {
+                    double gx = blockGap(x, c - 1);
+                    if (gx * gx >= best) break;
+                    double gy = gap[c * ch + cy];
+                    double d = gx * gx + gy * gy;
+                    if (d < best) {
+                        best = d;
+                        bestC = c;
+                    }
+                }
+            }
+            int8_t *out = cells + 2 * ((size_t)cy * cw + cx);
+            int dx = bestC - 1 - bx, dy = bestC < 0 ? 0 : row[bestC * ch + cy] - by;
+            if (bestC < 0 || dx < -127 || dx > 127 || dy < -127 || dy > 127) {
+                out[0] = out[1] = DIST_FIELD_NONE;
+            } else {
+                out[0] = (int8_t)dx;
+                out[1] = (int8_t)dy;
+            }
+        }
+    }
+    free(row);
+    free(gap);
+    free(down);
+    free(up);
+    return 0;
+}
+
+int simDistFieldSave(const SimMap *map, int sub, const char *path)
+{
+    size_t n = 2 * (size_t)map->w * sub * map->h * sub;
+    int8_t *cells = malloc(n);
+    if (!cells || simDistFieldBuild(map, sub, cells) != 0) {
+        free(cells);
+        return -1;
+    }
+    DistFieldHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, DIST_FIELD_MAGIC, 4);
+    h.version = DIST_FIELD_VERSION;
+    h.w = map->w;
+    h.h = map->h;
+    h.sub = sub;
+    h.block = SIM_BLOCK_SZ;
+    FILE *f = fopen(path, "wb");
+    int ok = f && fwrite(&h, sizeof h, 1, f) == 1 && fwrite(cells, 1, n, f) == n;
+    if (f && fclose(f) != 0) ok = 0;
+    free(cells);
+    return ok ? 0 : -1;
+}
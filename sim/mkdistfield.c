@@ -0,0 +1,42 @@
+// Writes the wall proximity field of a map for include/distField.h.
+// Usage: ./mkdistfield [-map file.xp] [-sub N] out.df
+// Without -map it uses the sim's built-in arena.
+#include "sim.h"
+#include "distField.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char *argv[])
+{
+    const char *mapPath = NULL, *out = NULL;
+    int sub = DIST_FIELD_SUB;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-map") == 0 && i + 1 < argc) mapPath = argv[++i];
+        else if (strcmp(argv[i], "-sub") == 0 && i + 1 < argc) sub = atoi(argv[++i]);
+        else out = argv[i];
+    }
+    if (!out || sub <= 0) {
+        fprintf(stderr, "usage: %s [-map file.xp] [-sub N] out.df\n", argv[0]);
+        return 1;
+    }
+
+    SimMap map;
+    memset(&map, 0, sizeof map);
+    if (mapPath) {
+        if (simMapLoad(&map, mapPath) != 0) {
+            fprintf(stderr, "could not load map %s\n", mapPath);
+            return 1;
+        }
+    } else {
+        simMapDefault(&map);
+    }
+    if (simDistFieldSave(&map, sub, out) != 0) {
+        fprintf(stderr, "could not write %s\n", out);
+        simMapFree(&map);
+        return 1;
+    }
+    printf("%s: %dx%d blocks, %d cells per block side\n", out, map.w, map.h, sub);
+    simMapFree(&map);
+    return 0;
+}
@@ -0,0 +1,43 @@
+// Writes the feeler atlas of a map for include/rayAtlas.h.
+// Usage: ./mkrayatlas [-map file.xp] [-sub N] [-dist D] out.ra
+// Without -map it uses the sim's built-in arena.
+#include "sim.h"
+#include "rayAtlas.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char *argv[])
+{
+    const char *mapPath = NULL, *out = NULL;
+    int sub = RAY_ATLAS_SUB, dist = 1000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-map") == 0 && i + 1 < argc) mapPath = argv[++i];
+        else if (strcmp(argv[i], "-sub") == 0 && i + 1 < argc) sub = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-dist") == 0 && i + 1 < argc) dist = atoi(argv[++i]);
+        else out = argv[i];
+    }
+    if (!out || sub <= 0 || dist <= 0) {
+        fprintf(stderr, "usage: %s [-map file.xp] [-sub N] [-dist D] out.ra\n", argv[0]);
+        return 1;
+    }
+
+    SimMap map;
+    memset(&map, 0, sizeof map);
+    if (mapPath) {
+        if (simMapLoad(&map, mapPath) != 0) {
+            fprintf(stderr, "could not load map %s\n", mapPath);
+            return 1;
+        }
+    } else {
+        simMapDefault(&map);
+    }
+    if (simRayAtlasSave(&map, sub, dist, out) != 0) {
+        fprintf(stderr, "could not write %s\n", out);
+        simMapFree(&map);
+        return 1;
+    }
+    printf("%s: %dx%d blocks, %d samples per block side, rays up to %d pixels\n", out, map.w, map.h, sub, dist);
+    simMapFree(&map);
+    return 0;
+}
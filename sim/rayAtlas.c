@@ -0,0 +1,67 @@
+// Builds the feeler atlas read by include/rayAtlas.h: the block grid, then
+// one block-level DDA per sample point and whole degree, lengths kept to 1/8
+// pixel so the reader can interpolate between samples.
+#include "sim.h"
+#include "rayAtlas.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int simRayAtlasBuild(const SimMap *map, int sub, int maxDist, uint16_t *len)
+{
+    if (sub <= 0 || maxDist <= 0 || maxDist * RAY_ATLAS_SCALE > 65535) return -1;
+    const int gw = map->w * sub, gh = map->h * sub;
+    const double step = (double)SIM_BLOCK_SZ / sub;
+    double cs[RAY_ATLAS_ANGLES], sn[RAY_ATLAS_ANGLES];
+    for (int a = 0; a < RAY_ATLAS_ANGLES; a++) {
+        cs[a] = cos(a * M_PI / 180.0);
+        sn[a] = sin(a * M_PI / 180.0);
+    }
+    for (int j = 0; j <= gh; j++) {
+        for (int i = 0; i <= gw; i++) {
+            uint16_t *out = len + ((size_t)j * (gw + 1) + i) * RAY_ATLAS_ANGLES;
+            double x = i * step, y = j * step;
+            for (int a = 0; a < RAY_ATLAS_ANGLES; a++) {
+                double t = simRayCast(map, x, y, cs[a], sn[a], maxDist);
+                if (t < 0.0 || t > maxDist) t = maxDist;
+                out[a] = (uint16_t)lround(t * RAY_ATLAS_SCALE);
+            }
+        }
+    }
+    return 0;
+}
+
+int simRayAtlasSave(const SimMap *map, int sub, int maxDist, const char *path)
+{
+    size_t n = (size_t)(map->w * sub + 1) * (map->h * sub + 1) * RAY_ATLAS_ANGLES;
+    uint16_t *len = calloc(n + 1, sizeof *len); // +1: the padding the reader's gathers need
+    if (!len || simRayAtlasBuild(map, sub, maxDist, len) != 0) {
+        free(len);
+        return -1;
+    }
+    RayAtlasHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, RAY_ATLAS_MAGIC, 4);
+    h.version = RAY_ATLAS_VERSION;
+    h.w = map->w;
+    h.h = map->h;
+    h.sub = sub;
+    h.block = SIM_BLOCK_SZ;
+    h.maxDist = maxDist;
+    h.angles = RAY_ATLAS_ANGLES;
+    size_t nb = RAY_ATLAS_BLOCKS_SIZE(map->w, map->h);
+    uint8_t *blocks = calloc(nb, 1);
+    if (!blocks) {
+        free(len);
+        return -1;
+    }
+    for (size_t i = 0; i < (size_t)map->w * map->h; i++) blocks[i] = map->blocks[i] ? 1 : 0;
+    FILE *f = fopen(path, "wb");
+    int ok = f && fwrite(&h, sizeof h, 1, f) == 1 && fwrite(blocks, 1, nb, f) == nb &&
+             fwrite(len, sizeof *len, n + 1, f) == n + 1;
+    if (f && fclose(f) != 0) ok = 0;
+    free(blocks);
+    free(len);
+    return ok ? 0 : -1;
+}
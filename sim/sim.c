@@ -0,0 +1,518 @@
+// Headless XPilot world: map, ray casting and a simplified ship/shot physics
+// step.  See sim.h for the units.
+#include "sim.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#define RAD(x) ((x) * M_PI / 180.0)
+#define DEG(x) ((x) * 180.0 / M_PI)
+
+// ---------- map ----------
+
+static void mapAlloc(SimMap *map, int w, int h)
+{
+    map->w = w;
+    map->h = h;
+    map->blocks = calloc((size_t)w * (size_t)h, 1);
+    map->baseCount = 0;
+}
+
+static void mapAddBase(SimMap *map, int bx, int by)
+{
+    if (map->baseCount >= SIM_MAX_BASES) return;
+    map->baseX[map->baseCount] = bx;
+    map->baseY[map->baseCount] = by;
+    map->baseCount++;
+}
+
+// 32x32 block arena with a border and a handful of pillars, roughly the
+// layout of the small practice maps the bots were tuned on.
+void simMapDefault(SimMap *map)
+{
+    const int W = 32, H = 32;
+    mapAlloc(map, W, H);
+    for (int i = 0; i < W; i++) {
+        map->blocks[i] = 1;
+        map->blocks[(H - 1) * W + i] = 1;
+    }
+    for (int j = 0; j < H; j++) {
+        map->blocks[j * W] = 1;
+        map->blocks[j * W + W - 1] = 1;
+    }
+    static const int pillars[][4] = { // x, y, w, h
+        { 7, 7, 3, 3 }, { 22, 7, 3, 3 }, { 7, 22, 3, 3 }, { 22, 22, 3, 3 },
+        { 15, 14, 2, 4 }, { 12, 1, 1, 4 }, { 19, 27, 1, 4 }, { 1, 16, 4, 1 }, { 27, 15, 4, 1 },
+    };
+    for (size_t p = 0; p < sizeof(pillars) / sizeof(pillars[0]); p++)
+        for (int y = pillars[p][1]; y < pillars[p][1] + pillars[p][3]; y++)
+            for (int x = pillars[p][0]; x < pillars[p][0] + pillars[p][2]; x++)
+                map->blocks[y * W + x] = 1;
+    mapAddBase(map, 4, 4);
+    mapAddBase(map, 27, 27);
+    mapAddBase(map, 4, 27);
+    mapAddBase(map, 27, 4);
+}
+
+static int isWallChar(char c)
+{
+    // full blocks, the four diagonal blocks and cannons are all treated as solid
+    return c == 'x' || c == 'a' || c == 's' || c == 'q' || c == 'w' ||
+           c == 'r' || c == 'c' || c == 'd' || c == 'f';
+}
+
+static int getMapInt(const char *line, const char *key, int *out)
+{
+    size_t n = strlen(key);
+    if (strncmp(line, key, n) != 0 || line[n] != ':') return 0;
+    *out = atoi(line + n + 1);
+    return 1;
+}
+
+// Reads the mapWidth/mapHeight/mapData fields of an XPilot .xp map.
+// Returns 0 on success.
+int simMapLoad(SimMap *map, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    char line[4096];
+    int w = 0, h = 0, inData = 0, row = 0;
+    char terminator[64] = "EndOfMapdata";
+    char **rows = NULL;
+    while (fgets(line, sizeof line, f)) {
+        size_t len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+        if (!inData) {
+            const char *p = line;
+            while (isspace((unsigned char)*p)) ++p;
+            getMapInt(p, "mapWidth", &w);
+            getMapInt(p, "mapHeight", &h);
+            if (strncmp(p, "mapData:", 8) == 0) {
+                const char *m = strstr(p, "\\multiline:");
+                if (m) sscanf(m + 11, " %63s", terminator);
+                inData = 1;
+            }
+            continue;
+        }
+        if (strcmp(line, terminator) == 0) break;
+        rows = realloc(rows, (size_t)(row + 1) * sizeof(char *));
+        rows[row++] = strdup(line);
+    }
+    fclose(f);
+
+    if (h <= 0) h = row;
+    if (w <= 0)
+        for (int i = 0; i < row; i++) w = (int)strlen(rows[i]) > w ? (int)strlen(rows[i]) : w;
+    if (w <= 0 || h <= 0 || row == 0) {
+        for (int i = 0; i < row; i++) free(rows[i]);
+        free(rows);
+        return -1;
+    }
+
+    mapAlloc(map, w, h);
+    // the file lists the top row first, the server has y pointing up
+    for (int i = 0; i < row && i < h; i++) {
+        int by = h - 1 - i;
+        int len = (int)strlen(rows[i]);
+        for (int bx = 0; bx < w && bx < len; bx++) {
+            char c = rows[i][bx];
+            if (isWallChar(c)) map->blocks[by * w + bx] = 1;
+            else if (c == '_' || isdigit((unsigned char)c)) mapAddBase(map, bx, by);
+        }
+    }
+    for (int i = 0; i < row; i++) free(rows[i]);
+    free(rows);
+    return 0;
+}
+
+void simMapFree(SimMap *map)
+{
+    free(map->blocks);
+    map->blocks = NULL;
+    map->w = map->h = 0;
+}
+
+// ---------- ray casting ----------
+
+// Block-level DDA: visits each block the ray crosses exactly once instead of
+// testing every pixel like the client's wallBetween.
+double simRayCast(const SimMap *map, double x, double y, double dirX, double dirY, double maxDist)
+{
+    const double B = SIM_BLOCK_SZ;
+    int bx = (int)floor(x / B);
+    int by = (int)floor(y / B);
+    if (simMapWall(map, bx, by)) return 0.0;
+
+    int stepX = dirX > 0 ? 1 : (dirX < 0 ? -1 : 0);
+    int stepY = dirY > 0 ? 1 : (dirY < 0 ? -1 : 0);
+    double tMaxX = stepX > 0 ? ((bx + 1) * B - x) / dirX : stepX < 0 ? (bx * B - x) / dirX : INFINITY;
+    double tMaxY = stepY > 0 ? ((by + 1) * B - y) / dirY : stepY < 0 ? (by * B - y) / dirY : INFINITY;
+    double tDeltaX = stepX ? B / fabs(dirX) : INFINITY;
+    double tDeltaY = stepY ? B / fabs(dirY) : INFINITY;
+
+    for (;;) {
+        double t;
+        if (tMaxX < tMaxY) {
+            t = tMaxX;
+            tMaxX += tDeltaX;
+            bx += stepX;
+        } else {
+            t = tMaxY;
+            tMaxY += tDeltaY;
+            by += stepY;
+        }
+        if (t > maxDist) return -1.0;
+        if (simMapWall(map, bx, by)) return t;
+    }
+}
+
+// unit vectors for whole degrees, the angles the cAI feelers take
+static double degCos[360], degSin[360];
+
+__attribute__((constructor)) static void initDegTable(void)
+{
+    for (int d = 0; d < 360; d++) {
+        degCos[d] = cos(RAD((double)d));
+        degSin[d] = sin(RAD((double)d));
+    }
+}
+
+// count feelers at startDeg + i*stepDeg.  The table replaces a sincos per ray
+// and the start block, its wall test and the in-block offsets are worked out
+// once for the whole sweep; each ray then only runs the DDA loop itself.
+int simWallSweep(const SimMap *map, double x, double y, int dist, int startDeg, int stepDeg, int count,
+                 int *out, int *minIdx, int *maxIdx)
+{
+    const double B = SIM_BLOCK_SZ;
+    if (count <= 0) return 0;
+    int bx0 = (int)floor(x / B), by0 = (int)floor(y / B);
+    int inWall = simMapWall(map, bx0, by0);
+    double fxHi = (bx0 + 1) * B - x, fxLo = bx0 * B - x;
+    double fyHi = (by0 + 1) * B - y, fyLo = by0 * B - y;
+    int deg = ((startDeg % 360) + 360) % 360, step = ((stepDeg % 360) + 360) % 360;
+
+    for (int i = 0; i < count; i++, deg = (deg + step) % 360) {
+        if (inWall) {
+            out[i] = 0;
+            continue;
+        }
+        double dirX = degCos[deg], dirY = degSin[deg];
+        int bx = bx0, by = by0;
+        int stepX = dirX > 0 ? 1 : (dirX < 0 ? -1 : 0);
+        int stepY = dirY > 0 ? 1 : (dirY < 0 ? -1 : 0);
+        double tMaxX = stepX > 0 ? fxHi / dirX : stepX < 0 ? fxLo / dirX : INFINITY;
+        double tMaxY = stepY > 0 ? fyHi / dirY : stepY < 0 ? fyLo / dirY : INFINITY;
+        double tDeltaX = stepX ? B / fabs(dirX) : INFINITY;
+        double tDeltaY = stepY ? B / fabs(dirY) : INFINITY;
+        int hit = dist;
+        for (;;) {
+            double t;
+            if (tMaxX < tMaxY) {
+                t = tMaxX;
+                tMaxX += tDeltaX;
+                bx += stepX;
+            } else {
+                t = tMaxY;
+                tMaxY += tDeltaY;
+                by += stepY;
+            }
+            if (t > dist) break;
+            if (simMapWall(map, bx, by)) {
+                hit = (int)t;
+                break;
+            }
+        }
+        out[i] = hit;
+    }
+
+    // first index wins on ties, like the hand-written feeler loops
+    int lo = 0, hi = 0;
+    for (int i = 1; i < count; i++) {
+        if (out[i] < out[lo]) lo = i;
+        if (out[i] > out[hi]) hi = i;
+    }
+    if (minIdx) *minIdx = lo;
+    if (maxIdx) *maxIdx = hi;
+    return count;
+}
+
+int simWallBetween(const SimMap *map, double x1, double y1, double x2, double y2)
+{
+    double dx = x2 - x1, dy = y2 - y1;
+    double len = sqrt(dx * dx + dy * dy);
+    if (len <= 0.0) return simMapWall(map, (int)floor(x1 / SIM_BLOCK_SZ), (int)floor(y1 / SIM_BLOCK_SZ)) ? 0 : -1;
+    double t = simRayCast(map, x1, y1, dx / len, dy / len, len);
+    return t < 0.0 ? -1 : (int)t;
+}
+
+// ---------- world ----------
+
+uint64_t simRand(SimWorld *w)
+{
+    // splitmix64
+    uint64_t z = (w->rng += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+double simRandDouble(SimWorld *w)
+{
+    return (double)(simRand(w) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+int simCircleHitsWall(const SimMap *map, double x, double y, double r)
+{
+    const double B = SIM_BLOCK_SZ;
+    int x0 = (int)floor((x - r) / B), x1 = (int)floor((x + r) / B);
+    int y0 = (int)floor((y - r) / B), y1 = (int)floor((y + r) / B);
+    for (int by = y0; by <= y1; by++) {
+        for (int bx = x0; bx <= x1; bx++) {
+            if (!simMapWall(map, bx, by)) continue;
+            double cx = fmax(bx * B, fmin(x, (bx + 1) * B));
+            double cy = fmax(by * B, fmin(y, (by + 1) * B));
+            if ((cx - x) * (cx - x) + (cy - y) * (cy - y) < r * r) return 1;
+        }
+    }
+    return 0;
+}
+
+// Danger rating of a shot at relative position (rx,ry) moving with relative
+// velocity (vx,vy): closest-approach miss distance plus the number of frames
+// until that approach.  Lower is more dangerous, -1 when it is moving away.
+int simShotAlert(double rx, double ry, double vx, double vy)
+{
+    double vv = vx * vx + vy * vy;
+    if (vv <= 0.0) return -1;
+    double t = -(rx * vx + ry * vy) / vv;
+    if (t < 0.0) return -1;
+    double mx = rx + vx * t, my = ry + vy * t;
+    int alert = (int)(sqrt(mx * mx + my * my) + t);
+    return alert < 1 ? 1 : alert;
+}
+
+// Direction to fire so a shot meets a target at relative position (rx,ry)
+// with relative velocity (vx,vy); -1 if it cannot be reached.
+int simLeadAngle(double rx, double ry, double vx, double vy)
+{
+    double a = vx * vx + vy * vy - SIM_SHOT_SPEED * SIM_SHOT_SPEED;
+    double b = 2.0 * (rx * vx + ry * vy);
+    double c = rx * rx + ry * ry;
+    double t;
+    if (fabs(a) < 1e-9) {
+        if (fabs(b) < 1e-9) return -1;
+        t = -c / b;
+    } else {
+        double disc = b * b - 4.0 * a * c;
+        if (disc < 0.0) return -1;
+        double s = sqrt(disc);
+        double t1 = (-b - s) / (2.0 * a), t2 = (-b + s) / (2.0 * a);
+        t = t1 > 0 && (t1 < t2 || t2 <= 0) ? t1 : t2;
+    }
+    if (t <= 0.0) return -1;
+    return (int)simWrapDeg(DEG(atan2(ry + vy * t, rx + vx * t)));
+}
+
+// Scripted opponent: face the target, keep moving, shoot when lined up.
+// rnd is a uniform [0,1) draw from the caller's generator.
+SimDummyOut simDummyDecide(const SimMap *map, double x, double y, double vx, double vy, double heading,
+                           int hasTarget, double tx, double ty, double rnd)
+{
+    SimDummyOut out = { 0, 0, 0.0, 0, 0 };
+    double front = simRayCast(map, x, y, cos(RAD(heading)), sin(RAD(heading)), 300);
+    double speed = sqrt(vx * vx + vy * vy);
+    if (front >= 0 && front < 120) {
+        out.turnLeft = 1; // steer away from walls first
+    } else if (hasTarget) {
+        double want = simWrapDeg(DEG(atan2(ty - y, tx - x)));
+        double diff = simWrapDeg(want - heading + 180.0) - 180.0;
+        double d2 = (tx - x) * (tx - x) + (ty - y) * (ty - y);
+        out.turnRequest = diff;
+        out.hasTurnRequest = 1;
+        if (fabs(diff) < 10.0 && d2 < 700.0 * 700.0 && rnd < 0.3) out.fire = 1;
+    }
+    out.thrust = speed < 4.0 && (front < 0 || front > 150);
+    return out;
+}
+
+void simShipSpawn(SimWorld *w, SimShip *s)
+{
+    const SimMap *map = &w->map;
+    double x = 0, y = 0;
+    int placed = 0;
+    if (map->baseCount > 0) {
+        int b = (int)(simRand(w) % (uint64_t)map->baseCount);
+        x = (map->baseX[b] + 0.5) * SIM_BLOCK_SZ;
+        y = (map->baseY[b] + 0.5) * SIM_BLOCK_SZ;
+        placed = !simCircleHitsWall(map, x, y, SIM_SHIP_RADIUS);
+    }
+    for (int tries = 0; !placed && tries < 10000; tries++) {
+        x = (simRand(w) % (uint64_t)map->w + 0.5) * SIM_BLOCK_SZ;
+        y = (simRand(w) % (uint64_t)map->h + 0.5) * SIM_BLOCK_SZ;
+        placed = !simCircleHitsWall(map, x, y, SIM_SHIP_RADIUS * 2);
+    }
+    s->x = x;
+    s->y = y;
+    s->vx = s->vy = 0.0;
+    s->heading = (double)(simRand(w) % 360);
+    s->thrusting = s->turningLeft = s->turningRight = 0;
+    s->hasTurnRequest = 0;
+    s->fire = 0;
+    s->reload = 0;
+    s->alive = 1;
+    s->deadTicks = 0;
+}
+
+void simWorldInit(SimWorld *w, int enemies, uint64_t seed)
+{
+    // keep the map if the caller already loaded one
+    SimMap map = w->map;
+    memset(w, 0, sizeof *w);
+    w->map = map;
+    if (!w->map.blocks) simMapDefault(&w->map);
+    w->rng = seed;
+
+    if (enemies > SIM_MAX_SHIPS - 1) enemies = SIM_MAX_SHIPS - 1;
+    if (enemies < 0) enemies = 0;
+    w->shipCount = 1 + enemies;
+    for (int i = 0; i < w->shipCount; i++) {
+        SimShip *s = &w->ships[i];
+        s->id = i;
+        s->team = i == 0 ? 1 : 2;
+        s->power = 45.0;
+        s->turnSpeed = 20.0;
+        snprintf(s->name, sizeof s->name, i == 0 ? "Self" : "Dummy%d", i);
+        simShipSpawn(w, s);
+    }
+}
+
+void simWorldFree(SimWorld *w)
+{
+    simMapFree(&w->map);
+}
+
+static void killShip(SimWorld *w, SimShip *s)
+{
+    (void)w;
+    s->alive = 0;
+    s->deadTicks = SIM_RESPAWN;
+    s->deaths++;
+    s->score -= 1.0;
+}
+
+static void dummyControl(SimWorld *w, SimShip *s)
+{
+    SimShip *target = NULL;
+    double best = 1e18;
+    for (int i = 0; i < w->shipCount; i++) {
+        SimShip *o = &w->ships[i];
+        if (o == s || !o->alive || o->team == s->team) continue;
+        double d = (o->x - s->x) * (o->x - s->x) + (o->y - s->y) * (o->y - s->y);
+        if (d < best) { best = d; target = o; }
+    }
+    SimDummyOut c = simDummyDecide(&w->map, s->x, s->y, s->vx, s->vy, s->heading,
+                                   target != NULL, target ? target->x : 0.0, target ? target->y : 0.0,
+                                   simRandDouble(w));
+    s->turningLeft = c.turnLeft;
+    s->turningRight = 0;
+    s->turnRequest = c.turnRequest;
+    s->hasTurnRequest = c.hasTurnRequest;
+    s->thrusting = c.thrust;
+    if (c.fire) s->fire = 1;
+}
+
+static void stepShip(SimWorld *w, int idx)
+{
+    SimShip *s = &w->ships[idx];
+    if (!s->alive) {
+        if (--s->deadTicks <= 0) simShipSpawn(w, s);
+        return;
+    }
+
+    double rate = s->turnSpeed * 360.0 / 128.0;
+    if (s->hasTurnRequest) {
+        double d = s->turnRequest;
+        if (d > rate) d = rate;
+        if (d < -rate) d = -rate;
+        s->heading = simWrapDeg(s->heading + d);
+        s->hasTurnRequest = 0;
+    } else if (s->turningLeft != s->turningRight) {
+        s->heading = simWrapDeg(s->heading + (s->turningLeft ? rate : -rate));
+    }
+
+    double hx = cos(RAD(s->heading)), hy = sin(RAD(s->heading));
+    if (s->thrusting) {
+        double a = s->power / SIM_SHIP_MASS;
+        s->vx += a * hx;
+        s->vy += a * hy;
+    }
+
+    // substep so fast ships cannot tunnel through a block
+    double speed = sqrt(s->vx * s->vx + s->vy * s->vy);
+    int steps = 1 + (int)(speed / (SIM_SHIP_RADIUS * 0.5));
+    for (int k = 0; k < steps; k++) {
+        s->x += s->vx / steps;
+        s->y += s->vy / steps;
+        if (simCircleHitsWall(&w->map, s->x, s->y, SIM_SHIP_RADIUS)) {
+            killShip(w, s);
+            return;
+        }
+    }
+
+    if (s->reload > 0) s->reload--;
+    if (s->fire && s->reload == 0 && w->shotCount < SIM_MAX_SHOTS) {
+        SimShot *sh = &w->shots[w->shotCount++];
+        sh->x = s->x + hx * (SIM_SHIP_RADIUS + 1.0);
+        sh->y = s->y + hy * (SIM_SHIP_RADIUS + 1.0);
+        sh->vx = s->vx + hx * SIM_SHOT_SPEED;
+        sh->vy = s->vy + hy * SIM_SHOT_SPEED;
+        sh->life = SIM_SHOT_LIFE;
+        sh->owner = idx;
+        s->reload = SIM_RELOAD;
+    }
+    s->fire = 0;
+}
+
+static void stepShots(SimWorld *w)
+{
+    int n = 0;
+    for (int i = 0; i < w->shotCount; i++) {
+        SimShot sh = w->shots[i];
+        double len = sqrt(sh.vx * sh.vx + sh.vy * sh.vy);
+        int dead = --sh.life <= 0;
+        if (!dead && len > 0.0 && simRayCast(&w->map, sh.x, sh.y, sh.vx / len, sh.vy / len, len) >= 0.0) dead = 1;
+        sh.x += sh.vx;
+        sh.y += sh.vy;
+        for (int k = 0; !dead && k < w->shipCount; k++) {
+            SimShip *s = &w->ships[k];
+            if (!s->alive || k == sh.owner) continue;
+            double dx = s->x - sh.x, dy = s->y - sh.y;
+            if (dx * dx + dy * dy < SIM_SHIP_RADIUS * SIM_SHIP_RADIUS) {
+                dead = 1;
+                if (s->shield) continue;
+                killShip(w, s);
+                w->ships[sh.owner].kills++;
+                w->ships[sh.owner].score += 2.0;
+            }
+        }
+        if (!dead) w->shots[n++] = sh;
+    }
+    w->shotCount = n;
+}
+
+// Advances the world by one frame.  Ship 0's controls must already be set
+// by the caller; the scripted ships decide here.
+void simWorldStep(SimWorld *w)
+{
+    for (int i = 1; i < w->shipCount; i++)
+        if (w->ships[i].alive) dummyControl(w, &w->ships[i]);
+    for (int i = 0; i < w->shipCount; i++) stepShip(w, i);
+    stepShots(w);
+    w->tick++;
+}
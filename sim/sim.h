@@ -0,0 +1,127 @@
+// Headless XPilot world model used by libcAI_sim.so.
+// Everything runs in-process and deterministically from a seed: no X server,
+// no network, no frame limiter.
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+#define SIM_BLOCK_SZ 35        // pixels per map block, same as the XPilot server
+#define SIM_FPS 24             // only used to report game-time equivalents
+#define SIM_SHIP_RADIUS 16.0
+#define SIM_SHIP_MASS 20.0
+#define SIM_SHOT_SPEED 21.0
+#define SIM_SHOT_LIFE 60       // ticks
+#define SIM_RELOAD 6           // ticks between shots
+#define SIM_RESPAWN 48         // ticks spent dead before respawning
+#define SIM_MAX_SHIPS 16
+#define SIM_MAX_SHOTS 512
+#define SIM_MAX_BASES 32
+#define SIM_SCREEN_W 1024      // visible area used for the "screen" enemy and shot buffers
+#define SIM_SCREEN_H 768
+
+typedef struct {
+    int w, h;                  // size in blocks
+    unsigned char *blocks;     // w*h, 1 = wall; row 0 is the bottom of the map
+    int baseCount;
+    int baseX[SIM_MAX_BASES];  // block coordinates of '_' bases
+    int baseY[SIM_MAX_BASES];
+} SimMap;
+
+typedef struct {
+    double x, y;               // pixels, y grows upwards like the server
+    double vx, vy;
+    double heading;            // degrees [0,360)
+    double power;              // 5..55
+    double turnSpeed;          // XPilot turn units 4..64, 128 units per revolution
+    int thrusting;
+    int turningLeft;
+    int turningRight;
+    double turnRequest;        // degrees still to turn from turn()/turnToDeg()
+    int hasTurnRequest;
+    int fire;                  // fire on the next step
+    int reload;
+    int alive;
+    int deadTicks;
+    int shield;
+    int team;
+    int id;
+    int deaths;
+    int kills;
+    double score;
+    char name[32];
+} SimShip;
+
+typedef struct {
+    double x, y;
+    double vx, vy;
+    int life;
+    int owner;                 // ship index
+} SimShot;
+
+typedef struct {
+    SimMap map;
+    SimShip ships[SIM_MAX_SHIPS];
+    int shipCount;             // ship 0 is the AI under test, the rest are scripted
+    SimShot shots[SIM_MAX_SHOTS];
+    int shotCount;
+    uint64_t rng;
+    long tick;
+} SimWorld;
+
+// map
+int simMapLoad(SimMap *map, const char *path);
+void simMapDefault(SimMap *map);
+void simMapFree(SimMap *map);
+static inline int simMapWall(const SimMap *map, int bx, int by)
+{
+    if (bx < 0 || by < 0 || bx >= map->w || by >= map->h) return 1; // outside the map is solid
+    return map->blocks[by * map->w + bx];
+}
+
+typedef struct {
+    int thrust;
+    int turnLeft;
+    double turnRequest;
+    int hasTurnRequest;
+    int fire;
+} SimDummyOut;
+
+// ray casting, distances in pixels; both return -1 when nothing is hit
+double simRayCast(const SimMap *map, double x, double y, double dirX, double dirY, double maxDist);
+int simWallBetween(const SimMap *map, double x1, double y1, double x2, double y2);
+int simCircleHitsWall(const SimMap *map, double x, double y, double r);
+// out[i] = wall distance (or dist) at startDeg + i*stepDeg whole degrees; min/max indexes are optional
+int simWallSweep(const SimMap *map, double x, double y, int dist, int startDeg, int stepDeg, int count,
+                 int *out, int *minIdx, int *maxIdx);
+
+// wall proximity field (distField.c), file layout and queries in include/distField.h
+int simDistFieldBuild(const SimMap *map, int sub, int8_t *cells); // cells: 2*(w*sub)*(h*sub) bytes
+int simDistFieldSave(const SimMap *map, int sub, const char *path);
+
+// feeler atlas (rayAtlas.c), file layout and queries in include/rayAtlas.h
+int simRayAtlasBuild(const SimMap *map, int sub, int maxDist, uint16_t *len); // len: (w*sub+1)*(h*sub+1)*360
+int simRayAtlasSave(const SimMap *map, int sub, int maxDist, const char *path);
+
+// sensing and the scripted opponent, shared by the single world and SimBatch
+int simShotAlert(double rx, double ry, double vx, double vy);
+int simLeadAngle(double rx, double ry, double vx, double vy);
+SimDummyOut simDummyDecide(const SimMap *map, double x, double y, double vx, double vy, double heading,
+                           int hasTarget, double tx, double ty, double rnd);
+
+// world
+void simWorldInit(SimWorld *w, int enemies, uint64_t seed);
+void simWorldFree(SimWorld *w);
+void simWorldStep(SimWorld *w);
+void simShipSpawn(SimWorld *w, SimShip *s);
+uint64_t simRand(SimWorld *w);
+double simRandDouble(SimWorld *w);
+
+static inline double simWrapDeg(double a)
+{
+    while (a >= 360.0) a -= 360.0;
+    while (a < 0.0) a += 360.0;
+    return a;
+}
+
+#endif
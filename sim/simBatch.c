@@ -0,0 +1,425 @@
+// Batched structure-of-arrays simulator used to score a whole GA population
+// in one process.  Same physics as sim.c, but every field lives in its own
+// array and worker threads own contiguous instance ranges.
+#include "simBatch.h"
+#include "gaRules.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#define RAD(x) ((x) * M_PI / 180.0)
+#define DEG(x) ((x) * 180.0 / M_PI)
+
+static uint64_t laneRand(SimBatch *b, int inst)
+{
+    uint64_t z = (b->rng[inst] += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static double laneRandDouble(SimBatch *b, int inst)
+{
+    return (double)(laneRand(b, inst) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+SimBatch *simBatchCreate(const SimMap *map, int n, int enemies)
+{
+    SimBatch *b = calloc(1, sizeof(SimBatch));
+    if (!b) return NULL;
+    b->map = map;
+    b->n = n;
+    b->ships = 1 + (enemies < 0 ? 0 : enemies);
+    size_t lanes = (size_t)n * (size_t)b->ships;
+    size_t shots = (size_t)n * SIM_BATCH_SHOTS;
+    b->x = calloc(lanes, sizeof(double));
+    b->y = calloc(lanes, sizeof(double));
+    b->vx = calloc(lanes, sizeof(double));
+    b->vy = calloc(lanes, sizeof(double));
+    b->heading = calloc(lanes, sizeof(double));
+    b->turnDelta = calloc(lanes, sizeof(double));
+    b->thrust = calloc(lanes, 1);
+    b->fire = calloc(lanes, 1);
+    b->alive = calloc(lanes, 1);
+    b->deadTicks = calloc(lanes, sizeof(int));
+    b->reload = calloc(lanes, sizeof(int));
+    b->sx = calloc(shots, sizeof(double));
+    b->sy = calloc(shots, sizeof(double));
+    b->svx = calloc(shots, sizeof(double));
+    b->svy = calloc(shots, sizeof(double));
+    b->slife = calloc(shots, sizeof(int));
+    b->sowner = calloc(shots, sizeof(int));
+    b->shotCount = calloc((size_t)n, sizeof(int));
+    b->rng = calloc((size_t)n, sizeof(uint64_t));
+    b->deaths = calloc((size_t)n, sizeof(int));
+    b->kills = calloc((size_t)n, sizeof(int));
+    b->aliveTicks = calloc((size_t)n, sizeof(long));
+    if (!b->x || !b->y || !b->vx || !b->vy || !b->heading || !b->turnDelta || !b->thrust || !b->fire ||
+        !b->alive || !b->deadTicks || !b->reload || !b->sx || !b->sy || !b->svx || !b->svy || !b->slife ||
+        !b->sowner || !b->shotCount || !b->rng || !b->deaths || !b->kills || !b->aliveTicks) {
+        simBatchFree(b);
+        return NULL;
+    }
+    return b;
+}
+
+void simBatchFree(SimBatch *b)
+{
+    if (!b) return;
+    free(b->x); free(b->y); free(b->vx); free(b->vy); free(b->heading); free(b->turnDelta);
+    free(b->thrust); free(b->fire); free(b->alive); free(b->deadTicks); free(b->reload);
+    free(b->sx); free(b->sy); free(b->svx); free(b->svy); free(b->slife); free(b->sowner);
+    free(b->shotCount); free(b->rng); free(b->deaths); free(b->kills); free(b->aliveTicks);
+    free(b);
+}
+
+static void spawnLane(SimBatch *b, int inst, int lane)
+{
+    const SimMap *map = b->map;
+    double x = 0, y = 0;
+    int placed = 0;
+    if (map->baseCount > 0) {
+        int k = (int)(laneRand(b, inst) % (uint64_t)map->baseCount);
+        x = (map->baseX[k] + 0.5) * SIM_BLOCK_SZ;
+        y = (map->baseY[k] + 0.5) * SIM_BLOCK_SZ;
+        placed = !simCircleHitsWall(map, x, y, SIM_SHIP_RADIUS);
+    }
+    for (int tries = 0; !placed && tries < 10000; tries++) {
+        x = (laneRand(b, inst) % (uint64_t)map->w + 0.5) * SIM_BLOCK_SZ;
+        y = (laneRand(b, inst) % (uint64_t)map->h + 0.5) * SIM_BLOCK_SZ;
+        placed = !simCircleHitsWall(map, x, y, SIM_SHIP_RADIUS * 2);
+    }
+    b->x[lane] = x;
+    b->y[lane] = y;
+    b->vx[lane] = b->vy[lane] = 0.0;
+    b->heading[lane] = (double)(laneRand(b, inst) % 360);
+    b->turnDelta[lane] = 0.0;
+    b->thrust[lane] = b->fire[lane] = 0;
+    b->reload[lane] = 0;
+    b->alive[lane] = 1;
+    b->deadTicks[lane] = 0;
+}
+
+void simBatchReset(SimBatch *b, int lo, int hi, uint64_t seed)
+{
+    for (int i = lo; i < hi; i++) {
+        b->rng[i] = seed;
+        b->shotCount[i] = 0;
+        b->deaths[i] = b->kills[i] = 0;
+        b->aliveTicks[i] = 0;
+        for (int k = 0; k < b->ships; k++) spawnLane(b, i, i * b->ships + k);
+    }
+}
+
+// ---------- sensing ----------
+
+int simBatchFeeler(const SimBatch *b, int lane, int dist, int angleDeg)
+{
+    int d;
+    simWallSweep(b->map, b->x[lane], b->y[lane], dist, angleDeg, 0, 1, &d, NULL, NULL);
+    return d;
+}
+
+static int onScreen(double dx, double dy)
+{
+    return fabs(dx) <= SIM_SCREEN_W / 2 && fabs(dy) <= SIM_SCREEN_H / 2;
+}
+
+int simBatchAimDir(const SimBatch *b, int inst)
+{
+    int me = inst * b->ships, best = -1;
+    double bestD = 1e18;
+    for (int k = 1; k < b->ships; k++) {
+        int o = me + k;
+        if (!b->alive[o]) continue;
+        double dx = b->x[o] - b->x[me], dy = b->y[o] - b->y[me];
+        if (!onScreen(dx, dy)) continue;
+        double d = dx * dx + dy * dy;
+        if (d < bestD) { bestD = d; best = o; }
+    }
+    if (best < 0) return -1;
+    return simLeadAngle(b->x[best] - b->x[me], b->y[best] - b->y[me],
+                        b->vx[best] - b->vx[me], b->vy[best] - b->vy[me]);
+}
+
+int simBatchShotAlert(const SimBatch *b, int inst)
+{
+    int me = inst * b->ships, best = -1;
+    for (int s = inst * SIM_BATCH_SHOTS, e = s + b->shotCount[inst]; s < e; s++) {
+        if (b->sowner[s] == 0) continue;
+        double dx = b->sx[s] - b->x[me], dy = b->sy[s] - b->y[me];
+        if (!onScreen(dx, dy)) continue;
+        int a = simShotAlert(dx, dy, b->svx[s] - b->vx[me], b->svy[s] - b->vy[me]);
+        if (a >= 0 && (best < 0 || a < best)) best = a;
+    }
+    return best;
+}
+
+// Same feature extraction as GASmarty's AI_loop.
+void simBatchRulePolicy(SimBatch *b, int inst, const void *ctx)
+{
+    const Chromosome *chromosome = ctx;
+    int me = inst * b->ships;
+    const double rate = 20.0; // setTurnSpeedDeg(20)
+
+    int aimDir = simBatchAimDir(b, inst);
+    double heading = (int)b->heading[me];
+    double speed = sqrt(b->vx[me] * b->vx[me] + b->vy[me] * b->vy[me]);
+    double tracking = speed > 0.0 ? (int)simWrapDeg(DEG(atan2(b->vy[me], b->vx[me]))) : 0.0;
+
+    int walls[360];
+    int closestAngle, furthestAngle;
+    simWallSweep(b->map, b->x[me], b->y[me], 500, (int)heading, 1, 360, walls, &closestAngle, &furthestAngle);
+    double furthest = walls[furthestAngle];
+    double closest = walls[closestAngle];
+    int headingTrackingDiff = (int)(heading + 360 - tracking) % 360;
+    int headingAimingDiff = (int)(heading + 360 - aimDir) % 360;
+    State s = {
+        aimDir,
+        walls[0],
+        walls[150],
+        walls[180],
+        walls[210],
+        heading,
+        tracking,
+        simBatchFeeler(b, me, 500, (int)tracking),
+        closest,
+        closestAngle,
+        furthest,
+        furthestAngle,
+        simBatchShotAlert(b, inst),
+        (int)speed,
+        headingTrackingDiff,
+        headingAimingDiff,
+    };
+
+    int shouldThrust, turnDir;
+    gaRulesDecide(&s, chromosome, &shouldThrust, &turnDir);
+
+    b->thrust[me] = shouldThrust ? 1 : 0;
+    b->fire[me] = headingAimingDiff < 90 || headingAimingDiff > 270;
+    if (turnDir == 2) {
+        double d = simWrapDeg(aimDir - b->heading[me] + 180.0) - 180.0;
+        b->turnDelta[me] = fmax(-rate, fmin(rate, d));
+    } else if (turnDir == 1) {
+        b->turnDelta[me] = -rate;
+    } else if (turnDir == -1) {
+        b->turnDelta[me] = rate;
+    } else {
+        b->turnDelta[me] = 0.0;
+    }
+}
+
+// ---------- stepping ----------
+
+static void killLane(SimBatch *b, int inst, int lane)
+{
+    b->alive[lane] = 0;
+    b->deadTicks[lane] = SIM_RESPAWN;
+    if (lane == inst * b->ships) b->deaths[inst]++;
+}
+
+static void stepShots(SimBatch *b, int inst)
+{
+    int base = inst * SIM_BATCH_SHOTS, n = 0;
+    int first = inst * b->ships;
+    for (int s = base, e = base + b->shotCount[inst]; s < e; s++) {
+        double vx = b->svx[s], vy = b->svy[s];
+        double len = sqrt(vx * vx + vy * vy);
+        int dead = --b->slife[s] <= 0;
+        if (!dead && len > 0.0 && simRayCast(b->map, b->sx[s], b->sy[s], vx / len, vy / len, len) >= 0.0) dead = 1;
+        double x = b->sx[s] + vx, y = b->sy[s] + vy;
+        for (int k = 0; !dead && k < b->ships; k++) {
+            int lane = first + k;
+            if (!b->alive[lane] || k == b->sowner[s]) continue;
+            double dx = b->x[lane] - x, dy = b->y[lane] - y;
+            if (dx * dx + dy * dy < SIM_SHIP_RADIUS * SIM_SHIP_RADIUS) {
+                dead = 1;
+                killLane(b, inst, lane);
+                if (b->sowner[s] == 0) b->kills[inst]++;
+            }
+        }
+        if (dead) continue;
+        int d = base + n++;
+        b->sx[d] = x;
+        b->sy[d] = y;
+        b->svx[d] = vx;
+        b->svy[d] = vy;
+        b->slife[d] = b->slife[s];
+        b->sowner[d] = b->sowner[s];
+    }
+    b->shotCount[inst] = n;
+}
+
+// One frame for instances [lo,hi).
+void simBatchStep(SimBatch *b, int lo, int hi, SimPolicy policy, const void *const *ctx)
+{
+    const int S = b->ships;
+    const double dummyRate = 20.0 * 360.0 / 128.0;
+    const double accel = 45.0 / SIM_SHIP_MASS;
+
+    // controls
+    for (int i = lo; i < hi; i++) {
+        int me = i * S;
+        if (b->alive[me]) policy(b, i, ctx[i]);
+        for (int k = 1; k < S; k++) {
+            int lane = me + k;
+            if (!b->alive[lane]) continue;
+            SimDummyOut c = simDummyDecide(b->map, b->x[lane], b->y[lane], b->vx[lane], b->vy[lane],
+                                           b->heading[lane], b->alive[me], b->x[me], b->y[me],
+                                           laneRandDouble(b, i));
+            b->thrust[lane] = (unsigned char)c.thrust;
+            b->fire[lane] = (unsigned char)c.fire;
+            b->turnDelta[lane] = c.hasTurnRequest ? fmax(-dummyRate, fmin(dummyRate, c.turnRequest))
+                                                  : (c.turnLeft ? dummyRate : 0.0);
+        }
+    }
+
+    // kinematics over the contiguous lane range
+    int l0 = lo * S, l1 = hi * S;
+    for (int l = l0; l < l1; l++) {
+        double h = b->heading[l] + (b->alive[l] ? b->turnDelta[l] : 0.0);
+        b->heading[l] = h >= 360.0 ? h - 360.0 : (h < 0.0 ? h + 360.0 : h);
+    }
+    for (int l = l0; l < l1; l++) {
+        double a = (b->alive[l] && b->thrust[l]) ? accel : 0.0;
+        double h = RAD(b->heading[l]);
+        b->vx[l] += a * cos(h);
+        b->vy[l] += a * sin(h);
+    }
+
+    // movement, walls, respawn and firing
+    for (int i = lo; i < hi; i++) {
+        for (int k = 0; k < S; k++) {
+            int l = i * S + k;
+            if (!b->alive[l]) {
+                if (--b->deadTicks[l] <= 0) spawnLane(b, i, l);
+                continue;
+            }
+            double speed = sqrt(b->vx[l] * b->vx[l] + b->vy[l] * b->vy[l]);
+            int steps = 1 + (int)(speed / (SIM_SHIP_RADIUS * 0.5));
+            for (int st = 0; st < steps; st++) {
+                b->x[l] += b->vx[l] / steps;
+                b->y[l] += b->vy[l] / steps;
+                if (simCircleHitsWall(b->map, b->x[l], b->y[l], SIM_SHIP_RADIUS)) {
+                    killLane(b, i, l);
+                    break;
+                }
+            }
+            if (!b->alive[l]) continue;
+            if (b->reload[l] > 0) b->reload[l]--;
+            if (b->fire[l] && b->reload[l] == 0 && b->shotCount[i] < SIM_BATCH_SHOTS) {
+                int s = i * SIM_BATCH_SHOTS + b->shotCount[i]++;
+                double hx = cos(RAD(b->heading[l])), hy = sin(RAD(b->heading[l]));
+                b->sx[s] = b->x[l] + hx * (SIM_SHIP_RADIUS + 1.0);
+                b->sy[s] = b->y[l] + hy * (SIM_SHIP_RADIUS + 1.0);
+                b->svx[s] = b->vx[l] + hx * SIM_SHOT_SPEED;
+                b->svy[s] = b->vy[l] + hy * SIM_SHOT_SPEED;
+                b->slife[s] = SIM_SHOT_LIFE;
+                b->sowner[s] = k;
+                b->reload[l] = SIM_RELOAD;
+            }
+            b->fire[l] = 0;
+        }
+        stepShots(b, i);
+        b->aliveTicks[i] += b->alive[i * S];
+    }
+}
+
+// ---------- population evaluation ----------
+
+void simBatchDefaults(SimBatchConfig *cfg)
+{
+    cfg->ticks = SIM_FPS * 60;
+    cfg->episodes = 2;
+    cfg->enemies = 1;
+    cfg->seed = 1;
+    cfg->threads = 0;
+    cfg->killWeight = 10.0;
+    cfg->deathWeight = 5.0;
+}
+
+typedef struct {
+    SimBatch *b;
+    const SimBatchConfig *cfg;
+    const void *const *ctx;
+    double *score;
+    int lo, hi;
+} EvalChunk;
+
+static void *evalChunk(void *arg)
+{
+    EvalChunk *c = arg;
+    SimBatch *b = c->b;
+    for (int ep = 0; ep < c->cfg->episodes; ep++) {
+        simBatchReset(b, c->lo, c->hi, c->cfg->seed + (uint64_t)ep * 0x9E3779B97F4A7C15ull);
+        for (int t = 0; t < c->cfg->ticks; t++) simBatchStep(b, c->lo, c->hi, simBatchRulePolicy, c->ctx);
+        for (int i = c->lo; i < c->hi; i++)
+            c->score[i] += (double)b->aliveTicks[i] / SIM_FPS + c->cfg->killWeight * b->kills[i] -
+                           c->cfg->deathWeight * b->deaths[i];
+    }
+    return NULL;
+}
+
+int simBatchEvaluate(Chromosome **pop, int popSize, int geneLength, const SimBatchConfig *cfg)
+{
+    if (!pop || popSize <= 0) return -1;
+    if (geneLength < GA_RULES_BITS) {
+        fprintf(stderr, "simBatchEvaluate: geneLength %d is shorter than the %d bit rule set\n", geneLength, GA_RULES_BITS);
+        return -1;
+    }
+    SimBatchConfig def;
+    if (!cfg) { simBatchDefaults(&def); cfg = &def; }
+
+    int threads = cfg->threads;
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > popSize) threads = popSize;
+
+    SimMap map = { 0 };
+    simMapDefault(&map);
+    SimBatch *b = simBatchCreate(&map, popSize, cfg->enemies);
+    double *score = calloc((size_t)popSize, sizeof(double));
+    const void **ctx = malloc((size_t)popSize * sizeof(void *));
+    pthread_t *tid = malloc((size_t)threads * sizeof(pthread_t));
+    EvalChunk *chunks = malloc((size_t)threads * sizeof(EvalChunk));
+    unsigned char *started = calloc((size_t)threads, 1);
+    if (!b || !score || !ctx || !tid || !chunks || !started) {
+        simBatchFree(b);
+        free(score);
+        free(ctx);
+        free(tid);
+        free(chunks);
+        free(started);
+        simMapFree(&map);
+        return -1;
+    }
+    for (int i = 0; i < popSize; i++) ctx[i] = pop[i];
+
+    for (int t = 0; t < threads; t++) {
+        chunks[t] = (EvalChunk){ b, cfg, ctx, score, popSize * t / threads, popSize * (t + 1) / threads };
+        started[t] = t > 0 && pthread_create(&tid[t], NULL, evalChunk, &chunks[t]) == 0;
+    }
+    // chunk 0, and any a thread could not be started for, run here
+    for (int t = 0; t < threads; t++)
+        if (!started[t]) evalChunk(&chunks[t]);
+    for (int t = 1; t < threads; t++)
+        if (started[t]) pthread_join(tid[t], NULL);
+
+    for (int i = 0; i < popSize; i++) pop[i]->fitness = (int)lround(score[i] / cfg->episodes);
+
+    free(tid);
+    free(chunks);
+    free(started);
+    free(ctx);
+    free(score);
+    simBatchFree(b);
+    simMapFree(&map);
+    return 0;
+}
@@ -0,0 +1,63 @@
+// Batched simulator: N independent worlds (one agent + scripted opponents
+// each) stepped in lockstep.  State is kept as structure-of-arrays so a frame
+// walks each field contiguously, and instances are split into contiguous
+// chunks across threads.
+#ifndef SIM_BATCH_H
+#define SIM_BATCH_H
+
+#include <stdint.h>
+#include "sim.h"
+#include "chromosome.h"
+
+#define SIM_BATCH_SHOTS 64     // shot slots per instance
+
+typedef struct {
+    int ticks;                 // frames per episode
+    int episodes;              // episodes averaged per individual
+    int enemies;               // scripted opponents per instance
+    uint64_t seed;             // every individual faces the same scenarios
+    int threads;               // 0 = one per online core
+    double killWeight;         // fitness = seconds alive + killWeight*kills - deathWeight*deaths
+    double deathWeight;
+} SimBatchConfig;
+
+typedef struct SimBatch {
+    const SimMap *map;
+    int n;                     // instances
+    int ships;                 // ships per instance, ship 0 is the agent
+    // ship lanes, instance-major: ship k of instance i is lane i*ships + k
+    double *x, *y, *vx, *vy, *heading;
+    double *turnDelta;         // heading change requested for this frame
+    unsigned char *thrust, *fire, *alive;
+    int *deadTicks, *reload;
+    // shot lanes: SIM_BATCH_SHOTS slots per instance, shotCount[i] in use
+    double *sx, *sy, *svx, *svy;
+    int *slife, *sowner;       // owner is the ship slot within the instance
+    int *shotCount;
+    // per instance
+    uint64_t *rng;
+    int *deaths, *kills;
+    long *aliveTicks;
+} SimBatch;
+
+// Sets the agent controls (turnDelta/thrust/fire lanes) of instance inst.
+typedef void (*SimPolicy)(SimBatch *b, int inst, const void *ctx);
+
+SimBatch *simBatchCreate(const SimMap *map, int n, int enemies);
+void simBatchFree(SimBatch *b);
+void simBatchReset(SimBatch *b, int lo, int hi, uint64_t seed);
+void simBatchStep(SimBatch *b, int lo, int hi, SimPolicy policy, const void *const *ctx);
+
+// sensing helpers for policies
+int simBatchFeeler(const SimBatch *b, int lane, int dist, int angleDeg);
+int simBatchAimDir(const SimBatch *b, int inst);
+int simBatchShotAlert(const SimBatch *b, int inst);
+
+// GA rule controller from include/gaRules.h, ctx is a const Chromosome *
+void simBatchRulePolicy(SimBatch *b, int inst, const void *ctx);
+
+void simBatchDefaults(SimBatchConfig *cfg);
+// Scores the whole population with simBatchRulePolicy; fills pop[i]->fitness.
+int simBatchEvaluate(Chromosome **pop, int popSize, int geneLength, const SimBatchConfig *cfg);
+
+#endif
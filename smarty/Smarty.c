@@ -2,6 +2,9 @@
 //Compile: gcc Spinner.c libcAI.so -o Spinner
 //Run: ./Spinner
 #include "cAI.h"
+#include "wallSweep.h"
+#include "sensorCache.h"
+#include "sensorFrame.h"
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -22,54 +25,54 @@
   #define THRUSTDEBUG(x)
 #endif
 
+SensorFrame frame; //this tick's snapshot, see sensorFrame.h
+FILE *frameLog; //-framelog file, NULL when not logging
+
 int AI_loop() {
   setTurnSpeedDeg(20);
-  int aimDir = aimdir(0);
+#ifdef SENSOR_CACHE
+  //re-use last frame's sweep, see sensorCache.h
+  static SensorCache cache;
+  sensorFrameCaptureState(&frame);
+  sensorCacheSweep(&cache,500,(int)frame.headingDeg,frame.walls,NULL,NULL);
+  sensorFrameWalls(&frame,500);
+#else
+  sensorFrameCapture(&frame,500);
+#endif
+  if(frameLog) sensorFrameWrite(frameLog,&frame);
+  int aimDir = frame.aimDir;
   //Release keys
   //Set variables
-  double heading = selfHeadingDeg();
-  double tracking = selfTrackingDeg();
-  double trackWall = wallFeeler(500,tracking);
+  double trackWall = frame.trackWall;
+  int speed = frame.speed;
+
+  //walls[i] is the feeler at heading+i
+  const int *walls = frame.walls;
+  int closest_angle = frame.closestAngle;
+  int furthest_angle = frame.furthestAngle;
+  double furthest = frame.furthest;
+  double closest = frame.closest;
 
-  //clockwise rotation around the ship
-  double frontWall = wallFeeler(500,heading);
-  double wall1 = wallFeeler(500,heading+30);
-  double wall2 = wallFeeler(500,heading+60);
-  double wall3 = wallFeeler(500,heading+90);
-  double wall4 = wallFeeler(500,heading+120);
-  double wall5 = wallFeeler(500,heading+150);
-  double backWall = wallFeeler(500,heading+180);
-  double wall7 = wallFeeler(500,heading+210);
-  double wall8 = wallFeeler(500,heading+240);
-  double wall9 = wallFeeler(500,heading+270);
-  double wall10 = wallFeeler(500,heading+300);
-  double wall11 = wallFeeler(500,heading+330);
+  double frontWall = walls[0];
+  double wall1 = walls[30];
+  double wall2 = walls[60];
+  double wall3 = walls[90];
+  double wall4 = walls[120];
+  double wall5 = walls[150];
+  double backWall = walls[180];
+  double wall7 = walls[210];
+  double wall8 = walls[240];
+  double wall9 = walls[270];
+  double wall10 = walls[300];
+  double wall11 = walls[330];
   
   int shouldThrust = 0;
   //turn right = 1, turn left = -1
   int turnDir = 0;
 
-  double furthest = 0.0;
-  int furthest_angle = 0;
-  double closest = 600.0;
-  int closest_angle = 0;
-  for(int i=0;i<360;i++)
-  {
-    double dist = wallFeeler(500,heading+i);
-    if(dist > furthest)
-    {
-      furthest = dist;
-      furthest_angle = i;
-    }
-    if(dist < closest)
-    {
-      closest = dist;
-      closest_angle = i;
-    }
-  }
-  int headingTrackingDiff = (int)(heading + 360 - tracking) % 360;
-  int headingAimingDiff = (int)(heading + 360 - aimDir) % 360;
-  int shotDanger = shotAlert(0);
+  int headingTrackingDiff = frame.headingTrackingDiff;
+  int headingAimingDiff = frame.headingAimingDiff;
+  int shotDanger = frame.shotDanger;
   //printf("heading %f, tracking %f, diff: %d, trackWall: %f\n", heading, tracking, headingTrackingDiff, trackWall);
   //Thrust rules
   if(shotDanger > 0 && shotDanger < 200 && frontWall > 200 && trackWall > 80)
@@ -77,7 +80,7 @@ int AI_loop() {
     THRUSTDEBUG(AR(printf("avoiding shot: %d\n", shotDanger)));
     shouldThrust = 1;
   }
-  else if((furthest_angle == 0) && selfSpeed() < 6 && frontWall > 200)
+  else if((furthest_angle == 0) && speed < 6 && frontWall > 200)
   {
     THRUSTDEBUG(AR(printf("propulsion\n")));
     shouldThrust = 1;
@@ -111,13 +114,13 @@ int AI_loop() {
   //AR(printf("headingTrackingDiff: %d\n", headingTrackingDiff));
   //Turn rules
   //Speed too fast, turn to face against tracking direction
-  if(selfSpeed() > 9 && headingTrackingDiff < 175)
+  if(speed > 9 && headingTrackingDiff < 175)
   {
     TURNDEBUG(AR(printf("Turning reverse\n")));
     turnDir = -1;
   }
   //Speed too fast, turn to face against tracking direction
-  else if(selfSpeed() > 9 && headingTrackingDiff > 185)
+  else if(speed > 9 && headingTrackingDiff > 185)
   {
     TURNDEBUG(AR(printf("Turning reverse\n")));
     turnDir = 1;
@@ -139,13 +142,13 @@ int AI_loop() {
     turnToDeg(aimDir);
     turnDir = 0;
   }
-  else if(selfSpeed() > 1 && closest < 100 && closest_angle > 2 && closest_angle <= 180)
+  else if(speed > 1 && closest < 100 && closest_angle > 2 && closest_angle <= 180)
   {
     TURNDEBUG(AR(printf("Turning away\n")));
     turnDir = 1;
   }
   //if the ship is already facing the furthest area, then turn away from nearby geometries
-  else if(selfSpeed() > 1 && closest < 100 && closest_angle < 358 && closest_angle > 180)
+  else if(speed > 1 && closest < 100 && closest_angle < 358 && closest_angle > 180)
   {
     TURNDEBUG(AR(printf("Turning away\n")));
     turnDir = -1;
@@ -194,5 +197,6 @@ int AI_loop() {
   return 0;
 }
 int main(int argc, char *argv[]) {
+  frameLog = sensorFrameLogArgs(&argc, argv);
   return start(argc, argv);
 }